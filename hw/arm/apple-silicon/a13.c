@@ -43,6 +43,10 @@
 #define VMSTATE_A13_CLUSTER_CPREG(name) \
     VMSTATE_UINT64(A13_CPREG_VAR_NAME(name), AppleA13Cluster)
 
+/*
+ * Plain storage registers: TCG accesses them inline and writes do not end
+ * the TB. Registers whose writes affect emulation need their own entry.
+ */
 #define A13_CPREG_DEF(p_name, p_op0, p_op1, p_crn, p_crm, p_op2, p_access, \
                       p_reset)                                             \
     { .cp = CP_REG_ARM64_SYSREG_CP,                                        \
@@ -55,7 +59,7 @@
       .access = p_access,                                                  \
       .resetvalue = p_reset,                                               \
       .state = ARM_CP_STATE_AA64,                                          \
-      .type = ARM_CP_OVERRIDE,                                             \
+      .type = ARM_CP_OVERRIDE | ARM_CP_SUPPRESS_TB_END,                    \
       .fieldoffset = offsetof(AppleA13State, A13_CPREG_VAR_NAME(p_name)) - \
                      offsetof(ARMCPU, env) }
 
@@ -89,6 +93,9 @@
 #define IPI_RR_TYPE_DEFERRED (2 << 28)
 #define IPI_RR_TYPE_NOWAKE (3 << 28)
 #define IPI_RR_TYPE_MASK (3 << 28)
+
+#define CYC_OVRD_OK2PWRDN_MASK (3 << 24)
+#define CYC_OVRD_OK2PWRDN_FORCE_DOWN (3 << 24)
 #define NSEC_PER_USEC 1000ull /* nanoseconds per microsecond */
 #define USEC_PER_SEC 1000000ull /* microseconds per second */
 #define NSEC_PER_SEC 1000000000ull /* nanoseconds per second */
@@ -120,6 +127,14 @@ static QTAILQ_HEAD(, AppleA13Cluster) clusters =
 static uint64_t ipi_cr = kDeferredIPITimerDefault;
 static QEMUTimer *ipicr_timer = NULL;
 
+static void apple_a13_cluster_ipicr_arm(void)
+{
+    if (!timer_pending(ipicr_timer)) {
+        timer_mod_ns(ipicr_timer,
+                     qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + ipi_cr);
+    }
+}
+
 inline bool apple_a13_cpu_is_sleep(AppleA13State *tcpu)
 {
     return CPU(tcpu)->halted;
@@ -221,14 +236,37 @@ static void apple_a13_cluster_deliver_ipi(AppleA13Cluster *c, uint64_t cpu_id,
 static int apple_a13_cluster_pre_save(void *opaque)
 {
     AppleA13Cluster *cluster = APPLE_A13_CLUSTER(opaque);
+    int i;
+
     cluster->ipi_cr = ipi_cr;
+    for (i = 0; i < A13_V1_MAX_CPU; i++) {
+        memcpy(cluster->deferredIPI_v1[i], cluster->deferredIPI[i],
+               sizeof(cluster->deferredIPI_v1[i]));
+        memcpy(cluster->noWakeIPI_v1[i], cluster->noWakeIPI[i],
+               sizeof(cluster->noWakeIPI_v1[i]));
+    }
     return 0;
 }
 
 static int apple_a13_cluster_post_load(void *opaque, int version_id)
 {
     AppleA13Cluster *cluster = APPLE_A13_CLUSTER(opaque);
+    int i;
+
+    /* A version 1 stream only covers the first A13_V1_MAX_CPU CPUs. */
+    if (version_id < 2) {
+        memset(cluster->deferredIPI, 0, sizeof(cluster->deferredIPI));
+        memset(cluster->noWakeIPI, 0, sizeof(cluster->noWakeIPI));
+        for (i = 0; i < A13_V1_MAX_CPU; i++) {
+            memcpy(cluster->deferredIPI[i], cluster->deferredIPI_v1[i],
+                   sizeof(cluster->deferredIPI_v1[i]));
+            memcpy(cluster->noWakeIPI[i], cluster->noWakeIPI_v1[i],
+                   sizeof(cluster->noWakeIPI_v1[i]));
+        }
+    }
+
     ipi_cr = cluster->ipi_cr;
+    apple_a13_cluster_ipicr_arm();
     return 0;
 }
 
@@ -272,8 +310,10 @@ static void apple_a13_cluster_realize(DeviceState *dev, Error **errp)
     }
 }
 
-static void apple_a13_cluster_tick(AppleA13Cluster *c)
+/* Returns true while deferred or no-wake IPIs are still outstanding. */
+static bool apple_a13_cluster_tick(AppleA13Cluster *c)
 {
+    bool pending = false;
     int i, j;
 
     for (i = 0; i < A13_MAX_CPU; i++) { /* source */
@@ -296,29 +336,47 @@ static void apple_a13_cluster_tick(AppleA13Cluster *c)
             }
         }
     }
+
+    for (i = 0; i < A13_MAX_CPU && !pending; i++) {
+        for (j = 0; j < A13_MAX_CPU; j++) {
+            if (c->deferredIPI[i][j] || c->noWakeIPI[i][j]) {
+                pending = true;
+                break;
+            }
+        }
+    }
+
+    return pending;
 }
 
 static void apple_a13_cluster_ipicr_tick(void *opaque)
 {
     AppleA13Cluster *cluster;
+    bool pending = false;
+
     QTAILQ_FOREACH (cluster, &clusters, next) {
-        apple_a13_cluster_tick(cluster);
+        pending |= apple_a13_cluster_tick(cluster);
     }
 
-    timer_mod_ns(ipicr_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + ipi_cr);
+    /*
+     * Only keep ticking while something is outstanding, so that an idle
+     * guest with all cores in WFI does not wake the host every IPI_CR.
+     */
+    if (pending) {
+        timer_mod_ns(ipicr_timer,
+                     qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + ipi_cr);
+    }
 }
 
 
 static void apple_a13_cluster_reset_handler(void *opaque)
 {
-    if (ipicr_timer) {
-        timer_del(ipicr_timer);
-        ipicr_timer = NULL;
-    }
-    ipicr_timer =
-        timer_new_ns(QEMU_CLOCK_VIRTUAL, apple_a13_cluster_ipicr_tick, NULL);
-    timer_mod_ns(ipicr_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
-                                  kDeferredIPITimerDefault);
+    /*
+     * The shared timer is created once and only armed while deferred or
+     * no-wake IPIs are outstanding, which the cluster reset clears.
+     */
+    ipi_cr = kDeferredIPITimerDefault;
+    timer_del(ipicr_timer);
 }
 
 static void apple_a13_cluster_instance_init(Object *obj)
@@ -327,6 +385,8 @@ static void apple_a13_cluster_instance_init(Object *obj)
     QTAILQ_INSERT_TAIL(&clusters, cluster, next);
 
     if (ipicr_timer == NULL) {
+        ipicr_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL,
+                                   apple_a13_cluster_ipicr_tick, NULL);
         qemu_register_reset(apple_a13_cluster_reset_handler, NULL);
     }
 }
@@ -363,6 +423,7 @@ static void apple_a13_ipi_rr_local(CPUARMState *env, const ARMCPRegInfo *ri,
     case IPI_RR_TYPE_NOWAKE:
         if (apple_a13_cpu_is_sleep(c->cpus[cpu_id])) {
             c->noWakeIPI[tcpu->cpu_id][cpu_id] = 1;
+            apple_a13_cluster_ipicr_arm();
         } else {
             apple_a13_cluster_deliver_ipi(c, cpu_id, tcpu->cpu_id,
                                           IPI_RR_TYPE_IMMEDIATE);
@@ -370,6 +431,7 @@ static void apple_a13_ipi_rr_local(CPUARMState *env, const ARMCPRegInfo *ri,
         break;
     case IPI_RR_TYPE_DEFERRED:
         c->deferredIPI[tcpu->cpu_id][cpu_id] = 1;
+        apple_a13_cluster_ipicr_arm();
         break;
     case IPI_RR_TYPE_RETRACT:
         c->deferredIPI[tcpu->cpu_id][cpu_id] = 0;
@@ -423,6 +485,7 @@ static void apple_a13_ipi_rr_global(CPUARMState *env, const ARMCPRegInfo *ri,
     case IPI_RR_TYPE_NOWAKE:
         if (apple_a13_cpu_is_sleep(c->cpus[cpu_id])) {
             c->noWakeIPI[tcpu->cpu_id][cpu_id] = 1;
+            apple_a13_cluster_ipicr_arm();
         } else {
             apple_a13_cluster_deliver_ipi(c, cpu_id, tcpu->cpu_id,
                                           IPI_RR_TYPE_IMMEDIATE);
@@ -430,6 +493,7 @@ static void apple_a13_ipi_rr_global(CPUARMState *env, const ARMCPRegInfo *ri,
         break;
     case IPI_RR_TYPE_DEFERRED:
         c->deferredIPI[tcpu->cpu_id][cpu_id] = 1;
+        apple_a13_cluster_ipicr_arm();
         break;
     case IPI_RR_TYPE_RETRACT:
         c->deferredIPI[tcpu->cpu_id][cpu_id] = 0;
@@ -491,19 +555,42 @@ static void apple_a13_ipi_write_cr(CPUARMState *env, const ARMCPRegInfo *ri,
                                    uint64_t value)
 {
     uint64_t nanosec = 0;
-
-    absolutetime_to_nanoseconds(value, &nanosec);
-
     uint64_t ct;
 
-    if (value == 0)
-        value = kDeferredIPITimerDefault;
+    if (value == 0) {
+        nanosec = kDeferredIPITimerDefault;
+    } else {
+        absolutetime_to_nanoseconds(value, &nanosec);
+    }
+    if (nanosec == 0) {
+        nanosec = 1;
+    }
 
-    ct = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
-    timer_mod_ns(ipicr_timer, (ct / ipi_cr) * ipi_cr + nanosec);
+    if (timer_pending(ipicr_timer)) {
+        ct = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        timer_mod_ns(ipicr_timer, (ct / ipi_cr) * ipi_cr + nanosec);
+    }
     ipi_cr = nanosec;
 }
 
+static void apple_a13_cyc_ovrd_write(CPUARMState *env, const ARMCPRegInfo *ri,
+                                     uint64_t value)
+{
+    AppleA13State *tcpu = APPLE_A13(env_archcpu(env));
+
+    tcpu->A13_CPREG_VAR_NAME(ARM64_REG_CYC_OVRD) = value;
+
+    /*
+     * XNU forces ok2pwrdn right before the final WFI loop when it takes a
+     * core offline, expecting it to come back only through the reset
+     * vector once PMGR restarts it. Power the vCPU off instead of having
+     * it spin on a WFI that keeps returning for masked interrupts.
+     */
+    if ((value & CYC_OVRD_OK2PWRDN_MASK) == CYC_OVRD_OK2PWRDN_FORCE_DOWN) {
+        apple_a13_cpu_off(tcpu);
+    }
+}
+
 static const ARMCPRegInfo apple_a13_cp_reginfo_tcg[] = {
     A13_CPREG_DEF(ARM64_REG_EHID3, 3, 0, 15, 3, 1, PL1_RW, 0),
     A13_CPREG_DEF(ARM64_REG_EHID4, 3, 0, 15, 4, 1, PL1_RW, 0),
@@ -539,8 +626,6 @@ static const ARMCPRegInfo apple_a13_cp_reginfo_tcg[] = {
     A13_CPREG_DEF(PMSR, 3, 1, 15, 13, 0, PL1_RW, 0),
     A13_CPREG_DEF(S3_4_c15_c0_5, 3, 4, 15, 0, 5, PL1_RW, 0),
     A13_CPREG_DEF(AMX_STATUS_EL1, 3, 4, 15, 1, 3, PL1_R, 0),
-    A13_CPREG_DEF(AMX_CTL_EL1, 3, 4, 15, 1, 4, PL1_RW, 0),
-    A13_CPREG_DEF(ARM64_REG_CYC_OVRD, 3, 5, 15, 5, 0, PL1_RW, 0),
     A13_CPREG_DEF(ARM64_REG_ACC_CFG, 3, 5, 15, 4, 0, PL1_RW, 0),
     A13_CPREG_DEF(S3_5_c15_c10_1, 3, 5, 15, 10, 1, PL0_RW, 0),
     A13_CPREG_DEF(SYS_ACC_PWR_DN_SAVE, 3, 7, 15, 2, 0, PL1_RW, 0),
@@ -553,6 +638,36 @@ static const ARMCPRegInfo apple_a13_cp_reginfo_tcg[] = {
     A13_CLUSTER_CPREG_DEF(CTRR_B_UPR_EL1, 3, 4, 15, 1, 6, PL1_RW),
     A13_CLUSTER_CPREG_DEF(CTRR_CTL_EL1, 3, 4, 15, 2, 5, PL1_RW),
     A13_CLUSTER_CPREG_DEF(CTRR_LOCK_EL1, 3, 4, 15, 2, 2, PL1_RW),
+    {
+        .cp = CP_REG_ARM64_SYSREG_CP,
+        .name = "AMX_CTL_EL1",
+        .opc0 = 3,
+        .opc1 = 4,
+        .crn = 15,
+        .crm = 1,
+        .opc2 = 4,
+        .access = PL1_RW,
+        /* Only checked when an AMX instruction executes. */
+        .type = ARM_CP_OVERRIDE | ARM_CP_SUPPRESS_TB_END,
+        .state = ARM_CP_STATE_AA64,
+        .fieldoffset = offsetof(CPUARMState, amx.ctl),
+    },
+    {
+        .cp = CP_REG_ARM64_SYSREG_CP,
+        .name = "ARM64_REG_CYC_OVRD",
+        .opc0 = 3,
+        .opc1 = 5,
+        .crn = 15,
+        .crm = 5,
+        .opc2 = 0,
+        .access = PL1_RW,
+        .type = ARM_CP_OVERRIDE | ARM_CP_IO,
+        .state = ARM_CP_STATE_AA64,
+        .fieldoffset =
+            offsetof(AppleA13State, A13_CPREG_VAR_NAME(ARM64_REG_CYC_OVRD)) -
+            offsetof(ARMCPU, env),
+        .writefn = apple_a13_cyc_ovrd_write,
+    },
     {
         .cp = CP_REG_ARM64_SYSREG_CP,
         .name = "ARM64_REG_IPI_RR_LOCAL",
@@ -808,7 +923,7 @@ static const Property apple_a13_cluster_properties[] = {
 
 static const VMStateDescription vmstate_apple_a13 = {
     .name = "apple_a13",
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .fields =
         (const VMStateField[]){
@@ -840,7 +955,8 @@ static const VMStateDescription vmstate_apple_a13 = {
             VMSTATE_A13_CPREG(PMSR),
             VMSTATE_A13_CPREG(S3_4_c15_c0_5),
             VMSTATE_A13_CPREG(AMX_STATUS_EL1),
-            VMSTATE_A13_CPREG(AMX_CTL_EL1),
+            // Was the AMX_CTL_EL1 stub; same slot, now backed by env.
+            VMSTATE_UINT64(env.amx.ctl, ARMCPU),
             VMSTATE_A13_CPREG(ARM64_REG_CYC_OVRD),
             VMSTATE_A13_CPREG(ARM64_REG_ACC_CFG),
             VMSTATE_A13_CPREG(S3_5_c15_c10_1),
@@ -850,22 +966,26 @@ static const VMStateDescription vmstate_apple_a13 = {
             VMSTATE_A13_CPREG(UPMSR),
             VMSTATE_UINT64(env.keys.m.lo, ARMCPU),
             VMSTATE_UINT64(env.keys.m.hi, ARMCPU),
+            VMSTATE_UINT64_2DARRAY_V(env.amx.x, ARMCPU, 8, 8, 2),
+            VMSTATE_UINT64_2DARRAY_V(env.amx.y, ARMCPU, 8, 8, 2),
+            VMSTATE_UINT64_2DARRAY_V(env.amx.z, ARMCPU, 64, 8, 2),
+            VMSTATE_BOOL_V(env.amx.active, ARMCPU, 2),
             VMSTATE_END_OF_LIST(),
         }
 };
 
 static const VMStateDescription vmstate_apple_a13_cluster = {
     .name = "apple_a13_cluster",
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .pre_save = apple_a13_cluster_pre_save,
     .post_load = apple_a13_cluster_post_load,
     .fields =
         (const VMStateField[]){
-            VMSTATE_UINT32_2DARRAY(deferredIPI, AppleA13Cluster, A13_MAX_CPU,
-                                   A13_MAX_CPU),
-            VMSTATE_UINT32_2DARRAY(noWakeIPI, AppleA13Cluster, A13_MAX_CPU,
-                                   A13_MAX_CPU),
+            VMSTATE_UINT32_2DARRAY(deferredIPI_v1, AppleA13Cluster,
+                                   A13_V1_MAX_CPU, A13_V1_MAX_CPU),
+            VMSTATE_UINT32_2DARRAY(noWakeIPI_v1, AppleA13Cluster,
+                                   A13_V1_MAX_CPU, A13_V1_MAX_CPU),
             VMSTATE_UINT64(tick, AppleA13Cluster),
             VMSTATE_UINT64(ipi_cr, AppleA13Cluster),
             VMSTATE_A13_CLUSTER_CPREG(CTRR_A_LWR_EL1),
@@ -874,6 +994,10 @@ static const VMStateDescription vmstate_apple_a13_cluster = {
             VMSTATE_A13_CLUSTER_CPREG(CTRR_B_UPR_EL1),
             VMSTATE_A13_CLUSTER_CPREG(CTRR_CTL_EL1),
             VMSTATE_A13_CLUSTER_CPREG(CTRR_LOCK_EL1),
+            VMSTATE_UINT32_2DARRAY_V(deferredIPI, AppleA13Cluster,
+                                     A13_MAX_CPU, A13_MAX_CPU, 2),
+            VMSTATE_UINT32_2DARRAY_V(noWakeIPI, AppleA13Cluster, A13_MAX_CPU,
+                                     A13_MAX_CPU, 2),
             VMSTATE_END_OF_LIST(),
         }
 };
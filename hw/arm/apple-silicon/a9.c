@@ -46,7 +46,7 @@
         .access = p_access,                                                \
         .resetvalue = p_reset,                                             \
         .state = ARM_CP_STATE_AA64,                                        \
-        .type = ARM_CP_OVERRIDE,                                           \
+        .type = ARM_CP_OVERRIDE | ARM_CP_SUPPRESS_TB_END,                  \
         .fieldoffset = offsetof(AppleA9State, A9_CPREG_VAR_NAME(p_name)) - \
                        offsetof(ARMCPU, env),                              \
     }
@@ -31,9 +31,12 @@
 #include "qemu/cutils.h"
 #include "qemu/error-report.h"
 #include "qemu/guest-random.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
 #include "img4.h"
 #include "lzfse.h"
 #include "lzss.h"
+#include "trace.h"
 
 // #define BOOT_DEBUG
 
@@ -45,6 +48,60 @@
     } while (0)
 #endif
 
+#define VM_PROT_WRITE (0x2)
+
+static char *image_cache_dir;
+
+void macho_set_image_cache_dir(const char *dir)
+{
+    g_free(image_cache_dir);
+    image_cache_dir = g_strdup(dir);
+}
+
+void macho_share_image(const char *name, const void *data, uint64_t size)
+{
+    allocate_shared_image(name, image_cache_dir, data, size);
+}
+
+void macho_share_segments(MachoHeader64 *mh)
+{
+    uint8_t *data = macho_get_buffer(mh);
+    MachoLoadCommand *cmd = (MachoLoadCommand *)(mh + 1);
+    MachoSegmentCommand64 *seg;
+    char region_name[64];
+    uint64_t virt_low, virt_high;
+    unsigned int index;
+
+    macho_highest_lowest(mh, &virt_low, &virt_high);
+
+    // The same segments, under the same names, that arm_load_macho() maps
+    // when loading unslid.
+    for (index = 0; index < mh->n_cmds; index++) {
+        seg = (MachoSegmentCommand64 *)cmd;
+        if (cmd->cmd == LC_SEGMENT_64 &&
+            strncmp(seg->segname, "__PAGEZERO", 11) != 0 && seg->vmsize != 0 &&
+            (seg->initprot & VM_PROT_WRITE) == 0) {
+            snprintf(region_name, sizeof(region_name), "Kernel-%s",
+                     seg->segname);
+            macho_share_image(region_name, data + seg->vmaddr - virt_low,
+                              seg->vmsize);
+        }
+        cmd = (MachoLoadCommand *)((char *)cmd + cmd->cmd_size);
+    }
+}
+
+void macho_load_image(AddressSpace *as, MemoryRegion *mem, const char *name,
+                      hwaddr pa, const void *data, uint64_t size)
+{
+    if (map_shared_image(mem, name, pa, data, size)) {
+        DINFO("Sharing %s at 0x" HWADDR_FMT_plx " (size 0x%" PRIx64 ")", name,
+              pa, size);
+        return;
+    }
+
+    address_space_rw(as, pa, MEMTXATTRS_UNSPECIFIED, data, size, true);
+}
+
 static const char *KEEP_COMP[] = {
     "adbe0,s8000\0$",
     "aop-audio\0$",
@@ -637,76 +694,172 @@ void macho_load_dtb(DTBNode *root, AddressSpace *as, MemoryRegion *mem,
                      info->device_tree_size, true);
 }
 
-uint8_t *load_trustcache_from_file(const char *filename, uint64_t *size)
+// Trust cache modules start with this header:
+// uint32_t version
+// uuid (16 bytes)
+// uint32_t entry_count
+//
+// The header is followed by entry_count entries, each of which contains a
+// 20 byte hash and 2 additional bytes (hence is 22 bytes long) for v1 and a
+// 20 byte hash and 4 additional bytes (hence is 24 bytes long) for v2.
+// XNU binary searches the entries by hash, so they must be sorted and
+// unique.
+#define TRUSTCACHE_HEADER_SIZE (24)
+#define TRUSTCACHE_HASH_SIZE (20)
+
+static int trustcache_entry_cmp(const void *a, const void *b)
 {
-    uint32_t *trustcache_data;
-    uint64_t trustcache_size;
-    g_autofree uint8_t *file_data;
-    unsigned long file_size;
-    uint32_t length;
-    char payload_type[4];
-    uint32_t trustcache_version, trustcache_entry_count, expected_file_size;
-    uint32_t trustcache_entry_size;
+    return memcmp(a, b, TRUSTCACHE_HASH_SIZE);
+}
 
-    extract_im4p_payload(filename, payload_type, &file_data, &length, NULL);
+// Validate the module in `data` and fix its order in place, returning the
+// size of the resulting module.
+static uint32_t trustcache_prepare(const char *filename, uint8_t *data,
+                                   uint32_t length)
+{
+    uint32_t version;
+    uint32_t count;
+    uint32_t entry_size;
+    uint32_t unique;
+    uint32_t i;
+    uint8_t *entries;
+    bool sorted = true;
 
-    if (strncmp(payload_type, "trst", 4) != 0 &&
-        strncmp(payload_type, "rtsc", 4) != 0 &&
-        strncmp(payload_type, "raw", 4) != 0) {
-        error_setg(&error_fatal,
-                   "`%s` is a `%.4s` object (expected `trst`/`rtsc`).",
-                   filename, payload_type);
+    if (length < TRUSTCACHE_HEADER_SIZE) {
+        error_setg(&error_fatal, "trustcache `%s` is truncated", filename);
+        return 0;
     }
 
-    file_size = (unsigned long)length;
-
-    trustcache_size = ROUND_UP_16K(file_size + 8);
-    trustcache_data = (uint32_t *)g_malloc(trustcache_size);
-    trustcache_data[0] = 1; // #trustcaches
-    trustcache_data[1] = 8; // offset
-    memcpy(&trustcache_data[2], file_data, file_size);
-
-    // Validate the trustcache v1 header. The layout is:
-    // uint32_t version
-    // uuid (16 bytes)
-    // uint32_t entry_count
-    //
-    // The cache is then followed by entry_count entries, each of which
-    // contains a 20 byte hash and 2 additional bytes (hence is 22 bytes long)
-    // for v1 and contains a 20 byte hash and 4 additional bytes (hence is 24
-    // bytes long) for v2
-    trustcache_version = trustcache_data[2];
-    trustcache_entry_count = trustcache_data[7];
+    version = ldl_le_p(data);
+    count = ldl_le_p(data + 20);
 
-    switch (trustcache_version) {
+    switch (version) {
     case 1:
-        trustcache_entry_size = 22;
+        entry_size = 22;
         break;
     case 2:
-        trustcache_entry_size = 24;
+        entry_size = 24;
         break;
     default:
         error_setg(
             &error_fatal,
             "invalid trustcache header in `%s` (expected v1 or v2, got %d)",
-            filename, trustcache_version);
-        return NULL;
+            filename, version);
+        return 0;
     }
 
-    // 24 is header size
-    expected_file_size = 24 + trustcache_entry_count * trustcache_entry_size;
+    if ((length - TRUSTCACHE_HEADER_SIZE) / entry_size != count ||
+        (length - TRUSTCACHE_HEADER_SIZE) % entry_size != 0) {
+        error_setg(&error_fatal,
+                   "trustcache `%s` is %u bytes, expected %u entries of %u",
+                   filename, length, count, entry_size);
+        return 0;
+    }
 
-    g_assert_cmpuint(file_size, ==, expected_file_size);
+    // Duplicates do not break the order; they are dropped below.
+    entries = data + TRUSTCACHE_HEADER_SIZE;
+    for (i = 1; i < count && sorted; i++) {
+        sorted = trustcache_entry_cmp(entries + (i - 1) * entry_size,
+                                      entries + i * entry_size) <= 0;
+    }
+
+    if (!sorted) {
+        warn_report("trustcache `%s` is not sorted by hash, sorting it",
+                    filename);
+        qsort(entries, count, entry_size, trustcache_entry_cmp);
+    }
 
-    *size = trustcache_size;
-    return (uint8_t *)trustcache_data;
+    unique = count == 0 ? 0 : 1;
+    for (i = 1; i < count; i++) {
+        if (trustcache_entry_cmp(entries + (unique - 1) * entry_size,
+                                 entries + i * entry_size) == 0) {
+            continue;
+        }
+        if (unique != i) {
+            memmove(entries + unique * entry_size, entries + i * entry_size,
+                    entry_size);
+        }
+        unique += 1;
+    }
+    stl_le_p(data + 20, unique);
+
+    trace_apple_boot_trustcache(filename, version, count, count - unique,
+                                sorted);
+
+    return TRUSTCACHE_HEADER_SIZE + unique * entry_size;
 }
 
-void macho_load_ramdisk(const char *filename, AddressSpace *as,
-                        MemoryRegion *mem, hwaddr pa, uint64_t *size)
+uint8_t *load_trustcache_from_file(const char *filename,
+                                   const strList *extra_filenames,
+                                   uint64_t *size)
+{
+    g_autofree const char **filenames = NULL;
+    g_autofree uint8_t **modules = NULL;
+    g_autofree uint32_t *lengths = NULL;
+    int64_t start = get_clock_realtime();
+    const strList *extra;
+    uint32_t count = 1;
+    uint32_t offset;
+    uint8_t *buf;
+    char payload_type[4];
+    uint32_t i;
+
+    for (extra = extra_filenames; extra != NULL; extra = extra->next) {
+        count += 1;
+    }
+
+    filenames = g_new0(const char *, count);
+    modules = g_new0(uint8_t *, count);
+    lengths = g_new0(uint32_t, count);
+
+    filenames[0] = filename;
+    for (i = 1, extra = extra_filenames; extra != NULL;
+         i++, extra = extra->next) {
+        filenames[i] = extra->value;
+    }
+
+    for (i = 0; i < count; i++) {
+        extract_im4p_payload(filenames[i], payload_type, &modules[i],
+                             &lengths[i], NULL);
+
+        if (strncmp(payload_type, "trst", 4) != 0 &&
+            strncmp(payload_type, "rtsc", 4) != 0 &&
+            strncmp(payload_type, "raw", 4) != 0) {
+            error_setg(&error_fatal,
+                       "`%s` is a `%.4s` object (expected `trst`/`rtsc`).",
+                       filenames[i], payload_type);
+        }
+
+        lengths[i] = trustcache_prepare(filenames[i], modules[i], lengths[i]);
+    }
+
+    // The kernel expects the module count followed by the offset of each
+    // module from the start of the segment.
+    offset = sizeof(uint32_t) * (1 + count);
+    for (i = 0; i < count; i++) {
+        offset += lengths[i];
+    }
+    *size = ROUND_UP_16K(offset);
+    buf = g_malloc0(*size);
+
+    stl_le_p(buf, count);
+    offset = sizeof(uint32_t) * (1 + count);
+    for (i = 0; i < count; i++) {
+        stl_le_p(buf + sizeof(uint32_t) * (1 + i), offset);
+        memcpy(buf + offset, modules[i], lengths[i]);
+        offset += lengths[i];
+        g_free(modules[i]);
+    }
+
+    trace_apple_boot_trustcache_loaded(count, offset,
+                                       get_clock_realtime() - start);
+
+    return buf;
+}
+
+uint8_t *load_ramdisk_from_file(const char *filename, uint64_t *size)
 {
     uint8_t *file_data = NULL;
-    unsigned long file_size = 0;
     uint32_t length = 0;
     char payload_type[4];
 
@@ -717,25 +870,90 @@ void macho_load_ramdisk(const char *filename, AddressSpace *as,
                    filename, payload_type);
     }
 
-    file_size = length;
-    file_data = g_realloc(file_data, file_size);
+    *size = length;
+    return file_data;
+}
 
-    address_space_rw(as, pa, MEMTXATTRS_UNSPECIFIED, file_data, file_size,
-                     true);
-    *size = file_size;
-    g_free(file_data);
+void macho_load_ramdisk(const char *filename, AddressSpace *as,
+                        MemoryRegion *mem, hwaddr pa, uint64_t *size)
+{
+    g_autofree uint8_t *file_data = NULL;
+
+    file_data = load_ramdisk_from_file(filename, size);
+    macho_load_image(as, mem, "RAMDisk", pa, file_data, *size);
+}
+
+static void *apple_boot_load_dtb_thread(void *opaque)
+{
+    AppleBootImages *images = opaque;
+
+    images->device_tree = load_dtb_from_file(images->dtb_filename);
+    return NULL;
 }
 
-void macho_load_raw_file(const char *filename, AddressSpace *as,
-                         MemoryRegion *mem, hwaddr file_pa, uint64_t *size)
+static void *apple_boot_load_trustcache_thread(void *opaque)
+{
+    AppleBootImages *images = opaque;
+
+    images->trustcache = load_trustcache_from_file(
+        images->trustcache_filename, images->extra_trustcache_filenames,
+        &images->trustcache_size);
+    return NULL;
+}
+
+static void *apple_boot_load_ramdisk_thread(void *opaque)
+{
+    AppleBootImages *images = opaque;
+
+    images->ramdisk =
+        load_ramdisk_from_file(images->ramdisk_filename, &images->ramdisk_size);
+    return NULL;
+}
+
+void apple_boot_load_images(AppleBootImages *images)
+{
+    QemuThread threads[3];
+    uint32_t count = 0;
+    uint32_t i;
+
+    // Every image owns its own buffers and ASN.1 tree, so the decoders
+    // share no state. Errors are fatal, so any thread may exit.
+    if (images->dtb_filename != NULL) {
+        qemu_thread_create(&threads[count++], "img4-dtb",
+                           apple_boot_load_dtb_thread, images,
+                           QEMU_THREAD_JOINABLE);
+    }
+    if (images->trustcache_filename != NULL) {
+        qemu_thread_create(&threads[count++], "img4-trustcache",
+                           apple_boot_load_trustcache_thread, images,
+                           QEMU_THREAD_JOINABLE);
+    }
+    if (images->ramdisk_filename != NULL) {
+        qemu_thread_create(&threads[count++], "img4-ramdisk",
+                           apple_boot_load_ramdisk_thread, images,
+                           QEMU_THREAD_JOINABLE);
+    }
+
+    // The kernel is usually the largest image; decode it here.
+    if (images->kernel_filename != NULL) {
+        images->kernel = macho_load_file(images->kernel_filename, NULL);
+    }
+
+    for (i = 0; i < count; i++) {
+        qemu_thread_join(&threads[i]);
+    }
+}
+
+void macho_load_raw_file(const char *filename, const char *name,
+                         AddressSpace *as, MemoryRegion *mem, hwaddr file_pa,
+                         uint64_t *size)
 {
     uint8_t *file_data;
     gsize sizef;
 
     if (g_file_get_contents(filename, (gchar **)&file_data, &sizef, NULL)) {
         *size = sizef;
-        address_space_rw(as, file_pa, MEMTXATTRS_UNSPECIFIED, file_data, sizef,
-                         true);
+        macho_load_image(as, mem, name, file_pa, file_data, sizef);
         g_free(file_data);
     } else {
         error_setg(&error_fatal, "file read for `%s` failed", filename);
@@ -1082,15 +1300,21 @@ static MachoSection64 *endsect(MachoSegmentCommand64 *seg)
     return &sp[seg->nsects];
 }
 
-static void macho_process_symbols(MachoHeader64 *mh, uint64_t slide)
+// Apply the kernel slide to `dst`, a copy of the segments of `mh` laid out
+// like macho_get_buffer(). The load commands are read from `mh`, which is
+// left untouched.
+static void macho_slide_image(MachoHeader64 *mh, uint8_t *dst, uint64_t slide)
 {
     MachoLoadCommand *cmd;
-    uint8_t *data;
     uint64_t kernel_low, kernel_high;
     uint32_t index;
     void *base;
     MachoSegmentCommand64 *linkedit_seg;
+    MachoSegmentCommand64 *seg;
+    MachoSection64 *sp;
+    MachoHeader64 *text_mh;
     MachoNList64 *sym;
+    uint64_t *ptr;
     uint32_t off;
     hwaddr text_base;
 
@@ -1100,19 +1324,51 @@ static void macho_process_symbols(MachoHeader64 *mh, uint64_t slide)
 
     macho_highest_lowest(mh, &kernel_low, &kernel_high);
 
-    data = macho_get_buffer(mh);
     linkedit_seg = macho_get_segment(mh, "__LINKEDIT");
 
     cmd = (MachoLoadCommand *)(mh + 1);
     for (index = 0; index < mh->n_cmds; index++) {
         switch (cmd->cmd) {
+        case LC_SEGMENT_64: {
+            MachoSegmentCommand64 *segCmd = (MachoSegmentCommand64 *)cmd;
+
+            if (segCmd->vmsize == 0) {
+                break;
+            }
+
+            for (sp = firstsect(segCmd); sp != endsect(segCmd);
+                 sp = nextsect(sp)) {
+                if ((sp->flags & SECTION_TYPE) != S_NON_LAZY_SYMBOL_POINTERS) {
+                    continue;
+                }
+                for (ptr = (uint64_t *)(dst + sp->addr - kernel_low);
+                     ptr < (uint64_t *)(dst + sp->addr - kernel_low + sp->size);
+                     ptr++) {
+                    *ptr += slide;
+                }
+            }
+
+            if (strcmp(segCmd->segname, "__TEXT") == 0) {
+                text_mh = (MachoHeader64 *)(dst + segCmd->vmaddr - kernel_low);
+                g_assert_cmphex(text_mh->magic, ==, MACH_MAGIC_64);
+                for (seg = macho_get_firstseg(text_mh); seg != NULL;
+                     seg = macho_get_nextseg(text_mh, seg)) {
+                    seg->vmaddr += slide;
+                    for (sp = firstsect(seg); sp != endsect(seg);
+                         sp = nextsect(sp)) {
+                        sp->addr += slide;
+                    }
+                }
+            }
+            break;
+        }
         case LC_SYMTAB: {
             MachoSymtabCommand *symtab = (MachoSymtabCommand *)cmd;
             if (linkedit_seg == NULL) {
                 error_report("Did not find __LINKEDIT segment");
                 return;
             }
-            base = data + (linkedit_seg->vmaddr - kernel_low);
+            base = dst + (linkedit_seg->vmaddr - kernel_low);
             off = linkedit_seg->fileoff;
             sym = (MachoNList64 *)(base + (symtab->sym_off - off));
             for (int i = 0; i < symtab->nsyms; i++) {
@@ -1134,13 +1390,13 @@ static void macho_process_symbols(MachoHeader64 *mh, uint64_t slide)
                 return;
             }
 
-            base = data + (linkedit_seg->vmaddr - kernel_low);
+            base = dst + (linkedit_seg->vmaddr - kernel_low);
             off = linkedit_seg->fileoff;
             macho_text_base(mh, &text_base);
             for (size_t i = 0; i < dysymtab->loc_rel_n; i++) {
                 int32_t r_address =
                     *(int32_t *)(base + (dysymtab->loc_rel_off - off) + i * 8);
-                *(uint64_t *)(data + ((text_base - kernel_low) + r_address)) +=
+                *(uint64_t *)(dst + ((text_base - kernel_low) + r_address)) +=
                     slide;
             }
             break;
@@ -1182,6 +1438,31 @@ void macho_allocate_segment_records(DTBNode *memory_map, MachoHeader64 *mh)
     }
 }
 
+/*
+ * Write the segments of an image slid in a host buffer to guest memory.
+ * Only the segments are written, so the gaps between them are left alone
+ * just like when the image is slid in place.
+ */
+static void macho_write_slid_segments(MachoHeader64 *mh, AddressSpace *as,
+                                      hwaddr phys_base, uint64_t virt_low,
+                                      const uint8_t *slid)
+{
+    MachoLoadCommand *cmd = (MachoLoadCommand *)(mh + 1);
+    MachoSegmentCommand64 *seg;
+    unsigned int index;
+
+    for (index = 0; index < mh->n_cmds; index++) {
+        seg = (MachoSegmentCommand64 *)cmd;
+        if (cmd->cmd == LC_SEGMENT_64 &&
+            strncmp(seg->segname, "__PAGEZERO", 11) != 0 && seg->vmsize != 0) {
+            address_space_write(as, phys_base + seg->vmaddr - virt_low,
+                                MEMTXATTRS_UNSPECIFIED,
+                                slid + seg->vmaddr - virt_low, seg->vmsize);
+        }
+        cmd = (MachoLoadCommand *)((char *)cmd + cmd->cmd_size);
+    }
+}
+
 hwaddr arm_load_macho(MachoHeader64 *mh, AddressSpace *as, MemoryRegion *mem,
                       DTBNode *memory_map, hwaddr phys_base,
                       uint64_t virt_slide)
@@ -1194,13 +1475,27 @@ hwaddr arm_load_macho(MachoHeader64 *mh, AddressSpace *as, MemoryRegion *mem,
     uint64_t virt_low, virt_high;
     macho_highest_lowest(mh, &virt_low, &virt_high);
     bool is_fileset = mh->file_type == MH_FILESET;
-    MachoHeader64 *mh2 = NULL;
-    void *load_from2 = NULL;
+    uint8_t *slid = NULL;
+    hwaddr slid_len = virt_high - virt_low;
+    bool slid_mapped = false;
+
+    // A slid image is copied into guest RAM as is and the slide is applied
+    // there, so the host image is never modified. Fall back to a host copy
+    // if the destination is not directly accessible.
+    if (!is_fileset && virt_slide != 0) {
+        slid = address_space_map(as, phys_base, &slid_len, true,
+                                 MEMTXATTRS_UNSPECIFIED);
+        slid_mapped = slid != NULL && slid_len == virt_high - virt_low;
+        if (!slid_mapped) {
+            if (slid != NULL) {
+                address_space_unmap(as, slid, slid_len, true, 0);
+            }
+            slid_len = virt_high - virt_low;
+            slid = g_malloc0(slid_len);
+        }
+    }
 
     cmd = (MachoLoadCommand *)(mh + 1);
-    if (!is_fileset) {
-        macho_process_symbols(mh, virt_slide);
-    }
     for (index = 0; index < mh->n_cmds; index++) {
         switch (cmd->cmd) {
         case LC_SEGMENT_64: {
@@ -1209,6 +1504,7 @@ hwaddr arm_load_macho(MachoHeader64 *mh, AddressSpace *as, MemoryRegion *mem,
                 continue;
             }
             char region_name[64] = { 0 };
+            // macho_parse() zero fills every segment up to its vmsize.
             void *load_from = (void *)(data + segCmd->vmaddr - virt_low);
             hwaddr load_to = (phys_base + segCmd->vmaddr - virt_low);
             if (memory_map) {
@@ -1229,84 +1525,23 @@ hwaddr arm_load_macho(MachoHeader64 *mh, AddressSpace *as, MemoryRegion *mem,
                 break;
             }
 
-            if (!is_fileset) {
-                MachoSection64 *sp;
-                for (sp = firstsect(segCmd); sp != endsect(segCmd);
-                     sp = nextsect(sp)) {
-                    if ((sp->flags & SECTION_TYPE) ==
-                        S_NON_LAZY_SYMBOL_POINTERS) {
-                        load_from2 = (void *)(data + sp->addr - virt_low);
-                        void **nl_symbol_ptr;
-                        for (nl_symbol_ptr = load_from2;
-                             nl_symbol_ptr < (void **)(load_from2 + sp->size);
-                             nl_symbol_ptr++) {
-                            *nl_symbol_ptr += virt_slide;
-                        }
-                    }
-                }
-            }
-
-            if (!is_fileset) {
-                if (strcmp(segCmd->segname, "__TEXT") == 0) {
-                    mh2 = load_from;
-                    MachoSegmentCommand64 *seg;
-                    g_assert_cmphex(mh2->magic, ==, MACH_MAGIC_64);
-                    for (seg = macho_get_firstseg(mh2); seg != NULL;
-                         seg = macho_get_nextseg(mh2, seg)) {
-                        MachoSection64 *sp;
-                        seg->vmaddr += virt_slide;
-                        for (sp = firstsect(seg); sp != endsect(seg);
-                             sp = nextsect(sp)) {
-                            sp->addr += virt_slide;
-                        }
-                    }
-                }
-            }
-
-
 #if 0
             error_report(
                 "Loading %s to 0x%" PRIx64 " (filesize: 0x%" PRIx64 " vmsize: 0x%" PRIx64 ")",
                 region_name, load_to, segCmd->filesize, segCmd->vmsize);
 #endif
-            uint8_t *buf = g_malloc0(segCmd->vmsize);
-            memcpy(buf, load_from, segCmd->filesize);
-            address_space_rw(as, load_to, MEMTXATTRS_UNSPECIFIED, buf,
-                             segCmd->vmsize, true);
-            g_free(buf);
-
-            if (!is_fileset) {
-                if (strcmp(segCmd->segname, "__TEXT") == 0) {
-                    mh2 = load_from;
-                    MachoSegmentCommand64 *seg;
-                    g_assert_cmphex(mh2->magic, ==, MACH_MAGIC_64);
-                    for (seg = macho_get_firstseg(mh2); seg != NULL;
-                         seg = macho_get_nextseg(mh2, seg)) {
-                        MachoSection64 *sp;
-                        seg->vmaddr -= virt_slide;
-                        for (sp = firstsect(seg); sp != endsect(seg);
-                             sp = nextsect(sp)) {
-                            sp->addr -= virt_slide;
-                        }
-                    }
-                }
-            }
-
-            if (!is_fileset) {
-                MachoSection64 *sp;
-                for (sp = firstsect(segCmd); sp != endsect(segCmd);
-                     sp = nextsect(sp)) {
-                    if ((sp->flags & SECTION_TYPE) ==
-                        S_NON_LAZY_SYMBOL_POINTERS) {
-                        load_from2 = (void *)(data + sp->addr - virt_low);
-                        void **nl_symbol_ptr;
-                        for (nl_symbol_ptr = load_from2;
-                             nl_symbol_ptr < (void **)(load_from2 + sp->size);
-                             nl_symbol_ptr++) {
-                            *nl_symbol_ptr -= virt_slide;
-                        }
-                    }
-                }
+            if (slid != NULL) {
+                memcpy(slid + segCmd->vmaddr - virt_low, load_from,
+                       segCmd->vmsize);
+            } else if (memory_map && virt_slide == 0 &&
+                       (segCmd->initprot & VM_PROT_WRITE) == 0) {
+                // Only unslid read-only segments are identical between
+                // instances
+                macho_load_image(as, mem, region_name, load_to, load_from,
+                                 segCmd->vmsize);
+            } else {
+                address_space_write(as, load_to, MEMTXATTRS_UNSPECIFIED,
+                                    load_from, segCmd->vmsize);
             }
             break;
         }
@@ -1328,8 +1563,14 @@ hwaddr arm_load_macho(MachoHeader64 *mh, AddressSpace *as, MemoryRegion *mem,
         cmd = (MachoLoadCommand *)((char *)cmd + cmd->cmd_size);
     }
 
-    if (!is_fileset) {
-        macho_process_symbols(mh, -virt_slide);
+    if (slid != NULL) {
+        macho_slide_image(mh, slid, virt_slide);
+        if (slid_mapped) {
+            address_space_unmap(as, slid, slid_len, true, slid_len);
+        } else {
+            macho_write_slid_segments(mh, as, phys_base, virt_low, slid);
+            g_free(slid);
+        }
     }
 
     return pc;
@@ -1347,31 +1588,14 @@ uint8_t *macho_get_buffer(MachoHeader64 *hdr)
 
 void macho_free(MachoHeader64 *hdr)
 {
-    g_free(macho_get_buffer(hdr));
-}
-
-MachoFilesetEntryCommand *macho_get_fileset(MachoHeader64 *header,
-                                            const char *entry)
-{
-    if (header->file_type != MH_FILESET) {
-        return NULL;
-    }
-    MachoFilesetEntryCommand *fileset;
-    fileset =
-        (MachoFilesetEntryCommand *)((char *)header + sizeof(MachoHeader64));
+    uint64_t lowaddr = 0, highaddr = 0;
+    uint8_t *buffer = macho_get_buffer(hdr);
 
-    for (uint32_t i = 0; i < header->n_cmds; i++) {
-        if (fileset->cmd == LC_FILESET_ENTRY) {
-            const char *entry_id = (char *)fileset + fileset->entry_id;
-            if (!strcmp(entry_id, entry)) {
-                return fileset;
-            }
-        }
+    // Drop the indexes of this image and of the headers nested in it.
+    macho_highest_lowest(hdr, &lowaddr, &highaddr);
+    macho_index_drop(buffer, buffer + (highaddr - lowaddr));
 
-        fileset =
-            (MachoFilesetEntryCommand *)((char *)fileset + fileset->cmd_size);
-    }
-    return NULL;
+    g_free(buffer);
 }
 
 MachoHeader64 *macho_get_fileset_header(MachoHeader64 *header,
@@ -1386,31 +1610,6 @@ MachoHeader64 *macho_get_fileset_header(MachoHeader64 *header,
     return sub_header;
 }
 
-MachoSegmentCommand64 *macho_get_segment(MachoHeader64 *header,
-                                         const char *segname)
-{
-    uint32_t i;
-
-    if (header->file_type == MH_FILESET) {
-        return macho_get_segment(
-            macho_get_fileset_header(header, "com.apple.kernel"), segname);
-    } else {
-        MachoSegmentCommand64 *sgp;
-
-
-        for (sgp = (MachoSegmentCommand64 *)(header + 1), i = 0;
-             i < header->n_cmds; i++,
-            sgp = (MachoSegmentCommand64 *)((char *)sgp + sgp->cmd_size)) {
-            if (sgp->cmd == LC_SEGMENT_64) {
-                if (strncmp(sgp->segname, segname, sizeof(sgp->segname)) == 0)
-                    return sgp;
-            }
-        }
-    }
-
-    return NULL;
-}
-
 MachoSection64 *macho_get_section(MachoSegmentCommand64 *seg,
                                   const char *sect_name)
 {
@@ -0,0 +1,180 @@
+/*
+ * Apple Mach-O name index.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/arm/apple-silicon/boot.h"
+
+// Name lookups on a Mach-O go through an index built on first use, so that
+// patchers asking for many kexts of a fileset do not walk hundreds of load
+// commands per query. Only used by the boot code, on the main thread.
+typedef struct {
+    // Entry ID -> MachoFilesetEntryCommand, for MH_FILESET only.
+    GHashTable *filesets;
+    // Segment name -> MachoSegmentCommand64. For MH_FILESET these are the
+    // segments of com.apple.kernel.
+    GHashTable *segments;
+    // "segment,section" -> MachoSection64.
+    GHashTable *sections;
+} MachoIndex;
+
+static GHashTable *macho_indexes;
+
+static void macho_index_free(gpointer data)
+{
+    MachoIndex *index = data;
+
+    g_hash_table_destroy(index->filesets);
+    g_hash_table_destroy(index->segments);
+    g_hash_table_destroy(index->sections);
+    g_free(index);
+}
+
+static char *macho_section_key(const char *segname, const char *sect_name)
+{
+    return g_strdup_printf("%.16s,%.16s", segname, sect_name);
+}
+
+static void macho_index_insert(GHashTable *table, char *key, gpointer value)
+{
+    // Keep the first match, like a linear walk of the load commands would.
+    if (g_hash_table_contains(table, key)) {
+        g_free(key);
+    } else {
+        g_hash_table_insert(table, key, value);
+    }
+}
+
+static void macho_index_segments(MachoIndex *index, MachoHeader64 *header)
+{
+    MachoSegmentCommand64 *sgp;
+    MachoSection64 *sp;
+    uint32_t i;
+    uint32_t j;
+
+    for (sgp = (MachoSegmentCommand64 *)(header + 1), i = 0;
+         i < header->n_cmds;
+         i++, sgp = (MachoSegmentCommand64 *)((char *)sgp + sgp->cmd_size)) {
+        if (sgp->cmd != LC_SEGMENT_64) {
+            continue;
+        }
+
+        macho_index_insert(index->segments,
+                           g_strndup(sgp->segname, sizeof(sgp->segname)), sgp);
+
+        for (sp = (MachoSection64 *)(sgp + 1), j = 0; j < sgp->nsects;
+             j++, sp++) {
+            macho_index_insert(index->sections,
+                               macho_section_key(sgp->segname, sp->sect_name),
+                               sp);
+        }
+    }
+}
+
+static MachoIndex *macho_get_index(MachoHeader64 *header)
+{
+    MachoFilesetEntryCommand *fileset;
+    MachoHeader64 *kernel;
+    MachoIndex *index;
+    uint32_t i;
+
+    if (macho_indexes == NULL) {
+        macho_indexes = g_hash_table_new_full(NULL, NULL, NULL,
+                                              macho_index_free);
+    }
+
+    index = g_hash_table_lookup(macho_indexes, header);
+    if (index != NULL) {
+        return index;
+    }
+
+    index = g_new0(MachoIndex, 1);
+    index->filesets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            NULL);
+    index->segments = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            NULL);
+    index->sections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            NULL);
+
+    if (header->file_type == MH_FILESET) {
+        fileset = (MachoFilesetEntryCommand *)(header + 1);
+        for (i = 0; i < header->n_cmds; i++) {
+            if (fileset->cmd == LC_FILESET_ENTRY) {
+                macho_index_insert(
+                    index->filesets,
+                    g_strdup((char *)fileset + fileset->entry_id), fileset);
+            }
+            fileset = (MachoFilesetEntryCommand *)((char *)fileset +
+                                                   fileset->cmd_size);
+        }
+
+        fileset = g_hash_table_lookup(index->filesets, "com.apple.kernel");
+        if (fileset != NULL) {
+            kernel = (MachoHeader64 *)((char *)header + fileset->file_off);
+            macho_index_segments(index, kernel);
+        }
+    } else {
+        macho_index_segments(index, header);
+    }
+
+    g_hash_table_insert(macho_indexes, header, index);
+    return index;
+}
+
+static gboolean macho_index_in_range(gpointer key, gpointer value,
+                                     gpointer data)
+{
+    const uint8_t **range = data;
+
+    return (const uint8_t *)key >= range[0] &&
+           (const uint8_t *)key < range[1];
+}
+
+void macho_index_drop(const uint8_t *start, const uint8_t *end)
+{
+    const uint8_t *range[2] = { start, end };
+
+    if (macho_indexes != NULL) {
+        g_hash_table_foreach_remove(macho_indexes, macho_index_in_range,
+                                    range);
+    }
+}
+
+MachoFilesetEntryCommand *macho_get_fileset(MachoHeader64 *header,
+                                            const char *entry)
+{
+    if (header->file_type != MH_FILESET) {
+        return NULL;
+    }
+
+    return g_hash_table_lookup(macho_get_index(header)->filesets, entry);
+}
+
+MachoSegmentCommand64 *macho_get_segment(MachoHeader64 *header,
+                                         const char *segname)
+{
+    return g_hash_table_lookup(macho_get_index(header)->segments, segname);
+}
+
+MachoSection64 *macho_find_section(MachoHeader64 *header, const char *segname,
+                                   const char *sect_name)
+{
+    g_autofree char *key = macho_section_key(segname, sect_name);
+
+    return g_hash_table_lookup(macho_get_index(header)->sections, key);
+}
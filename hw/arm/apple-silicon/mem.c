@@ -18,12 +18,18 @@
  */
 
 #include "qemu/osdep.h"
+#include "crypto/hash.h"
 #include "exec/hwaddr.h"
+#include "exec/exec-all.h"
 #include "exec/memory.h"
 #include "hw/arm/apple-silicon/dtb.h"
 #include "hw/arm/apple-silicon/mem.h"
+#include "migration/vmstate.h"
 #include "qapi/error.h"
 #include "qemu/error-report.h"
+#include "qemu/madvise.h"
+#include "qemu/rcu.h"
+#include "system/tcg.h"
 
 hwaddr g_virt_base, g_phys_base, g_virt_slide, g_phys_slide;
 
@@ -67,6 +73,227 @@ MemoryRegion *allocate_ram(MemoryRegion *top, const char *name, hwaddr addr,
     return sec;
 }
 
+static hwaddr clear_ram_section(AddressSpace *as, hwaddr addr, hwaddr size)
+{
+    MemoryRegion *mr;
+    RAMBlock *rb;
+    hwaddr xlat;
+    hwaddr len = size;
+    hwaddr page_size;
+    hwaddr head;
+    hwaddr body;
+    ram_addr_t ram_addr;
+
+    RCU_READ_LOCK_GUARD();
+
+    mr = address_space_translate(as, addr, &xlat, &len, true,
+                                 MEMTXATTRS_UNSPECIFIED);
+    rb = mr->ram_block;
+
+    // Only anonymous RAM reads back as zero after a discard; file backed
+    // blocks would revert to the file contents instead.
+    if (!memory_region_is_ram(mr) || memory_region_is_rom(mr) || mr->readonly ||
+        rb == NULL || qemu_ram_get_fd(rb) >= 0 ||
+        ram_block_discard_is_disabled()) {
+        address_space_set(as, addr, 0, len, MEMTXATTRS_UNSPECIFIED);
+        return len;
+    }
+
+    page_size = qemu_ram_pagesize(rb);
+    head = MIN(ROUND_UP(xlat, page_size) - xlat, len);
+    body = ROUND_DOWN(len - head, page_size);
+
+    if (body == 0) {
+        address_space_set(as, addr, 0, len, MEMTXATTRS_UNSPECIFIED);
+        return len;
+    }
+
+    if (head != 0) {
+        address_space_set(as, addr, 0, head, MEMTXATTRS_UNSPECIFIED);
+    }
+
+    if (ram_block_discard_range(rb, xlat + head, body) != 0) {
+        address_space_set(as, addr + head, 0, body, MEMTXATTRS_UNSPECIFIED);
+        return head + body;
+    }
+
+    // The pages changed behind the back of the softmmu; drop any code
+    // translated from them and let dirty tracking see the new contents.
+    ram_addr = memory_region_get_ram_addr(mr) + xlat + head;
+    if (tcg_enabled()) {
+        tb_invalidate_phys_range(ram_addr, ram_addr + body - 1);
+    }
+    memory_region_set_dirty(mr, xlat + head, body);
+
+    return head + body;
+}
+
+void clear_ram(AddressSpace *as, hwaddr addr, hwaddr size)
+{
+    hwaddr len;
+
+    while (size != 0) {
+        len = clear_ram_section(as, addr, size);
+        addr += len;
+        size -= len;
+    }
+}
+
+typedef struct {
+    MemoryRegion mr;
+    MemoryRegion alias;
+    hwaddr size;
+    bool mapped;
+    struct rcu_head rcu;
+} SharedImage;
+
+static GHashTable *shared_images;
+
+static bool shared_image_create_file(const char *path, const void *data,
+                                     hwaddr size, hwaddr file_size)
+{
+    g_autofree char *tmp_path = NULL;
+    int fd;
+    bool ret;
+
+    if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+        return true;
+    }
+
+    // write under a private name and rename, so that concurrently starting
+    // instances never map a partially written image
+    tmp_path = g_strdup_printf("%s.%d.tmp", path, getpid());
+    fd = qemu_create(tmp_path, O_WRONLY | O_TRUNC, 0644, NULL);
+    if (fd < 0) {
+        return false;
+    }
+    ret = qemu_write_full(fd, data, size) == (ssize_t)size &&
+          ftruncate(fd, file_size) == 0;
+    close(fd);
+
+    if (!ret || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool allocate_shared_image(const char *name, const char *cache_dir,
+                           const void *data, hwaddr size)
+{
+    SharedImage *img;
+    g_autofree char *digest = NULL;
+    g_autofree char *path = NULL;
+    g_autofree char *alias_name = NULL;
+    hwaddr file_size;
+    Error *err = NULL;
+
+    if (cache_dir == NULL || size == 0) {
+        return false;
+    }
+
+    if (shared_images == NULL) {
+        shared_images = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              NULL);
+    }
+    g_assert_null(g_hash_table_lookup(shared_images, name));
+
+    if (qcrypto_hash_digest(QCRYPTO_HASH_ALGO_SHA256, data, size, &digest,
+                            &err) < 0) {
+        warn_report_err(err);
+        return false;
+    }
+
+    file_size = ROUND_UP(size, qemu_real_host_page_size());
+    path = g_strdup_printf("%s/%s.img", cache_dir, digest);
+    if (!shared_image_create_file(path, data, size, file_size)) {
+        warn_report("Failed to create shared image `%s`", path);
+        return false;
+    }
+
+    img = g_new0(SharedImage, 1);
+    // A private mapping of the file: untouched pages come from the page
+    // cache shared by every instance, written pages are copied on write.
+    if (!memory_region_init_ram_from_file(&img->mr, NULL, name, file_size, 0,
+                                          RAM_READONLY_FD, path, 0, &err)) {
+        warn_report_err(err);
+        g_free(img);
+        return false;
+    }
+    vmstate_register_ram_global(&img->mr);
+
+    // The file is padded to a host page, but only the image itself may
+    // shadow guest RAM; whatever follows it stays visible.
+    alias_name = g_strdup_printf("%s-map", name);
+    memory_region_init_alias(&img->alias, NULL, alias_name, &img->mr, 0, size);
+    img->size = size;
+    g_hash_table_insert(shared_images, g_strdup(name), img);
+
+    return true;
+}
+
+static void shared_image_drop(MemoryRegion *top, const char *name,
+                              SharedImage *img)
+{
+    if (img->mapped) {
+        memory_region_del_subregion(top, &img->alias);
+    }
+    vmstate_unregister_ram(&img->mr, NULL);
+    object_unparent(OBJECT(&img->alias));
+    object_unparent(OBJECT(&img->mr));
+    g_hash_table_remove(shared_images, name);
+    // readers of the old flat view may still hold the regions
+    g_free_rcu(img, rcu);
+}
+
+bool map_shared_image(MemoryRegion *top, const char *name, hwaddr addr,
+                      const void *data, hwaddr size)
+{
+    SharedImage *img;
+    ram_addr_t ram_addr;
+    void *ptr;
+
+    img = shared_images == NULL ? NULL :
+                                  g_hash_table_lookup(shared_images, name);
+    if (img == NULL) {
+        return false;
+    }
+
+    // Drop the pages the guest has privatised since the last reset, so the
+    // mapping reads back as the file again.
+    ptr = memory_region_get_ram_ptr(&img->mr);
+    qemu_madvise(ptr, memory_region_size(&img->mr), QEMU_MADV_DONTNEED);
+    ram_addr = memory_region_get_ram_addr(&img->mr);
+    if (tcg_enabled()) {
+        tb_invalidate_phys_range(ram_addr, ram_addr + img->size - 1);
+    }
+    memory_region_set_dirty(&img->mr, 0, img->size);
+
+    if (img->size != size || memcmp(ptr, data, size) != 0) {
+        // The image changed since machine init; it is never shared again.
+        shared_image_drop(top, name, img);
+        return false;
+    }
+
+    if (!QEMU_IS_ALIGNED(addr, qemu_real_host_page_size())) {
+        if (img->mapped) {
+            memory_region_del_subregion(top, &img->alias);
+            img->mapped = false;
+        }
+        return false;
+    }
+
+    if (img->mapped) {
+        memory_region_set_address(&img->alias, addr);
+    } else {
+        memory_region_add_subregion_overlap(top, addr, &img->alias, 1);
+        img->mapped = true;
+    }
+
+    return true;
+}
+
 struct CarveoutAllocator {
     hwaddr dram_base;
     hwaddr end;
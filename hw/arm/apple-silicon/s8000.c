@@ -47,6 +47,7 @@
 #include "hw/usb/apple_otg.h"
 #include "hw/watchdog/apple_wdt.h"
 #include "qapi/error.h"
+#include "qapi/qapi-builtin-visit.h"
 #include "qapi/visitor.h"
 #include "qemu/error-report.h"
 #include "qemu/guest-random.h"
@@ -273,8 +274,8 @@ static void s8000_load_classic_kc(S8000MachineState *s8000_machine,
 
     info->sep_fw_addr = phys_ptr;
     if (s8000_machine->sep_fw_filename) {
-        macho_load_raw_file(s8000_machine->sep_fw_filename, nsas, sysmem,
-                            info->sep_fw_addr, &info->sep_fw_size);
+        macho_load_raw_file(s8000_machine->sep_fw_filename, "SEPFW", nsas,
+                            sysmem, info->sep_fw_addr, &info->sep_fw_size);
     }
     info->sep_fw_size = ROUND_UP_16K(8 * MiB);
     phys_ptr += info->sep_fw_size;
@@ -764,7 +765,9 @@ static void s8000_create_pcie(S8000MachineState *s8000_machine)
     g_assert_nonnull(prop);
     ints = (uint32_t *)prop->data;
 
-    for (i = 0; i < prop->length / sizeof(uint32_t); i++) {
+    // the trailing MSI entry is not a sysbus IRQ, its vectors go out as "msi"
+    for (i = 0; i < prop->length / sizeof(uint32_t) && sysbus_has_irq(pcie, i);
+         i++) {
         sysbus_connect_irq(
             pcie, i, qdev_get_gpio_in(DEVICE(s8000_machine->aic), ints[i]));
     }
@@ -1352,6 +1355,7 @@ static void s8000_machine_init(MachineState *machine)
 
     s8000_machine->trustcache =
         load_trustcache_from_file(s8000_machine->trustcache_filename,
+                                  s8000_machine->extra_trustcache_filenames,
                                   &s8000_machine->boot_info.trustcache_size);
 
     dtb_set_prop_u32(s8000_machine->device_tree, "clock-frequency", 24000000);
@@ -1474,6 +1478,31 @@ static char *s8000_get_trustcache_filename(Object *obj, Error **errp)
     return g_strdup(s8000_machine->trustcache_filename);
 }
 
+static void s8000_get_extra_trustcache(Object *obj, Visitor *v,
+                                       const char *name, void *opaque,
+                                       Error **errp)
+{
+    S8000MachineState *s8000_machine = S8000_MACHINE(obj);
+
+    visit_type_strList(v, name, &s8000_machine->extra_trustcache_filenames,
+                       errp);
+}
+
+static void s8000_set_extra_trustcache(Object *obj, Visitor *v,
+                                       const char *name, void *opaque,
+                                       Error **errp)
+{
+    S8000MachineState *s8000_machine = S8000_MACHINE(obj);
+    strList *list = NULL;
+
+    if (!visit_type_strList(v, name, &list, errp)) {
+        return;
+    }
+
+    qapi_free_strList(s8000_machine->extra_trustcache_filenames);
+    s8000_machine->extra_trustcache_filenames = list;
+}
+
 static void s8000_set_ticket_filename(Object *obj, const char *value,
                                       Error **errp)
 {
@@ -1631,6 +1660,12 @@ static void s8000_machine_class_init(ObjectClass *klass, void *data)
                                   s8000_set_trustcache_filename);
     object_class_property_set_description(klass, "trustcache",
                                           "Trustcache to be loaded");
+    object_class_property_add(klass, "extra-trustcache", "strList",
+                              s8000_get_extra_trustcache,
+                              s8000_set_extra_trustcache, NULL, NULL);
+    object_class_property_set_description(
+        klass, "extra-trustcache",
+        "Additional trustcaches, as extra-trustcache.0=a,extra-trustcache.1=b");
     object_class_property_add_str(klass, "ticket", s8000_get_ticket_filename,
                                   s8000_set_ticket_filename);
     object_class_property_set_description(klass, "ticket",
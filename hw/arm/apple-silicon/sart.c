@@ -1,6 +1,7 @@
 #include "qemu/osdep.h"
 #include "exec/address-spaces.h"
 #include "hw/arm/apple-silicon/sart.h"
+#include "migration/vmstate.h"
 
 // #define DEBUG_SART
 
@@ -232,12 +233,42 @@ SysBusDevice *apple_sart_create(DTBNode *node)
     return sbd;
 }
 
+static int apple_sart_post_load(void *opaque, int version_id)
+{
+    AppleSARTState *s;
+
+    s = APPLE_SART(opaque);
+
+    // The decoded regions are a cache of the registers.
+    for (int i = 0; i < SART_NUM_REGIONS; i++) {
+        s->regions[i].addr = sart_get_region_addr(s, i);
+        s->regions[i].size = sart_get_region_size(s, i);
+        s->regions[i].flags = sart_get_region_flags(s, i);
+    }
+
+    return 0;
+}
+
+static const VMStateDescription vmstate_apple_sart = {
+    .name = "AppleSARTState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .post_load = apple_sart_post_load,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT32_ARRAY(reg, AppleSARTState,
+                                 0x8000 / sizeof(uint32_t)),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static void apple_sart_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
 
     device_class_set_legacy_reset(dc, apple_sart_reset);
     dc->desc = "Apple SART IOMMU";
+    dc->vmsd = &vmstate_apple_sart;
 }
 
 static void apple_sart_iommu_memory_region_class_init(ObjectClass *klass,
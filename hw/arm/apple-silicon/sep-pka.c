@@ -0,0 +1,95 @@
+/*
+ * Apple SEP PKA attestation.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/arm/apple-silicon/sep-pka.h"
+#include "qemu/bswap.h"
+#include "nettle/bignum.h"
+#include "nettle/ecc-curve.h"
+#include "nettle/ecc.h"
+#include "nettle/sha2.h"
+
+#define PKA_DEVICE_KEY_LABEL "SEP PKA device key"
+
+// Stands in for the fused per-device key: derived from the identity the
+// SEP locks into the block, so it is stable for a given ECID and chip.
+static void pka_device_key(const uint32_t *ecid_chipid_misc,
+                           uint32_t chip_revision, struct ecc_scalar *key)
+{
+    struct sha256_ctx ctx;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    uint8_t word[sizeof(uint32_t)];
+    mpz_t k;
+    int i;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, sizeof(PKA_DEVICE_KEY_LABEL) - 1,
+                  (const uint8_t *)PKA_DEVICE_KEY_LABEL);
+    for (i = 0; i < APPLE_PKA_ECID_WORDS; i++) {
+        stl_le_p(word, ecid_chipid_misc[i]);
+        sha256_update(&ctx, sizeof(word), word);
+    }
+    stl_le_p(word, chip_revision);
+    sha256_update(&ctx, sizeof(word), word);
+    sha256_digest(&ctx, sizeof(digest), digest);
+
+    // Any value in [1, 2^255) is below the P-256 group order.
+    mpz_init(k);
+    nettle_mpz_set_str_256_u(k, sizeof(digest), digest);
+    mpz_clrbit(k, 255);
+    if (mpz_sgn(k) == 0) {
+        mpz_set_ui(k, 1);
+    }
+
+    ecc_scalar_init(key, nettle_get_secp_256r1());
+    g_assert_cmpuint(ecc_scalar_set(key, k), !=, 0);
+    mpz_clear(k);
+}
+
+void apple_pka_ecpub_attest(const uint32_t *ecid_chipid_misc,
+                            uint32_t chip_revision, const uint8_t *img4_dgst,
+                            const uint8_t *input, uint8_t *public_key,
+                            uint8_t *attest_hash)
+{
+    struct ecc_scalar key;
+    struct ecc_point pub;
+    struct sha256_ctx ctx;
+    mpz_t x, y;
+
+    pka_device_key(ecid_chipid_misc, chip_revision, &key);
+    ecc_point_init(&pub, nettle_get_secp_256r1());
+    ecc_point_mul_g(&pub, &key);
+
+    mpz_init(x);
+    mpz_init(y);
+    ecc_point_get(&pub, x, y);
+    nettle_mpz_get_str_256(APPLE_PKA_PUBLIC_KEY_SIZE / 2, public_key, x);
+    nettle_mpz_get_str_256(APPLE_PKA_PUBLIC_KEY_SIZE / 2,
+                           public_key + APPLE_PKA_PUBLIC_KEY_SIZE / 2, y);
+    mpz_clear(x);
+    mpz_clear(y);
+    ecc_point_clear(&pub);
+    ecc_scalar_clear(&key);
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, APPLE_PKA_PUBLIC_KEY_SIZE, public_key);
+    sha256_update(&ctx, APPLE_PKA_DIGEST_SIZE, img4_dgst);
+    sha256_update(&ctx, APPLE_PKA_INPUT_SIZE, input);
+    sha256_digest(&ctx, APPLE_PKA_DIGEST_SIZE, attest_hash);
+}
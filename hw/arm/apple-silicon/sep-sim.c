@@ -24,7 +24,9 @@
 #include "hw/arm/apple-silicon/sep-sim.h"
 #include "hw/misc/apple-silicon/a7iop/core.h"
 #include "hw/misc/apple-silicon/a7iop/mailbox/core.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
 #include "hw/resettable.h"
+#include "migration/vmstate.h"
 #include "qapi/error.h"
 #include "qemu/lockable.h"
 #include "qemu/log.h"
@@ -513,6 +515,7 @@ static void apple_sep_sim_handle_bootstrap_msg(AppleSEPSimState *s,
                       "Firmware type: %s\n",
                       s->rsep ? "rsep" : "sepi");
         s->status = SEP_STATUS_ACTIVE;
+        apple_boot_milestone("sep-boot");
 
         apple_sep_sim_send_message(s, EP_BOOTSTRAP, msg->tag,
                                    BOOTSTRAP_OP_TZ0_ACCEPTED, 0, 0);
@@ -1075,6 +1078,53 @@ static void apple_sep_sim_reset_hold(Object *obj, ResetType type)
     apple_a7iop_send_ap(a7iop, msg);
 }
 
+static const VMStateDescription vmstate_apple_sep_sim_ool_info = {
+    .name = "AppleSEPSimOOLInfo",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT8(in_min_pages, AppleSEPSimOOLInfo),
+            VMSTATE_UINT8(in_max_pages, AppleSEPSimOOLInfo),
+            VMSTATE_UINT8(out_min_pages, AppleSEPSimOOLInfo),
+            VMSTATE_UINT8(out_max_pages, AppleSEPSimOOLInfo),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static const VMStateDescription vmstate_apple_sep_sim_ool_state = {
+    .name = "AppleSEPSimOOLState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT64(in_addr, AppleSEPSimOOLState),
+            VMSTATE_UINT32(in_size, AppleSEPSimOOLState),
+            VMSTATE_UINT64(out_addr, AppleSEPSimOOLState),
+            VMSTATE_UINT32(out_size, AppleSEPSimOOLState),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static const VMStateDescription vmstate_apple_sep_sim = {
+    .name = "AppleSEPSimState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_APPLE_A7IOP(parent_obj, AppleSEPSimState),
+            VMSTATE_UINT32(status, AppleSEPSimState),
+            VMSTATE_STRUCT_ARRAY(ool_info, AppleSEPSimState, SEP_ENDPOINT_MAX,
+                                 0, vmstate_apple_sep_sim_ool_info,
+                                 AppleSEPSimOOLInfo),
+            VMSTATE_STRUCT_ARRAY(ool_state, AppleSEPSimState,
+                                 SEP_ENDPOINT_MAX, 0,
+                                 vmstate_apple_sep_sim_ool_state,
+                                 AppleSEPSimOOLState),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static void apple_sep_sim_class_init(ObjectClass *klass, void *data)
 {
     ResettableClass *rc = RESETTABLE_CLASS(klass);
@@ -1087,6 +1137,7 @@ static void apple_sep_sim_class_init(ObjectClass *klass, void *data)
     device_class_set_parent_realize(dc, apple_sep_sim_realize,
                                     &sc->parent_realize);
     dc->desc = "Simulated Apple Secure Enclave";
+    dc->vmsd = &vmstate_apple_sep_sim;
     set_bit(DEVICE_CATEGORY_MISC, dc->categories);
 }
 
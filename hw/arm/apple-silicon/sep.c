@@ -24,6 +24,7 @@
 #include "exec/address-spaces.h"
 #include "hw/arm/apple-silicon/a13.h"
 #include "hw/arm/apple-silicon/a9.h"
+#include "hw/arm/apple-silicon/sep-pka.h"
 #include "hw/arm/apple-silicon/sep.h"
 #include "hw/boards.h"
 #include "hw/core/cpu.h"
@@ -32,17 +33,24 @@
 #include "hw/irq.h"
 #include "hw/misc/apple-silicon/a7iop/core.h"
 #include "hw/misc/apple-silicon/a7iop/private.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
 #include "hw/misc/unimp.h"
 #include "hw/nvram/eeprom_at24c.h"
 #include "hw/or-irq.h"
 #include "hw/qdev-properties-system.h"
 #include "hw/qdev-properties.h"
 #include "hw/resettable.h"
+#include "migration/qemu-file-types.h"
+#include "migration/vmstate.h"
 #include "qapi/error.h"
+#include "qapi/visitor.h"
 #include "qemu/cutils.h"
+#include "qemu/error-report.h"
 #include "qemu/log.h"
+#include "qemu/timer.h"
 #include "qemu/units.h"
 #include "qom/object.h"
+#include "nettle/bignum.h"
 #include "nettle/ccm.h"
 #include "nettle/cmac.h"
 #include "nettle/ecc-curve.h"
@@ -71,8 +79,6 @@
     } while (0)
 #endif
 
-// #define ENABLE_CPU_DUMP_STATE
-
 #define SEP_ENABLE_HARDCODED_FIRMWARE
 #define SEP_ENABLE_DEBUG_TRACE_MAPPING
 #define SEP_ENABLE_TRACE_BUFFER
@@ -165,6 +171,144 @@
 #define SEP_AESS_SEED_BITS_IMG4_VERIFIED (1 << 31) // img4 verified?
 
 
+typedef enum {
+    SEP_TRACE_REG_READ = 0,
+    SEP_TRACE_REG_WRITE,
+    SEP_TRACE_MBOX_SEND,
+    SEP_TRACE_MBOX_RECV,
+    SEP_TRACE_KIND_COUNT,
+} AppleSEPTraceKind;
+
+typedef enum {
+    SEP_BLOCK_DEBUG_TRACE = 0,
+    SEP_BLOCK_TRNG,
+    SEP_BLOCK_PMGR_BASE,
+    SEP_BLOCK_KEY_BASE,
+    SEP_BLOCK_KEY_FCFG,
+    SEP_BLOCK_MONI_BASE,
+    SEP_BLOCK_MONI_THRM,
+    SEP_BLOCK_EISP_BASE,
+    SEP_BLOCK_EISP_HMAC,
+    SEP_BLOCK_AESS_BASE,
+    SEP_BLOCK_AESH_BASE,
+    SEP_BLOCK_PKA_BASE,
+    SEP_BLOCK_PKA_TMM,
+    SEP_BLOCK_MISC2,
+    SEP_BLOCK_BOOT_MONITOR,
+    SEP_BLOCK_PROGRESS,
+    SEP_BLOCK_MBOX_AP,
+    SEP_BLOCK_MBOX_IOP,
+    SEP_BLOCK_COUNT,
+} AppleSEPTraceBlock;
+
+static const char *const sep_trace_kind_names[SEP_TRACE_KIND_COUNT] = {
+    [SEP_TRACE_REG_READ] = "read",
+    [SEP_TRACE_REG_WRITE] = "write",
+    [SEP_TRACE_MBOX_SEND] = "send",
+    [SEP_TRACE_MBOX_RECV] = "recv",
+};
+
+static const char *const sep_trace_block_names[SEP_BLOCK_COUNT] = {
+    [SEP_BLOCK_DEBUG_TRACE] = "debug-trace",
+    [SEP_BLOCK_TRNG] = "trng",
+    [SEP_BLOCK_PMGR_BASE] = "pmgr-base",
+    [SEP_BLOCK_KEY_BASE] = "key-base",
+    [SEP_BLOCK_KEY_FCFG] = "key-fcfg",
+    [SEP_BLOCK_MONI_BASE] = "moni-base",
+    [SEP_BLOCK_MONI_THRM] = "moni-thrm",
+    [SEP_BLOCK_EISP_BASE] = "eisp-base",
+    [SEP_BLOCK_EISP_HMAC] = "eisp-hmac",
+    [SEP_BLOCK_AESS_BASE] = "aess-base",
+    [SEP_BLOCK_AESH_BASE] = "aesh-base",
+    [SEP_BLOCK_PKA_BASE] = "pka-base",
+    [SEP_BLOCK_PKA_TMM] = "pka-tmm",
+    [SEP_BLOCK_MISC2] = "misc2",
+    [SEP_BLOCK_BOOT_MONITOR] = "boot-monitor",
+    [SEP_BLOCK_PROGRESS] = "progress",
+    [SEP_BLOCK_MBOX_AP] = "mbox-ap",
+    [SEP_BLOCK_MBOX_IOP] = "mbox-iop",
+};
+
+// Only meaningful on the SEP core itself; the PC is the last one TCG
+// synchronised, which is good enough to tell where the firmware spins.
+static uint64_t sep_trace_pc(AppleSEPState *s)
+{
+    CPUARMState *env = &s->cpu->env;
+
+    if (current_cpu != CPU(s->cpu)) {
+        return 0;
+    }
+
+    return is_a64(env) ? env->pc : env->regs[15];
+}
+
+static void sep_trace_push(AppleSEPState *s, AppleSEPTraceKind kind,
+                           AppleSEPTraceBlock block, uint64_t pc,
+                           uint64_t addr, uint64_t value, unsigned size)
+{
+    AppleSEPTraceEntry *e;
+
+    e = &s->trace_ring[s->trace_ring_count % s->trace_ring_size];
+    e->ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    e->pc = pc;
+    e->addr = addr;
+    e->value = value;
+    e->kind = kind;
+    e->block = block;
+    e->size = size;
+    s->trace_ring_count += 1;
+}
+
+static inline void sep_trace_reg_read(AppleSEPState *s,
+                                      AppleSEPTraceBlock block, hwaddr addr,
+                                      unsigned size)
+{
+    uint64_t pc;
+
+    if (s->trace_ring == NULL &&
+        !trace_event_get_state_backends(TRACE_APPLE_SEP_REG_READ)) {
+        return;
+    }
+
+    pc = sep_trace_pc(s);
+    trace_apple_sep_reg_read(sep_trace_block_names[block], pc, addr, size);
+    if (s->trace_ring != NULL) {
+        sep_trace_push(s, SEP_TRACE_REG_READ, block, pc, addr, 0, size);
+    }
+}
+
+static inline void sep_trace_reg_write(AppleSEPState *s,
+                                       AppleSEPTraceBlock block, hwaddr addr,
+                                       uint64_t data, unsigned size)
+{
+    uint64_t pc;
+
+    if (s->trace_ring == NULL &&
+        !trace_event_get_state_backends(TRACE_APPLE_SEP_REG_WRITE)) {
+        return;
+    }
+
+    pc = sep_trace_pc(s);
+    trace_apple_sep_reg_write(sep_trace_block_names[block], pc, addr, data,
+                              size);
+    if (s->trace_ring != NULL) {
+        sep_trace_push(s, SEP_TRACE_REG_WRITE, block, pc, addr, data, size);
+    }
+}
+
+static void sep_trace_mailbox(void *opaque, AppleA7IOPMailbox *mbox,
+                              const AppleA7IOPMessage *msg, bool send)
+{
+    AppleSEPState *s = opaque;
+
+    sep_trace_push(s, send ? SEP_TRACE_MBOX_SEND : SEP_TRACE_MBOX_RECV,
+                   mbox == APPLE_A7IOP(s)->ap_mailbox ? SEP_BLOCK_MBOX_AP :
+                                                        SEP_BLOCK_MBOX_IOP,
+                   sep_trace_pc(s), ldq_le_p(msg->data),
+                   ldq_le_p(msg->data + sizeof(uint64_t)),
+                   sizeof(msg->data));
+}
+
 // static uint32_t AESS_UID[0x20 / 4] = {0xdeadbeef, 0x13371337, 0xa55a5aa5,
 // 0xcafecafe, 0xc4f3c4f3, 0xd34db33f, 0x73317331, 0x5aa5a55a};
 static uint32_t AESS_UID0[0x20 / 4] = { 0xdeadbeef, 0x13370000, 0xa55a0000,
@@ -433,9 +577,7 @@ static void debug_trace_reg_write(void *opaque, hwaddr addr, uint64_t data,
         return;
     }
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    // cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_DEBUG_TRACE, addr, data, size);
 
     if (s->shmbuf_base == 0) {
         qemu_log_mask(
@@ -809,9 +951,7 @@ static uint64_t debug_trace_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_DEBUG_TRACE, addr, size);
     if (!s->shmbuf_base) {
         qemu_log_mask(
             LOG_UNIMP,
@@ -894,22 +1034,38 @@ static const MemoryRegionOps debug_trace_reg_ops = {
 #define REG_TRNG_COUNTER_LOW (0x68)
 #define REG_TRNG_COUNTER_HI (0x6c)
 
+static QCryptoCipher *sep_cipher_get(AppleSEPCipherCache *c,
+                                     QCryptoCipherAlgo alg,
+                                     QCryptoCipherMode mode,
+                                     const uint8_t *key, size_t key_len)
+{
+    g_assert_cmpuint(key_len, <=, sizeof(c->key));
+
+    if (c->cipher != NULL && c->alg == alg && c->mode == mode &&
+        c->key_len == key_len && memcmp(c->key, key, key_len) == 0) {
+        return c->cipher;
+    }
+
+    qcrypto_cipher_free(c->cipher);
+    c->cipher = qcrypto_cipher_new(alg, mode, key, key_len, &error_abort);
+    g_assert_nonnull(c->cipher);
+    c->alg = alg;
+    c->mode = mode;
+    memcpy(c->key, key, key_len);
+    c->key_len = key_len;
+
+    return c->cipher;
+}
+
 static void trng_regs_reg_write(void *opaque, hwaddr addr, uint64_t data,
                                 unsigned size)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep;
-    AppleTRNGState *s;
+    AppleTRNGState *s = opaque;
+    AppleSEPState *sep = s->sep;
     uint32_t enabled;
 
-    sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
     AppleA7IOP *a7iop = APPLE_A7IOP(sep);
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(sep->cpu), stderr, CPU_DUMP_CODE);
-#endif
-
-    s = (AppleTRNGState *)opaque;
+    sep_trace_reg_write(sep, SEP_BLOCK_TRNG, addr, data, size);
 
 #if 0
     DPRINTF(
@@ -928,13 +1084,12 @@ static void trng_regs_reg_write(void *opaque, hwaddr addr, uint64_t data,
             ((s->offset_0x70 & 0x40) != 0)) {
             QCryptoCipher *cipher;
 
-            cipher = qcrypto_cipher_new(QCRYPTO_CIPHER_ALGO_AES_256,
-                                        QCRYPTO_CIPHER_MODE_ECB, s->key,
-                                        sizeof(s->key), &error_abort);
-            g_assert_nonnull(cipher);
+            cipher = sep_cipher_get(&s->cipher_cache,
+                                    QCRYPTO_CIPHER_ALGO_AES_256,
+                                    QCRYPTO_CIPHER_MODE_ECB, s->key,
+                                    sizeof(s->key));
             qcrypto_cipher_encrypt(cipher, s->fifo, s->fifo, sizeof(s->fifo),
                                    &error_abort);
-            qcrypto_cipher_free(cipher);
         }
         break;
     case REG_TRNG_STATUS:
@@ -1028,19 +1183,12 @@ static void trng_regs_reg_write(void *opaque, hwaddr addr, uint64_t data,
 
 static uint64_t trng_regs_reg_read(void *opaque, hwaddr addr, unsigned size)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep;
-    AppleTRNGState *s;
+    AppleTRNGState *s = opaque;
+    AppleSEPState *sep = s->sep;
     uint64_t ret = 0;
 
-    sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
     AppleA7IOP *a7iop = APPLE_A7IOP(sep);
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(sep->cpu), stderr, CPU_DUMP_CODE);
-#endif
-
-    s = (AppleTRNGState *)opaque;
+    sep_trace_reg_read(sep, SEP_BLOCK_TRNG, addr, size);
 
     uint32_t enabled = (s->config & TRNG_CONTROL_ENABLED) != 0;
     switch (addr) {
@@ -1144,9 +1292,7 @@ static void pmgr_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_PMGR_BASE, addr, data, size);
     switch (addr) {
     case 0x20: // mod_PKA ; PKA0 ; arg8 is 0xc8
     case 0x28: // mod_TRNG
@@ -1236,9 +1382,7 @@ static uint64_t pmgr_base_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_PMGR_BASE, addr, size);
     memcpy(&ret, &s->pmgr_base_regs[addr], size);
     switch (addr) {
     case 0x20: // mod_PKA ; PKA0 ; arg8 is 0xc8
@@ -1290,9 +1434,7 @@ static void key_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_KEY_BASE, addr, data, size);
     switch (addr) {
     case 0x8: // command or storage index: 0x20-0x26, 0x30-0x31, 0x04 (without
               // input)
@@ -1336,9 +1478,7 @@ static uint64_t key_base_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_KEY_BASE, addr, size);
     switch (addr) {
     default:
         memcpy(&ret, &s->key_base_regs[addr], size);
@@ -1369,9 +1509,7 @@ static void key_fcfg_reg_write(void *opaque, hwaddr addr, uint64_t data,
     AppleSEPState *s = APPLE_SEP(opaque);
     AppleA7IOP *a7iop = APPLE_A7IOP(s);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_KEY_FCFG, addr, data, size);
     switch (addr) {
     case 0x0:
         // if (data == 0x3)
@@ -1463,9 +1601,7 @@ static uint64_t key_fcfg_reg_read(void *opaque, hwaddr addr, unsigned size)
     uint8_t key_fcfg_offset_0x14_index = 0;
     uint8_t key_fcfg_offset_0x14_index_limit = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_KEY_FCFG, addr, size);
     switch (addr) {
     case 0x14:
         // it'll complain otherwise:
@@ -1520,9 +1656,7 @@ static void moni_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_MONI_BASE, addr, data, size);
     switch (addr) {
     default:
         memcpy(&s->moni_base_regs[addr], &data, size);
@@ -1539,9 +1673,7 @@ static uint64_t moni_base_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_MONI_BASE, addr, size);
     switch (addr) {
     default:
         memcpy(&ret, &s->moni_base_regs[addr], size);
@@ -1571,9 +1703,7 @@ static void moni_thrm_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_MONI_THRM, addr, data, size);
     switch (addr) {
     default:
         memcpy(&s->moni_thrm_regs[addr], &data, size);
@@ -1590,9 +1720,7 @@ static uint64_t moni_thrm_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_MONI_THRM, addr, size);
     switch (addr) {
     default:
         memcpy(&ret, &s->moni_thrm_regs[addr], size);
@@ -1622,9 +1750,7 @@ static void eisp_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_EISP_BASE, addr, data, size);
     switch (addr) {
     default:
         memcpy(&s->eisp_base_regs[addr], &data, size);
@@ -1641,9 +1767,7 @@ static uint64_t eisp_base_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_EISP_BASE, addr, size);
     switch (addr) {
     default:
         memcpy(&ret, &s->eisp_base_regs[addr], size);
@@ -1679,9 +1803,7 @@ static void eisp_hmac_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_EISP_HMAC, addr, data, size);
     switch (addr) {
     default:
         memcpy(&s->eisp_hmac_regs[addr], &data, size);
@@ -1698,9 +1820,7 @@ static uint64_t eisp_hmac_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_EISP_HMAC, addr, size);
     switch (addr) {
     default:
         memcpy(&ret, &s->eisp_hmac_regs[addr], size);
@@ -1755,9 +1875,7 @@ static void xor_32bit_value(uint8_t *dest, uint32_t val, int size)
 
 static void aess_raise_interrupt(AppleAESSState *s)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
+    AppleSEPState *sep = s->sep;
     // bit1==interrupts_enabled; bit0==interrupt_will_activate ?
     if ((s->interrupt_enabled & 0x3) == 0x3) {
         s->interrupt_status |= 0x1;
@@ -1805,9 +1923,8 @@ static void aess_keywrap_uid(AppleAESSState *s, uint8_t *in, uint8_t *out,
             s->reg_0x18_keydisable);
     HEXDUMP("aess_keywrap_uid: used_key", used_key, sizeof(used_key));
     HEXDUMP("aess_keywrap_uid: in", in, data_len);
-    cipher = qcrypto_cipher_new(cipher_alg, QCRYPTO_CIPHER_MODE_CBC, used_key,
-                                key_len, &error_abort);
-    g_assert_nonnull(cipher);
+    cipher = sep_cipher_get(&s->cipher_cache, cipher_alg,
+                            QCRYPTO_CIPHER_MODE_CBC, used_key, key_len);
     uint8_t iv[0x10] = { 0 };
     memset(iv, 0x00, sizeof(iv));
     qcrypto_cipher_setiv(cipher, iv, sizeof(iv), &error_abort);
@@ -1828,7 +1945,6 @@ static void aess_keywrap_uid(AppleAESSState *s, uint8_t *in, uint8_t *out,
     memcpy(out, enc_temp, data_len);
     HEXDUMP("aess_keywrap_uid: out1", out, data_len);
     s->reg_0x14_keywrap_iterations_counter = 0;
-    qcrypto_cipher_free(cipher);
     // only enabled by driver_ops 0x4/0x1d (keywrap) if
     // iterations_counter is over 10/0xa.
     aess_raise_interrupt(s);
@@ -2022,9 +2138,8 @@ static void aess_handle_cmd(AppleAESSState *s)
             }
         }
         QCryptoCipher *cipher;
-        cipher = qcrypto_cipher_new(cipher_alg, QCRYPTO_CIPHER_MODE_CBC,
-                                    used_key, key_len, &error_abort);
-        g_assert_nonnull(cipher);
+        cipher = sep_cipher_get(&s->cipher_cache, cipher_alg,
+                                QCRYPTO_CIPHER_MODE_CBC, used_key, key_len);
         uint8_t iv[0x10] = { 0 };
         uint8_t in[0x10] = { 0 };
         if (do_encryption) {
@@ -2051,6 +2166,10 @@ static void aess_handle_cmd(AppleAESSState *s)
                                    &error_abort);
             memcpy(s->tag_out, iv, sizeof(iv));
         } else {
+            // The cached cipher carries the chaining state of its last use.
+            uint8_t zero_iv[0x10] = { 0 };
+            qcrypto_cipher_setiv(cipher, zero_iv, sizeof(zero_iv),
+                                 &error_abort);
             qcrypto_cipher_decrypt(cipher, in, s->tag_out, sizeof(in),
                                    &error_abort);
             qcrypto_cipher_setiv(
@@ -2059,7 +2178,6 @@ static void aess_handle_cmd(AppleAESSState *s)
             qcrypto_cipher_decrypt(cipher, in, s->out, sizeof(in),
                                    &error_abort);
         }
-        qcrypto_cipher_free(cipher);
     }
 #endif
 #if 1
@@ -2160,16 +2278,10 @@ jump_return:
 static void aess_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
                                 unsigned size)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
-    AppleAESSState *s;
-    s = (AppleAESSState *)opaque;
-
-#ifdef ENABLE_CPU_DUMP_STATE
-    DPRINTF("\n");
-    cpu_dump_state(CPU(sep->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    AppleAESSState *s = opaque;
+    AppleSEPState *sep = s->sep;
+
+    sep_trace_reg_write(sep, SEP_BLOCK_AESS_BASE, addr, data, size);
     switch (addr) {
     case SEP_AESS_REGISTER_STATUS: // Status
         s->status = data;
@@ -2241,17 +2353,11 @@ static void aess_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 
 static uint64_t aess_base_reg_read(void *opaque, hwaddr addr, unsigned size)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
-    AppleAESSState *s;
-    s = (AppleAESSState *)opaque;
+    AppleAESSState *s = opaque;
+    AppleSEPState *sep = s->sep;
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    DPRINTF("\n");
-    cpu_dump_state(CPU(sep->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(sep, SEP_BLOCK_AESS_BASE, addr, size);
     switch (addr) {
     case SEP_AESS_REGISTER_STATUS: // Status
         s->status &= ~(1 << 1);
@@ -2331,9 +2437,7 @@ static void aesh_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_AESH_BASE, addr, data, size);
     switch (addr) {
     // case 0xb4: 0x40 bytes from TRNG
     default:
@@ -2353,9 +2457,7 @@ static uint64_t aesh_base_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_AESH_BASE, addr, size);
     switch (addr) {
     // from misc0: 0xc, 0xf4
     case 0xc: // ???? bit1 clear, bit0 set
@@ -2387,39 +2489,70 @@ static const MemoryRegionOps aesh_base_reg_ops = {
     .valid.unaligned = false,
 };
 
+// The other command values, ECDH and ECDSA among them, are unknown and
+// are ignored; see sep-pka.h.
+#define PKA_CMD_MIGRATE_DATA (0x40)
+#define PKA_CMD_ECPUB_ATTEST (0x80)
+
+static void pka_ecpub_attest(ApplePKAState *s)
+{
+    apple_pka_ecpub_attest(s->ecid_chipid_misc, s->chip_revision,
+                           s->img4out_dgst, s->input0, s->public_key,
+                           s->attest_hash);
+}
+
+static void pka_complete(ApplePKAState *s)
+{
+    AppleA7IOP *a7iop = APPLE_A7IOP(s->sep);
+
+    switch (s->pending_command) {
+    case PKA_CMD_ECPUB_ATTEST:
+        pka_ecpub_attest(s);
+        break;
+    default:
+        break;
+    }
+    s->pending_command = 0;
+
+    apple_a7iop_interrupt_status_push(a7iop->iop_mailbox,
+                                      0x1000a); // ack first interrupt/0xa
+    // apple_a7iop_interrupt_status_push(a7iop->iop_mailbox,
+    // 0x1000b); // ack second interrupt/0xb
+    apple_a7iop_interrupt_status_push(a7iop->iop_mailbox,
+                                      0x1000c); // ack third interrupt/0xc
+}
+
+static void pka_timer_expired(void *opaque)
+{
+    pka_complete(opaque);
+}
+
+static void pka_start(ApplePKAState *s, uint32_t command)
+{
+    s->pending_command = command;
+
+    if (s->sep->pka_latency_ns == 0) {
+        pka_complete(s);
+        return;
+    }
+
+    timer_mod(s->timer,
+              qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + s->sep->pka_latency_ns);
+}
+
 static void pka_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
                                unsigned size)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
-    ApplePKAState *s;
-    s = (ApplePKAState *)opaque;
+    ApplePKAState *s = opaque;
+    AppleSEPState *sep = s->sep;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(sep->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(sep, SEP_BLOCK_PKA_BASE, addr, data, size);
     switch (addr) {
     case 0x0: // maybe command
         // values: 0x4/0x8/0x10/0x20/0x40/0x80/0x100
-        if (data == 0x40) { // migrate data with PKA
-            apple_a7iop_interrupt_status_push(
-                APPLE_A7IOP(sep)->iop_mailbox,
-                0x1000a); // ack first interrupt/0xa
-            // apple_a7iop_interrupt_status_push(APPLE_A7IOP(sep)->iop_mailbox,
-            // 0x1000b); // ack second interrupt/0xb
-            apple_a7iop_interrupt_status_push(
-                APPLE_A7IOP(sep)->iop_mailbox,
-                0x1000c); // ack third interrupt/0xc
-        } else if (data == 0x80) { // MPKA_ECPUB_ATTEST
-            apple_a7iop_interrupt_status_push(
-                APPLE_A7IOP(sep)->iop_mailbox,
-                0x1000a); // ack first interrupt/0xa
-            // apple_a7iop_interrupt_status_push(APPLE_A7IOP(sep)->iop_mailbox,
-            // 0x1000b); // ack second interrupt/0xb
-            apple_a7iop_interrupt_status_push(
-                APPLE_A7IOP(sep)->iop_mailbox,
-                0x1000c); // ack third interrupt/0xc
+        s->command = data;
+        if (data == PKA_CMD_MIGRATE_DATA || data == PKA_CMD_ECPUB_ATTEST) {
+            pka_start(s, data);
         }
         goto jump_default;
     case 0x4: // maybe status_out0
@@ -2446,7 +2579,8 @@ static void pka_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
             memcpy(&s->img4out_dgst[addr & 0x1f], &data, 4);
         }
         goto jump_default;
-    case 0x80 ... 0x9c: // some data
+    case 0x80 ... 0xfc: // request data
+        memcpy(&s->input0[addr - 0x80], &data, 4);
         goto jump_default;
     case 0x800: // chip revision locked
         s->chip_revision_locked |= (data & 1);
@@ -2480,16 +2614,11 @@ static void pka_base_reg_write(void *opaque, hwaddr addr, uint64_t data,
 
 static uint64_t pka_base_reg_read(void *opaque, hwaddr addr, unsigned size)
 {
-    MachineState *machine = MACHINE(qdev_get_machine());
-    AppleSEPState *sep = APPLE_SEP(
-        object_property_get_link(OBJECT(machine), "sep", &error_fatal));
-    ApplePKAState *s;
-    s = (ApplePKAState *)opaque;
+    ApplePKAState *s = opaque;
+    AppleSEPState *sep = s->sep;
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(sep->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(sep, SEP_BLOCK_PKA_BASE, addr, size);
     switch (addr) {
     case 0x8: // maybe status_in0/interrupt_status
 #if 1
@@ -2511,6 +2640,12 @@ static uint64_t pka_base_reg_read(void *opaque, hwaddr addr, unsigned size)
     case 0x60 ... 0x7c: // img4out DGST data
         memcpy(&ret, &s->img4out_dgst[addr & 0x1f], 4);
         goto jump_default;
+    case 0x100 ... 0x13c: // attestation public key, X then Y
+        memcpy(&ret, &s->public_key[addr - 0x100], 4);
+        goto jump_default;
+    case 0x180 ... 0x19c: // attestation hash
+        memcpy(&ret, &s->attest_hash[addr - 0x180], 4);
+        goto jump_default;
     case 0x800: // chip revision locked
         ret = s->chip_revision_locked;
         goto jump_default;
@@ -2555,9 +2690,7 @@ static void pka_tmm_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_PKA_TMM, addr, data, size);
     switch (addr) {
     case 0x818 ... 0x834: // some data
         // correct?
@@ -2580,9 +2713,7 @@ static uint64_t pka_tmm_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_PKA_TMM, addr, size);
     switch (addr) {
     case 0x818 ... 0x834:
         // TODO
@@ -2618,9 +2749,7 @@ static void misc2_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_MISC2, addr, data, size);
     switch (addr) {
     // Some engine?: case 0x28: 0x8 bytes from TRNG
     default:
@@ -2638,9 +2767,7 @@ static uint64_t misc2_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_MISC2, addr, size);
     switch (addr) {
     case 0x24: // ????
         return 0x0;
@@ -2671,9 +2798,7 @@ static void boot_monitor_reg_write(void *opaque, hwaddr addr, uint64_t data,
 {
     AppleSEPState *s = APPLE_SEP(opaque);
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_BOOT_MONITOR, addr, data, size);
     switch (addr) {
     case 0x04: // some status flag, bit0
         data &= ~(1 << 0); // reset bit0 for read
@@ -2708,9 +2833,7 @@ static uint64_t boot_monitor_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_BOOT_MONITOR, addr, size);
     switch (addr) {
     case 0x04: // some status flag, bit0
         goto jump_default;
@@ -2951,9 +3074,7 @@ static void progress_reg_write(void *opaque, hwaddr addr, uint64_t data,
     AppleSEPState *s = APPLE_SEP(opaque);
     SEPMessage sep_msg = { 0 };
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_write(s, SEP_BLOCK_PROGRESS, addr, data, size);
     switch (addr) {
     case 0x4:
         if (data ==
@@ -3184,9 +3305,7 @@ static uint64_t progress_reg_read(void *opaque, hwaddr addr, unsigned size)
     AppleSEPState *s = APPLE_SEP(opaque);
     uint64_t ret = 0;
 
-#ifdef ENABLE_CPU_DUMP_STATE
-    cpu_dump_state(CPU(s->cpu), stderr, CPU_DUMP_CODE);
-#endif
+    sep_trace_reg_read(s, SEP_BLOCK_PROGRESS, addr, size);
     switch (addr) {
     default:
         memcpy(&ret, &s->progress_regs[addr], size);
@@ -3239,6 +3358,7 @@ static void apple_sep_iop_start(AppleA7IOP *s)
     if (sep->modern && load_addr != 0) {
         DPRINTF("%s: have load_addr 0x" HWADDR_FMT_plx "\n", __func__,
                 load_addr);
+        apple_boot_milestone("sep-boot");
         async_safe_run_on_cpu(CPU(sep->cpu), apple_sep_cpu_moni_jump,
                               RUN_ON_CPU_TARGET_PTR(load_addr));
     }
@@ -3332,6 +3452,11 @@ AppleSEPState *apple_sep_create(DTBNode *node, MemoryRegion *ool_mr, vaddr base,
 
     // AKF_MBOX reg is handled using the device tree
     // XPRT_{PMSC,FUSE,MISC} regs are handled in t8030.c
+    s->trng_state.sep = s;
+    s->aess_state.sep = s;
+    s->pka_state.sep = s;
+    s->pka_state.timer =
+        timer_new_ns(QEMU_CLOCK_VIRTUAL, pka_timer_expired, &s->pka_state);
     memory_region_init_io(&s->pmgr_base_mr, OBJECT(dev), &pmgr_base_reg_ops, s,
                           "sep.pmgr_base", PMGR_BASE_REG_SIZE); // T8030
     sysbus_init_mmio(sbd, &s->pmgr_base_mr);
@@ -3506,6 +3631,14 @@ static void apple_sep_realize(DeviceState *dev, Error **errp)
                                 qdev_get_gpio_in(s->irq_or, 1));
     // qdev_connect_gpio_out_named(DEVICE(APPLE_A7IOP(s)->ap_mailbox),
     // APPLE_A7IOP_IOP_IRQ, 0, qdev_get_gpio_in(s->irq_or, 2));
+
+    if (s->trace_ring_size != 0) {
+        s->trace_ring = g_new0(AppleSEPTraceEntry, s->trace_ring_size);
+        APPLE_A7IOP(s)->ap_mailbox->observer = sep_trace_mailbox;
+        APPLE_A7IOP(s)->ap_mailbox->observer_opaque = s;
+        APPLE_A7IOP(s)->iop_mailbox->observer = sep_trace_mailbox;
+        APPLE_A7IOP(s)->iop_mailbox->observer_opaque = s;
+    }
 }
 
 static void aess_reset(AppleAESSState *s)
@@ -3529,6 +3662,8 @@ static void aess_reset(AppleAESSState *s)
 
 static void pka_reset(ApplePKAState *s)
 {
+    timer_del(s->timer);
+    s->pending_command = 0;
     s->command = 0;
     s->status0 = 0;
     s->status_in0 = 0;
@@ -3599,6 +3734,244 @@ static void apple_sep_reset_hold(Object *obj, ResetType type)
     map_sepfw(s);
 }
 
+// Most of the SEP register backing arrays stay zero for the whole lifetime
+// of the guest (EISP alone is 2.25 MiB), so only the non-zero runs are put
+// into the migration stream, as (offset, length, data) records.
+#define SEP_SPARSE_CHUNK (64)
+#define SEP_SPARSE_END (UINT32_MAX)
+
+static int get_sep_sparse_regs(QEMUFile *f, void *pv, size_t size,
+                               const VMStateField *field)
+{
+    uint8_t *buf = pv;
+    uint32_t off;
+    uint32_t len;
+
+    memset(buf, 0, size);
+    while ((off = qemu_get_be32(f)) != SEP_SPARSE_END) {
+        len = qemu_get_be32(f);
+        if (off > size || len > size - off) {
+            error_report("%s: %s: bad run 0x%x+0x%x (size 0x%zx)", __func__,
+                         field->name, off, len, size);
+            return -EINVAL;
+        }
+        qemu_get_buffer(f, buf + off, len);
+    }
+
+    return 0;
+}
+
+static int put_sep_sparse_regs(QEMUFile *f, void *pv, size_t size,
+                               const VMStateField *field, JSONWriter *vmdesc)
+{
+    uint8_t *buf = pv;
+    size_t off = 0;
+    size_t start;
+    size_t len;
+
+    while (off < size) {
+        len = MIN(SEP_SPARSE_CHUNK, size - off);
+        if (buffer_is_zero(buf + off, len)) {
+            off += len;
+            continue;
+        }
+        start = off;
+        do {
+            off += len;
+            len = MIN(SEP_SPARSE_CHUNK, size - off);
+        } while (off < size && !buffer_is_zero(buf + off, len));
+        qemu_put_be32(f, start);
+        qemu_put_be32(f, off - start);
+        qemu_put_buffer(f, buf + start, off - start);
+    }
+    qemu_put_be32(f, SEP_SPARSE_END);
+
+    return 0;
+}
+
+static const VMStateInfo vmstate_info_sep_sparse_regs = {
+    .name = "sep_sparse_regs",
+    .get = get_sep_sparse_regs,
+    .put = put_sep_sparse_regs,
+};
+
+#define VMSTATE_SEP_SPARSE_REGS(_field, _state)                          \
+    VMSTATE_BUFFER_UNSAFE_INFO(_field, _state, 0,                        \
+                               vmstate_info_sep_sparse_regs,             \
+                               sizeof_field(_state, _field))
+
+static const VMStateDescription vmstate_apple_trng = {
+    .name = "AppleTRNGState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT8_ARRAY(key, AppleTRNGState, 32),
+            VMSTATE_UINT8_ARRAY(fifo, AppleTRNGState, 16),
+            VMSTATE_UINT32(offset_0x70, AppleTRNGState),
+            VMSTATE_UINT64(ecid, AppleTRNGState),
+            VMSTATE_UINT64(counter, AppleTRNGState),
+            VMSTATE_UINT32(config, AppleTRNGState),
+            VMSTATE_BOOL(ctr_drbg_init, AppleTRNGState),
+            // Plain data (expanded AES key and V), no pointers.
+            VMSTATE_BUFFER_UNSAFE(ctr_drbg_rng, AppleTRNGState, 0,
+                                  sizeof(struct drbg_ctr_aes256_ctx)),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static const VMStateDescription vmstate_apple_aess = {
+    .name = "AppleAESSState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT32(status, AppleAESSState),
+            VMSTATE_UINT32(command, AppleAESSState),
+            VMSTATE_UINT32(interrupt_status, AppleAESSState),
+            VMSTATE_UINT32(interrupt_enabled, AppleAESSState),
+            VMSTATE_UINT32(reg_0x14_keywrap_iterations_counter,
+                           AppleAESSState),
+            VMSTATE_UINT32(reg_0x18_keydisable, AppleAESSState),
+            VMSTATE_UINT32(seed_bits, AppleAESSState),
+            VMSTATE_UINT32(seed_bits_lock, AppleAESSState),
+            VMSTATE_UINT8_ARRAY(in_full, AppleAESSState, 32),
+            VMSTATE_UINT8_ARRAY(out_full, AppleAESSState, 32),
+            VMSTATE_UINT8_ARRAY(key_256_in, AppleAESSState, 32),
+            VMSTATE_UINT8_ARRAY(key_t8015_in, AppleAESSState, 16),
+            VMSTATE_UINT8_ARRAY(key_256_out, AppleAESSState, 32),
+            VMSTATE_UINT8_ARRAY(key_128_out, AppleAESSState, 16),
+            VMSTATE_UINT8_ARRAY(keywrap_key_uid0, AppleAESSState, 32),
+            VMSTATE_UINT8_ARRAY(keywrap_key_uid1, AppleAESSState, 32),
+            VMSTATE_UINT8_2DARRAY(custom_key_index, AppleAESSState, 4, 32),
+            VMSTATE_BOOL_ARRAY(custom_key_index_enabled, AppleAESSState, 4),
+            VMSTATE_BOOL(keywrap_uid0_enabled, AppleAESSState),
+            VMSTATE_BOOL(keywrap_uid1_enabled, AppleAESSState),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static const VMStateDescription vmstate_apple_pka = {
+    .name = "ApplePKAState",
+    .version_id = 2,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT32(command, ApplePKAState),
+            VMSTATE_UINT32(status0, ApplePKAState),
+            VMSTATE_UINT32(status_in0, ApplePKAState),
+            VMSTATE_UINT32(img4out_dgst_locked, ApplePKAState),
+            VMSTATE_UINT8_ARRAY(img4out_dgst, ApplePKAState, 32),
+            VMSTATE_UINT8_ARRAY(output0, ApplePKAState, 32),
+            VMSTATE_UINT8_ARRAY(input0, ApplePKAState, 0x80),
+            VMSTATE_UINT8_SUB_ARRAY(public_key, ApplePKAState, 0, 32),
+            VMSTATE_UINT8_ARRAY(attest_hash, ApplePKAState, 32),
+            VMSTATE_UINT8_ARRAY(input1, ApplePKAState, 0x20a),
+            VMSTATE_UINT32(chip_revision_locked, ApplePKAState),
+            VMSTATE_UINT32(chip_revision, ApplePKAState),
+            VMSTATE_UINT32(ecid_chipid_misc_locked, ApplePKAState),
+            VMSTATE_UINT32_ARRAY(ecid_chipid_misc, ApplePKAState, 5),
+            VMSTATE_UINT32_V(pending_command, ApplePKAState, 1),
+            VMSTATE_TIMER_PTR_V(timer, ApplePKAState, 1),
+            VMSTATE_SUB_ARRAY(public_key, ApplePKAState, 32, 32, 2,
+                              vmstate_info_uint8, uint8_t),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static const VMStateDescription vmstate_apple_sep = {
+    .name = "AppleSEPState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_APPLE_A7IOP(parent_obj, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(pmgr_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(key_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(key_fcfg_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(moni_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(moni_thrm_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(eisp_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(eisp_hmac_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(aess_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(aesh_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(pka_base_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(pka_tmm_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(misc2_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(progress_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(boot_monitor_regs, AppleSEPState),
+            VMSTATE_SEP_SPARSE_REGS(debug_trace_regs, AppleSEPState),
+            VMSTATE_STRUCT(trng_state, AppleSEPState, 0, vmstate_apple_trng,
+                           AppleTRNGState),
+            VMSTATE_STRUCT(aess_state, AppleSEPState, 0, vmstate_apple_aess,
+                           AppleAESSState),
+            VMSTATE_STRUCT(pka_state, AppleSEPState, 0, vmstate_apple_pka,
+                           ApplePKAState),
+            VMSTATE_BOOL(pmgr_fuse_changer_bit0_was_set, AppleSEPState),
+            VMSTATE_BOOL(pmgr_fuse_changer_bit1_was_set, AppleSEPState),
+            VMSTATE_UINT8(key_fcfg_offset_0x14_index, AppleSEPState),
+            VMSTATE_UINT16_ARRAY(key_fcfg_offset_0x14_values, AppleSEPState,
+                                 5),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static bool apple_sep_visit_trace_entry(Visitor *v, AppleSEPTraceEntry *e,
+                                        Error **errp)
+{
+    g_autofree char *kind = g_strdup(sep_trace_kind_names[e->kind]);
+    g_autofree char *block = g_strdup(sep_trace_block_names[e->block]);
+    uint8_t size = e->size;
+    bool ok;
+
+    if (!visit_start_struct(v, NULL, NULL, 0, errp)) {
+        return false;
+    }
+    ok = visit_type_int64(v, "ns", &e->ns, errp) &&
+         visit_type_str(v, "kind", &kind, errp) &&
+         visit_type_str(v, "block", &block, errp) &&
+         visit_type_uint64(v, "pc", &e->pc, errp) &&
+         visit_type_uint64(v, "addr", &e->addr, errp) &&
+         visit_type_uint64(v, "value", &e->value, errp) &&
+         visit_type_uint8(v, "size", &size, errp);
+    visit_end_struct(v, NULL);
+    return ok;
+}
+
+static void apple_sep_get_trace_ring(Object *obj, Visitor *v,
+                                     const char *name, void *opaque,
+                                     Error **errp)
+{
+    AppleSEPState *s = APPLE_SEP(obj);
+    AppleSEPTraceEntry e;
+    uint64_t first;
+    uint64_t i;
+
+    if (!visit_start_list(v, name, NULL, 0, errp)) {
+        return;
+    }
+
+    // Oldest sample first; older ones have been overwritten.
+    first = s->trace_ring_count > s->trace_ring_size ?
+                s->trace_ring_count - s->trace_ring_size :
+                0;
+    for (i = first; i < s->trace_ring_count; i++) {
+        e = s->trace_ring[i % s->trace_ring_size];
+        if (!apple_sep_visit_trace_entry(v, &e, errp)) {
+            break;
+        }
+    }
+
+    visit_end_list(v, NULL);
+}
+
+static const Property apple_sep_props[] = {
+    // Completion delay of PKA commands; 0 completes them on submission.
+    DEFINE_PROP_UINT32("pka-latency-ns", AppleSEPState, pka_latency_ns, 0),
+    // Entries kept in the `trace-ring`; 0 disables the ring.
+    DEFINE_PROP_UINT32("trace-ring-size", AppleSEPState, trace_ring_size, 0),
+};
+
 static void apple_sep_class_init(ObjectClass *klass, void *data)
 {
     ResettableClass *rc = RESETTABLE_CLASS(klass);
@@ -3608,6 +3981,13 @@ static void apple_sep_class_init(ObjectClass *klass, void *data)
     resettable_class_set_parent_phases(rc, NULL, apple_sep_reset_hold, NULL,
                                        &sc->parent_phases);
     dc->desc = "Apple SEP";
+    dc->vmsd = &vmstate_apple_sep;
+    device_class_set_props(dc, apple_sep_props);
+    object_class_property_add(klass, "trace-ring", "AppleSEPTraceRing",
+                              apple_sep_get_trace_ring, NULL, NULL, NULL);
+    object_class_property_set_description(
+        klass, "trace-ring",
+        "Most recent SEP register accesses and mailbox messages");
     set_bit(DEVICE_CATEGORY_MISC, dc->categories);
 }
 
@@ -4613,6 +4993,92 @@ AppleSSCState *apple_ssc_create(MachineState *machine, uint8_t addr)
     return ssc;
 }
 
+// The scalars hold GMP limb pointers, so send the 384-bit value instead and
+// rebuild the scalar on the destination. Unset slots are all-zero structs.
+static int get_ssc_ecc_scalar(QEMUFile *f, void *pv, size_t size,
+                              const VMStateField *field)
+{
+    struct ecc_scalar *key = pv;
+    uint8_t buf[BYTELEN_384];
+    mpz_t temp;
+    int ret = 0;
+
+    clear_ecc_scalar(key);
+    if (qemu_get_byte(f) == 0) {
+        return 0;
+    }
+    qemu_get_buffer(f, buf, sizeof(buf));
+
+    mpz_init(temp);
+    mpz_import(temp, sizeof(buf), 1, 1, 1, 0, buf);
+    ecc_scalar_init(key, nettle_get_secp_384r1());
+    if (ecc_scalar_set(key, temp) == 0) {
+        error_report("%s: %s: scalar out of range", __func__, field->name);
+        clear_ecc_scalar(key);
+        ret = -EINVAL;
+    }
+    mpz_clear(temp);
+
+    return ret;
+}
+
+static int put_ssc_ecc_scalar(QEMUFile *f, void *pv, size_t size,
+                              const VMStateField *field, JSONWriter *vmdesc)
+{
+    struct ecc_scalar *key = pv;
+    uint8_t buf[BYTELEN_384] = { 0 };
+    mpz_t temp;
+
+    if (buffer_is_zero(key, sizeof(*key))) {
+        qemu_put_byte(f, 0);
+        return 0;
+    }
+
+    mpz_init(temp);
+    ecc_scalar_get(key, temp);
+    mpz_export(buf + sizeof(buf) - (mpz_sizeinbase(temp, 2) + 7) / 8, NULL, 1,
+               1, 1, 0, temp);
+    mpz_clear(temp);
+    qemu_put_byte(f, 1);
+    qemu_put_buffer(f, buf, sizeof(buf));
+
+    return 0;
+}
+
+static const VMStateInfo vmstate_info_ssc_ecc_scalar = {
+    .name = "ssc_ecc_scalar",
+    .get = get_ssc_ecc_scalar,
+    .put = put_ssc_ecc_scalar,
+};
+
+static const VMStateDescription vmstate_apple_ssc = {
+    .name = "AppleSSCState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_I2C_SLAVE(i2c, AppleSSCState),
+            VMSTATE_UINT32(req_cur, AppleSSCState),
+            VMSTATE_UINT32(resp_cur, AppleSSCState),
+            VMSTATE_UINT8_ARRAY(req_cmd, AppleSSCState, 1024),
+            VMSTATE_UINT8_ARRAY(resp_cmd, AppleSSCState, 1024),
+            VMSTATE_SINGLE(ecc_key_main, AppleSSCState, 0,
+                           vmstate_info_ssc_ecc_scalar, struct ecc_scalar),
+            VMSTATE_ARRAY(ecc_keys, AppleSSCState, KBKDF_KEY_MAX_SLOTS, 0,
+                          vmstate_info_ssc_ecc_scalar, struct ecc_scalar),
+            VMSTATE_UINT8_ARRAY(random_hmac_key, AppleSSCState,
+                                SHA256_DIGEST_SIZE),
+            VMSTATE_UINT8_2DARRAY(slot_hmac_key, AppleSSCState,
+                                  KBKDF_KEY_MAX_SLOTS, SHA256_DIGEST_SIZE),
+            VMSTATE_UINT8_2DARRAY(kbkdf_keys, AppleSSCState,
+                                  KBKDF_KEY_MAX_SLOTS, KBKDF_CMAC_OUTPUT_LEN),
+            VMSTATE_UINT32_ARRAY(kbkdf_counter, AppleSSCState,
+                                 KBKDF_KEY_MAX_SLOTS),
+            VMSTATE_UINT8_ARRAY(cpsn, AppleSSCState, 0x07),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static const Property apple_ssc_props[] = {
     DEFINE_PROP_DRIVE("drive", AppleSSCState, blk),
 };
@@ -4623,6 +5089,7 @@ static void apple_ssc_class_init(ObjectClass *klass, void *data)
     I2CSlaveClass *c = I2C_SLAVE_CLASS(klass);
 
     dc->desc = "Apple SSC";
+    dc->vmsd = &vmstate_apple_ssc;
     set_bit(DEVICE_CATEGORY_MISC, dc->categories);
 
     c->event = apple_ssc_event;
@@ -48,6 +48,7 @@
 #include "hw/irq.h"
 #include "hw/misc/apple-silicon/aes.h"
 #include "hw/misc/apple-silicon/aop.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
 #include "hw/misc/apple-silicon/chestnut.h"
 #include "hw/misc/apple-silicon/roswell.h"
 #include "hw/misc/apple-silicon/smc.h"
@@ -60,6 +61,7 @@
 #include "hw/ssi/ssi.h"
 #include "hw/usb/apple_typec.h"
 #include "hw/watchdog/apple_wdt.h"
+#include "qapi/qapi-builtin-visit.h"
 #include "qapi/visitor.h"
 #include "qemu/bswap.h"
 #include "qemu/error-report.h"
@@ -268,8 +270,8 @@ static bool t8030_check_panic(T8030MachineState *t8030_machine)
     address_space_rw(&address_space_memory, t8030_machine->panic_base,
                      MEMTXATTRS_UNSPECIFIED, panic_info,
                      t8030_machine->panic_size, false);
-    address_space_set(&address_space_memory, t8030_machine->panic_base, 0,
-                      t8030_machine->panic_size, MEMTXATTRS_UNSPECIFIED);
+    clear_ram(&address_space_memory, t8030_machine->panic_base,
+              t8030_machine->panic_size);
 
     ret = panic_info->magic == EMBEDDED_PANIC_MAGIC;
     g_free(panic_info);
@@ -311,6 +313,56 @@ static void get_kaslr_slides(T8030MachineState *t8030_machine,
     *virt_slide_out = slide_virt;
 }
 
+/*
+ * The RAM disk decoded at init is only kept until it has been copied into
+ * guest RAM. Later resets decode it again instead of keeping hundreds of
+ * MiB resident for the lifetime of the VM.
+ */
+static void t8030_load_ramdisk(T8030MachineState *t8030_machine,
+                               AddressSpace *nsas, MemoryRegion *sysmem,
+                               hwaddr addr)
+{
+    MachineState *machine = MACHINE(t8030_machine);
+    AppleBootInfo *info = &t8030_machine->boot_info;
+    uint64_t size;
+
+    if (t8030_machine->ramdisk == NULL) {
+        macho_load_ramdisk(machine->initrd_filename, nsas, sysmem, addr,
+                           &size);
+    } else {
+        size = t8030_machine->ramdisk_size;
+        macho_load_image(nsas, sysmem, "RAMDisk", addr, t8030_machine->ramdisk,
+                         size);
+        g_clear_pointer(&t8030_machine->ramdisk, g_free);
+    }
+    info->ramdisk_size = ROUND_UP_16K(size);
+}
+
+/*
+ * The shared images are created once, here, so that the RAM blocks that get
+ * migrated don't depend on the cache contents or on what a reset loaded.
+ */
+static void t8030_share_images(T8030MachineState *t8030_machine)
+{
+    g_autofree char *sep_fw = NULL;
+    gsize sep_fw_size;
+
+    macho_share_image("TrustCache", t8030_machine->trustcache,
+                      t8030_machine->boot_info.trustcache_size);
+    if (t8030_machine->ramdisk != NULL) {
+        macho_share_image("RAMDisk", t8030_machine->ramdisk,
+                          t8030_machine->ramdisk_size);
+    }
+    if (t8030_machine->sep_fw_filename != NULL &&
+        g_file_get_contents(t8030_machine->sep_fw_filename, &sep_fw,
+                            &sep_fw_size, NULL)) {
+        macho_share_image("SEPFW", sep_fw, sep_fw_size);
+    }
+    if (t8030_machine->kaslr_off) {
+        macho_share_segments(t8030_machine->kernel);
+    }
+}
+
 static void t8030_load_classic_kc(T8030MachineState *t8030_machine,
                                   const char *cmdline, CarveoutAllocator *ca)
 {
@@ -347,8 +399,8 @@ static void t8030_load_classic_kc(T8030MachineState *t8030_machine,
 
     info->trustcache_addr = vtop_slid(text_base) - info->trustcache_size;
 
-    address_space_rw(nsas, info->trustcache_addr, MEMTXATTRS_UNSPECIFIED,
-                     t8030_machine->trustcache, info->trustcache_size, true);
+    macho_load_image(nsas, sysmem, "TrustCache", info->trustcache_addr,
+                     t8030_machine->trustcache, info->trustcache_size);
 
     info->kern_entry = arm_load_macho(hdr, nsas, sysmem, memory_map,
                                       g_phys_base + g_phys_slide, g_virt_slide);
@@ -373,17 +425,15 @@ static void t8030_load_classic_kc(T8030MachineState *t8030_machine,
     // RAM Disk
     if (machine->initrd_filename != NULL) {
         info->ramdisk_addr = phys_ptr;
-        macho_load_ramdisk(machine->initrd_filename, nsas, sysmem,
-                           info->ramdisk_addr, &info->ramdisk_size);
-        info->ramdisk_size = ROUND_UP_16K(info->ramdisk_size);
+        t8030_load_ramdisk(t8030_machine, nsas, sysmem, info->ramdisk_addr);
         phys_ptr += info->ramdisk_size;
     }
 
     // SEPFW
     info->sep_fw_addr = phys_ptr;
     if (t8030_machine->sep_fw_filename != NULL) {
-        macho_load_raw_file(t8030_machine->sep_fw_filename, nsas, sysmem,
-                            info->sep_fw_addr, &info->sep_fw_size);
+        macho_load_raw_file(t8030_machine->sep_fw_filename, "SEPFW", nsas,
+                            sysmem, info->sep_fw_addr, &info->sep_fw_size);
         AppleSEPState *sep = APPLE_SEP(object_property_get_link(
             OBJECT(t8030_machine), "sep", &error_fatal));
         sep->sep_fw_addr = info->sep_fw_addr;
@@ -473,8 +523,8 @@ static void t8030_load_fileset_kc(T8030MachineState *t8030_machine,
     phys_ptr += info->device_tree_size;
 
     info->trustcache_addr = phys_ptr;
-    address_space_rw(nsas, info->trustcache_addr, MEMTXATTRS_UNSPECIFIED,
-                     t8030_machine->trustcache, info->trustcache_size, true);
+    macho_load_image(nsas, sysmem, "TrustCache", info->trustcache_addr,
+                     t8030_machine->trustcache, info->trustcache_size);
     phys_ptr += ROUND_UP_16K(info->trustcache_size);
 
     g_virt_base += g_virt_slide;
@@ -505,16 +555,14 @@ static void t8030_load_fileset_kc(T8030MachineState *t8030_machine,
 
     if (machine->initrd_filename != NULL) {
         info->ramdisk_addr = phys_ptr;
-        macho_load_ramdisk(machine->initrd_filename, nsas, sysmem,
-                           info->ramdisk_addr, &info->ramdisk_size);
-        info->ramdisk_size = ROUND_UP_16K(info->ramdisk_size);
+        t8030_load_ramdisk(t8030_machine, nsas, sysmem, info->ramdisk_addr);
         phys_ptr += info->ramdisk_size;
     }
 
     info->sep_fw_addr = phys_ptr;
     if (t8030_machine->sep_fw_filename != NULL) {
-        macho_load_raw_file(t8030_machine->sep_fw_filename, nsas, sysmem,
-                            info->sep_fw_addr, &info->sep_fw_size);
+        macho_load_raw_file(t8030_machine->sep_fw_filename, "SEPFW", nsas,
+                            sysmem, info->sep_fw_addr, &info->sep_fw_size);
         AppleSEPState *sep = APPLE_SEP(object_property_get_link(
             OBJECT(t8030_machine), "sep", &error_fatal));
         sep->sep_fw_addr = info->sep_fw_addr;
@@ -610,6 +658,8 @@ static void t8030_memory_setup(T8030MachineState *t8030_machine)
     memory_map = dtb_get_node(t8030_machine->device_tree, "/chosen/memory-map");
     nsas = &address_space_memory;
 
+    apple_boot_milestone("image-load-start");
+
     if (t8030_check_panic(t8030_machine)) {
         qemu_system_guest_panicked(NULL);
         return;
@@ -634,10 +684,8 @@ static void t8030_memory_setup(T8030MachineState *t8030_machine)
             return;
         }
         // Apparently needed because of a bug occurring on XNU
-        address_space_set(nsas, 0x300000000ULL, 0, 0x8000000ULL,
-                          MEMTXATTRS_UNSPECIFIED);
-        address_space_set(nsas, 0x340000000ULL, 0, 0x2000000ULL,
-                          MEMTXATTRS_UNSPECIFIED);
+        clear_ram(nsas, 0x300000000ULL, 0x8000000ULL);
+        clear_ram(nsas, 0x340000000ULL, 0x2000000ULL);
         address_space_rw(nsas, T8030_SEPROM_BASE, MEMTXATTRS_UNSPECIFIED,
                          (uint8_t *)seprom, fsize, true);
 
@@ -868,6 +916,8 @@ static void t8030_memory_setup(T8030MachineState *t8030_machine)
     }
 
     g_free(cmdline);
+
+    apple_boot_milestone("images-loaded");
 }
 
 static uint64_t pmgr_unk_e4800 = 0;
@@ -1182,12 +1232,23 @@ static const MemoryRegionOps amcc_reg_ops = {
     .read = amcc_reg_read,
 };
 
-static void t8030_cluster_setup(T8030MachineState *t8030_machine)
+static AppleA13Cluster *t8030_cluster_get(T8030MachineState *t8030_machine,
+                                          uint32_t cluster_id)
 {
-    for (int i = 0; i < A13_MAX_CLUSTER; i++) {
-        char *name = NULL;
+    char *name;
+
+    if (cluster_id >= A13_MAX_CLUSTER) {
+        error_setg(&error_fatal, "Cluster %u exceeds the maximum of %u",
+                   cluster_id, A13_MAX_CLUSTER);
+        return NULL;
+    }
 
-        name = g_strdup_printf("cluster%d", i);
+    // Clusters must not be realized without CPUs, so only create the ones
+    // that are actually used.
+    while (t8030_machine->num_clusters <= cluster_id) {
+        uint32_t i = t8030_machine->num_clusters++;
+
+        name = g_strdup_printf("cluster%u", i);
         object_initialize_child(OBJECT(t8030_machine), name,
                                 &t8030_machine->clusters[i],
                                 TYPE_APPLE_A13_CLUSTER);
@@ -1195,11 +1256,13 @@ static void t8030_cluster_setup(T8030MachineState *t8030_machine)
         qdev_prop_set_uint32(DEVICE(&t8030_machine->clusters[i]), "cluster-id",
                              i);
     }
+
+    return &t8030_machine->clusters[cluster_id];
 }
 
 static void t8030_cluster_realize(T8030MachineState *t8030_machine)
 {
-    for (int i = 0; i < A13_MAX_CLUSTER; i++) {
+    for (int i = 0; i < t8030_machine->num_clusters; i++) {
         qdev_realize(DEVICE(&t8030_machine->clusters[i]), NULL, &error_fatal);
         if (t8030_machine->clusters[i].base) {
             memory_region_add_subregion(t8030_machine->sys_mem,
@@ -1209,37 +1272,205 @@ static void t8030_cluster_realize(T8030MachineState *t8030_machine)
     }
 }
 
+/* The per-core and per-cluster MMIO windows XNU maps for every core. */
+static const char *const t8030_cpu_reg_props[] = {
+    "cpu-impl-reg",
+    "coresight-reg",
+    "cpm-impl-reg",
+};
+
+/*
+ * Where one of `t8030_cpu_reg_props` lives for core `core` of cluster
+ * `cluster`: `base + (cluster - base_cluster) * cluster_stride +
+ * core * core_stride`. A per-cluster window has a core stride of 0.
+ */
+typedef struct {
+    uint64_t base;
+    uint64_t size;
+    uint64_t core_stride;
+    uint64_t cluster_stride;
+    uint32_t base_cluster;
+} T8030CpuRegLayout;
+
+static bool t8030_cpu_reg(DTBNode *node, const char *name, uint64_t *reg)
+{
+    DTBProp *prop = dtb_find_prop(node, name);
+
+    if (prop == NULL || prop->length != sizeof(uint64_t) * 2) {
+        return false;
+    }
+    memcpy(reg, prop->data, prop->length);
+    return true;
+}
+
+static uint32_t t8030_cpu_core_id(DTBNode *node)
+{
+    DTBProp *prop = dtb_find_prop(node, "reg");
+
+    g_assert_nonnull(prop);
+    return *(uint32_t *)prop->data & 0xff;
+}
+
+/*
+ * Derive the layout from the last core the SoC has (`last`), core 0 of its
+ * cluster (`first`) and core 0 of the cluster before (`prev_first`). The
+ * layout is left empty if they don't all have the window.
+ */
+static void t8030_cpu_reg_layout(DTBNode *prev_first, DTBNode *first,
+                                 DTBNode *last, uint32_t cluster_id,
+                                 const char *name, T8030CpuRegLayout *layout)
+{
+    uint64_t prev_reg[2];
+    uint64_t first_reg[2];
+    uint64_t last_reg[2];
+    uint32_t last_core = t8030_cpu_core_id(last);
+
+    memset(layout, 0, sizeof(*layout));
+    if (prev_first == NULL || !t8030_cpu_reg(prev_first, name, prev_reg) ||
+        !t8030_cpu_reg(first, name, first_reg) ||
+        !t8030_cpu_reg(last, name, last_reg)) {
+        return;
+    }
+
+    layout->base = first_reg[0];
+    layout->size = last_reg[1];
+    layout->cluster_stride = first_reg[0] - prev_reg[0];
+    if (last_core != 0) {
+        layout->core_stride = (last_reg[0] - first_reg[0]) / last_core;
+    }
+    layout->base_cluster = cluster_id;
+}
+
+/*
+ * Add a `cpus` node for a core the SoC doesn't have, modelled after
+ * `template`. The per-core and per-cluster MMIO windows are placed after
+ * those of the SoC's own cores, as described by `layouts`.
+ */
+static DTBNode *t8030_add_cpu_node(DTBNode *root, DTBNode *template,
+                                   const T8030CpuRegLayout *layouts,
+                                   uint32_t cpu_id, uint32_t cluster_id,
+                                   uint32_t core_id)
+{
+    static const char *const skipped[] = {
+        "name", "AAPL,phandle", "cpu-impl-reg", "coresight-reg",
+        "cpm-impl-reg",
+    };
+    const T8030CpuRegLayout *layout;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    DTBProp *prop;
+    DTBNode *node;
+    char *name;
+    uint64_t reg[2];
+    int i;
+
+    name = g_strdup_printf("cpu%u", cpu_id);
+    node = dtb_create_node(root, name);
+    g_assert_nonnull(node);
+    g_free(name);
+
+    g_hash_table_iter_init(&iter, template->props);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        prop = value;
+        for (i = 0; i < ARRAY_SIZE(skipped); i++) {
+            if (g_str_equal(key, skipped[i])) {
+                break;
+            }
+        }
+        if (i == ARRAY_SIZE(skipped)) {
+            dtb_set_prop(node, key, prop->length, prop->data);
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(t8030_cpu_reg_props); i++) {
+        layout = &layouts[i];
+        if (layout->size == 0) {
+            continue;
+        }
+        reg[0] = layout->base +
+                 (uint64_t)(cluster_id - layout->base_cluster) *
+                     layout->cluster_stride +
+                 (uint64_t)core_id * layout->core_stride;
+        reg[1] = layout->size;
+        dtb_set_prop(node, t8030_cpu_reg_props[i], sizeof(reg), reg);
+    }
+
+    dtb_set_prop_u32(node, "cpu-id", cpu_id);
+    dtb_set_prop_u32(node, "reg", (cluster_id << 8) | core_id);
+    dtb_set_prop_u32(node, "cluster-id", cluster_id);
+    dtb_set_prop_str(node, "state", "waiting");
+
+    return node;
+}
+
 static void t8030_cpu_setup(T8030MachineState *t8030_machine)
 {
     unsigned int i;
+    unsigned int cpu_count;
+    uint32_t cluster_id;
+    uint32_t first_cluster;
+    uint32_t last_cluster = UINT32_MAX;
+    T8030CpuRegLayout layouts[ARRAY_SIZE(t8030_cpu_reg_props)];
     DTBNode *root;
+    DTBNode *node = NULL;
+    DTBNode *cluster_first = NULL;
+    DTBNode *prev_cluster_first = NULL;
     GList *iter;
     GList *next = NULL;
 
-    t8030_cluster_setup(t8030_machine);
-
+    cpu_count = t8030_real_cpu_count(t8030_machine);
     root = dtb_get_node(t8030_machine->device_tree, "cpus");
     g_assert_nonnull(root);
 
     for (iter = root->children, i = 0; iter; iter = next, i++) {
-        uint32_t cluster_id;
-        DTBNode *node;
-
         next = iter->next;
         node = (DTBNode *)iter->data;
-        if (i >= t8030_real_cpu_count(t8030_machine)) {
+        if (i >= cpu_count) {
             dtb_remove_node(root, node);
             continue;
         }
 
         t8030_machine->cpus[i] = apple_a13_cpu_create(node, NULL, 0, 0, 0, 0);
         cluster_id = t8030_machine->cpus[i]->cluster_id;
+        if (cluster_id != last_cluster) {
+            prev_cluster_first = cluster_first;
+            cluster_first = node;
+            last_cluster = cluster_id;
+        }
+
+        object_property_add_child(
+            OBJECT(t8030_cluster_get(t8030_machine, cluster_id)),
+            DEVICE(t8030_machine->cpus[i])->id,
+            OBJECT(t8030_machine->cpus[i]));
+        qdev_realize(DEVICE(t8030_machine->cpus[i]), NULL, &error_fatal);
+    }
+
+    // Any CPUs beyond the SoC's own go into additional clusters of
+    // `cluster-cores` cores each, modelled after the last core.
+    first_cluster = t8030_machine->num_clusters;
+    if (i < cpu_count) {
+        g_assert_nonnull(node);
+        for (unsigned int j = 0; j < ARRAY_SIZE(t8030_cpu_reg_props); j++) {
+            t8030_cpu_reg_layout(prev_cluster_first, cluster_first, node,
+                                 last_cluster, t8030_cpu_reg_props[j],
+                                 &layouts[j]);
+        }
+    }
+    for (unsigned int j = 0; i < cpu_count; i++, j++) {
+        cluster_id = first_cluster + j / t8030_machine->cluster_cores;
+        node = t8030_add_cpu_node(root, node, layouts, i, cluster_id,
+                                  j % t8030_machine->cluster_cores);
+
+        t8030_machine->cpus[i] = apple_a13_cpu_create(node, NULL, 0, 0, 0, 0);
 
-        object_property_add_child(OBJECT(&t8030_machine->clusters[cluster_id]),
-                                  DEVICE(t8030_machine->cpus[i])->id,
-                                  OBJECT(t8030_machine->cpus[i]));
+        object_property_add_child(
+            OBJECT(t8030_cluster_get(t8030_machine, cluster_id)),
+            DEVICE(t8030_machine->cpus[i])->id,
+            OBJECT(t8030_machine->cpus[i]));
         qdev_realize(DEVICE(t8030_machine->cpus[i]), NULL, &error_fatal);
     }
+
     t8030_cluster_realize(t8030_machine);
 }
 
@@ -2054,6 +2285,7 @@ static void t8030_create_pcie(T8030MachineState *t8030_machine)
 {
     int i;
     uint32_t *ints;
+    uint32_t msi_vector_offset;
     DTBProp *prop;
     // uint64_t *reg;
     SysBusDevice *pcie;
@@ -2118,11 +2350,25 @@ static void t8030_create_pcie(T8030MachineState *t8030_machine)
     g_assert_nonnull(prop);
     ints = (uint32_t *)prop->data;
 
-    for (i = 0; i < prop->length / sizeof(uint32_t); i++) {
+    // the trailing MSI entry is not a sysbus IRQ, its vectors go out as "msi"
+    for (i = 0; i < prop->length / sizeof(uint32_t) && sysbus_has_irq(pcie, i);
+         i++) {
         sysbus_connect_irq(
             pcie, i, qdev_get_gpio_in(DEVICE(t8030_machine->aic), ints[i]));
     }
 
+    // each MSI vector gets its own AIC input, starting at msi-vector-offset
+    prop = dtb_find_prop(child, "msi-vector-offset");
+    if (prop != NULL) {
+        msi_vector_offset = *(uint32_t *)prop->data;
+        for (i = 0; i < APPLE_PCIE(pcie)->host->msi.num_vectors; i++) {
+            qdev_connect_gpio_out_named(
+                DEVICE(pcie), "msi", i,
+                qdev_get_gpio_in(DEVICE(t8030_machine->aic),
+                                 msi_vector_offset + i));
+        }
+    }
+
     sysbus_realize_and_unref(pcie, &error_fatal);
 }
 
@@ -2535,6 +2781,7 @@ static void t8030_cpu_reset_work(CPUState *cpu, run_on_cpu_data data)
     cpu_reset(cpu);
     ARM_CPU(cpu)->env.xregs[0] = t8030_machine->boot_info.kern_boot_args_addr;
     cpu_set_pc(cpu, t8030_machine->boot_info.kern_entry);
+    apple_boot_milestone("kernel-entry");
 }
 
 static void t8030_cpu_reset(T8030MachineState *t8030_machine)
@@ -2579,6 +2826,7 @@ static void t8030_machine_reset(MachineState *machine, ResetType type)
 
     if (!runstate_check(RUN_STATE_RESTORE_VM) &&
         !runstate_check(RUN_STATE_PRELAUNCH)) {
+        apple_boot_timeline_restart();
         t8030_memory_setup(t8030_machine);
 
         pmgr_unk_e4800 = 0;
@@ -2607,6 +2855,7 @@ static void t8030_machine_init(MachineState *machine)
 {
     T8030MachineState *t8030_machine;
     MachoHeader64 *hdr;
+    AppleBootImages images = { 0 };
     uint64_t kernel_low, kernel_high;
     uint32_t build_version;
     DTBNode *child;
@@ -2615,6 +2864,8 @@ static void t8030_machine_init(MachineState *machine)
 
     t8030_machine = T8030_MACHINE(machine);
 
+    apple_boot_timeline_enable(t8030_machine->boot_timeline_filename);
+
     if ((t8030_machine->sep_fw_filename == NULL) !=
         (t8030_machine->sep_rom_filename == NULL)) {
         error_setg(&error_abort,
@@ -2623,6 +2874,11 @@ static void t8030_machine_init(MachineState *machine)
         return;
     }
 
+    if (t8030_machine->trustcache_filename == NULL) {
+        error_setg(&error_fatal, "A trustcache must be specified");
+        return;
+    }
+
     t8030_machine->sys_mem = get_system_memory();
     allocate_ram(t8030_machine->sys_mem, "SROM", T8030_SROM_BASE,
                  T8030_SROM_SIZE, 0);
@@ -2665,9 +2921,24 @@ static void t8030_machine_init(MachineState *machine)
                      SEP_DMA_MAPPING_SIZE, 0);
     }
 
-    hdr = macho_load_file(machine->kernel_filename, NULL);
+    macho_set_image_cache_dir(t8030_machine->image_cache_dir);
+
+    images.kernel_filename = machine->kernel_filename;
+    images.dtb_filename = machine->dtb;
+    images.trustcache_filename = t8030_machine->trustcache_filename;
+    images.extra_trustcache_filenames =
+        t8030_machine->extra_trustcache_filenames;
+    images.ramdisk_filename = machine->initrd_filename;
+    apple_boot_load_images(&images);
+
+    hdr = images.kernel;
     g_assert_nonnull(hdr);
     t8030_machine->kernel = hdr;
+    t8030_machine->device_tree = images.device_tree;
+    t8030_machine->trustcache = images.trustcache;
+    t8030_machine->boot_info.trustcache_size = images.trustcache_size;
+    t8030_machine->ramdisk = images.ramdisk;
+    t8030_machine->ramdisk_size = images.ramdisk_size;
     build_version = macho_build_version(hdr);
     info_report("Loading %s %u.%u.%u...", macho_platform_string(hdr),
                 BUILD_VERSION_MAJOR(build_version),
@@ -2716,16 +2987,15 @@ static void t8030_machine_init(MachineState *machine)
 
     t8030_patch_kernel(hdr, build_version);
 
-    t8030_machine->device_tree = load_dtb_from_file(machine->dtb);
+    if (t8030_machine->image_cache_dir != NULL) {
+        t8030_share_images(t8030_machine);
+    }
+
     if (t8030_machine->device_tree == NULL) {
         error_setg(&error_abort, "Failed to load device tree");
         return;
     }
 
-    t8030_machine->trustcache =
-        load_trustcache_from_file(t8030_machine->trustcache_filename,
-                                  &t8030_machine->boot_info.trustcache_size);
-
     dtb_set_prop_u32(t8030_machine->device_tree, "clock-frequency", 24000000);
     child = dtb_get_node(t8030_machine->device_tree, "arm-io");
     g_assert_nonnull(child);
@@ -2867,6 +3137,39 @@ PROP_STR_GETTER_SETTER(trustcache_filename);
 PROP_STR_GETTER_SETTER(ticket_filename);
 PROP_STR_GETTER_SETTER(sep_rom_filename);
 PROP_STR_GETTER_SETTER(sep_fw_filename);
+PROP_STR_GETTER_SETTER(image_cache_dir);
+PROP_STR_GETTER_SETTER(boot_timeline_filename);
+
+static void t8030_get_extra_trustcache(Object *obj, Visitor *v,
+                                       const char *name, void *opaque,
+                                       Error **errp)
+{
+    T8030MachineState *t8030_machine = T8030_MACHINE(obj);
+
+    visit_type_strList(v, name, &t8030_machine->extra_trustcache_filenames,
+                       errp);
+}
+
+static void t8030_set_extra_trustcache(Object *obj, Visitor *v,
+                                       const char *name, void *opaque,
+                                       Error **errp)
+{
+    T8030MachineState *t8030_machine = T8030_MACHINE(obj);
+    strList *list = NULL;
+
+    if (!visit_type_strList(v, name, &list, errp)) {
+        return;
+    }
+
+    qapi_free_strList(t8030_machine->extra_trustcache_filenames);
+    t8030_machine->extra_trustcache_filenames = list;
+}
+
+static void t8030_get_boot_timeline(Object *obj, Visitor *v, const char *name,
+                                    void *opaque, Error **errp)
+{
+    apple_boot_timeline_visit(v, name, errp);
+}
 
 static void t8030_set_boot_mode(Object *obj, const char *value, Error **errp)
 {
@@ -2972,6 +3275,33 @@ static void t8030_set_usb_conn_port(Object *obj, Visitor *v, const char *name,
     }
 }
 
+static void t8030_get_cluster_cores(Object *obj, Visitor *v, const char *name,
+                                    void *opaque, Error **errp)
+{
+    uint32_t value;
+
+    value = T8030_MACHINE(obj)->cluster_cores;
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void t8030_set_cluster_cores(Object *obj, Visitor *v, const char *name,
+                                    void *opaque, Error **errp)
+{
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    if (value == 0 || value > A13_MAX_CPU) {
+        error_setg(errp, "cluster-cores must be between 1 and %u",
+                   A13_MAX_CPU);
+        return;
+    }
+
+    T8030_MACHINE(obj)->cluster_cores = value;
+}
+
 PROP_STR_GETTER_SETTER(model_number);
 PROP_STR_GETTER_SETTER(region_info);
 PROP_STR_GETTER_SETTER(config_number);
@@ -3001,6 +3331,12 @@ static void t8030_machine_class_init(ObjectClass *klass, void *data)
                                   t8030_get_trustcache_filename,
                                   t8030_set_trustcache_filename);
     object_class_property_set_description(klass, "trustcache", "TrustCache");
+    object_class_property_add(klass, "extra-trustcache", "strList",
+                              t8030_get_extra_trustcache,
+                              t8030_set_extra_trustcache, NULL, NULL);
+    object_class_property_set_description(
+        klass, "extra-trustcache",
+        "Additional TrustCaches, as extra-trustcache.0=a,extra-trustcache.1=b");
     object_class_property_add_str(klass, "ticket", t8030_get_ticket_filename,
                                   t8030_set_ticket_filename);
     object_class_property_set_description(klass, "ticket", "AP Ticket");
@@ -3018,6 +3354,24 @@ static void t8030_machine_class_init(ObjectClass *klass, void *data)
                                       t8030_set_ecid, NULL, NULL);
     object_property_set_default_uint(oprop, 0x1122334455667788);
     object_class_property_set_description(klass, "ecid", "Device ECID");
+    object_class_property_add_str(klass, "image-cache",
+                                  t8030_get_image_cache_dir,
+                                  t8030_set_image_cache_dir);
+    object_class_property_set_description(
+        klass, "image-cache",
+        "Directory for boot images shared copy-on-write between instances");
+    object_class_property_add_str(klass, "boot-timeline-file",
+                                  t8030_get_boot_timeline_filename,
+                                  t8030_set_boot_timeline_filename);
+    object_class_property_set_description(
+        klass, "boot-timeline-file",
+        "Write the boot phase timeline to this file as JSON on exit, "
+        "including the milestones found in the kernel console output");
+    object_class_property_add(klass, "boot-timeline", "BootTimeline",
+                              t8030_get_boot_timeline, NULL, NULL, NULL);
+    object_class_property_set_description(
+        klass, "boot-timeline",
+        "Host time, virtual time and icount at each boot milestone");
     object_class_property_add_bool(klass, "kaslr-off", t8030_get_kaslr_off,
                                    t8030_set_kaslr_off);
     object_class_property_set_description(klass, "kaslr-off", "Disable KASLR");
@@ -3040,6 +3394,13 @@ static void t8030_machine_class_init(ObjectClass *klass, void *data)
                               NULL, NULL);
     object_class_property_set_description(klass, "usb-conn-port",
                                           "USB Connection Port");
+    oprop = object_class_property_add(klass, "cluster-cores", "uint32",
+                                      t8030_get_cluster_cores,
+                                      t8030_set_cluster_cores, NULL, NULL);
+    object_property_set_default_uint(oprop, 4);
+    object_class_property_set_description(
+        klass, "cluster-cores",
+        "Cores per additional cluster when -smp exceeds the SoC's CPUs");
     oprop = object_class_property_add_str(
         klass, "model", t8030_get_model_number, t8030_set_model_number);
     object_property_set_default_str(oprop, "CKQ12");
@@ -27,13 +27,8 @@ ApplePfRange *xnu_pf_segment(MachoHeader64 *header, const char *segment_name)
 ApplePfRange *xnu_pf_section(MachoHeader64 *header, const char *segment_name,
                              const char *section_name)
 {
-    MachoSection64 *sec;
-    MachoSegmentCommand64 *seg = macho_get_segment(header, segment_name);
-    if (seg == NULL) {
-        return NULL;
-    }
-
-    sec = macho_get_section(seg, section_name);
+    MachoSection64 *sec =
+        macho_find_section(header, segment_name, section_name);
     if (sec == NULL) {
         return NULL;
     }
@@ -24,6 +24,7 @@
 #include "hw/pci/msi.h"
 #include "hw/pci/pci_device.h"
 #include "hw/sysbus.h"
+#include "migration/vmstate.h"
 #include "qapi/error.h"
 #include "qemu/log.h"
 
@@ -261,12 +262,27 @@ static void apple_nvme_mmu_realize(DeviceState *dev, Error **errp)
     apple_nvme_mmu_start(s);
 }
 
+static const VMStateDescription vmstate_apple_nvme_mmu = {
+    .name = "AppleNVMeMMUState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT32_ARRAY(common_reg, AppleNVMeMMUState,
+                                 0x4000 / sizeof(uint32_t)),
+            VMSTATE_UINT32_ARRAY(config_reg, AppleNVMeMMUState,
+                                 0x4000 / sizeof(uint32_t)),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static void apple_nvme_mmu_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
 
     dc->realize = apple_nvme_mmu_realize;
     dc->desc = "Apple NVMe MMU";
+    dc->vmsd = &vmstate_apple_nvme_mmu;
     set_bit(DEVICE_CATEGORY_BRIDGE, dc->categories);
     dc->fw_name = "pci";
 }
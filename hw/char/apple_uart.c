@@ -31,38 +31,14 @@
 
 #include "hw/char/apple_uart.h"
 #include "hw/irq.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
 #include "hw/qdev-properties-system.h"
 #include "hw/qdev-properties.h"
 
 #include "qom/object.h"
+#include "apple_uart_internal.h"
 #include "trace.h"
 
-/*
- *  Offsets for UART registers relative to SFR base address
- *  for UARTn
- *
- */
-#define ULCON 0x0000 /* Line Control             */
-#define UCON 0x0004 /* Control                  */
-#define UFCON 0x0008 /* FIFO Control             */
-#define UMCON 0x000C /* Modem Control            */
-#define UTRSTAT 0x0010 /* Tx/Rx Status             */
-#define UERSTAT 0x0014 /* UART Error Status        */
-#define UFSTAT 0x0018 /* FIFO Status              */
-#define UMSTAT 0x001C /* Modem Status             */
-#define UTXH 0x0020 /* Transmit Buffer          */
-#define URXH 0x0024 /* Receive Buffer           */
-#define UBRDIV 0x0028 /* Baud Rate Divisor        */
-#define UFRACVAL 0x002C /* Divisor Fractional Value */
-
-/*
- * for indexing register in the uint32_t array
- *
- * 'reg' - register offset (see offsets definitions above)
- *
- */
-#define I_(reg) (reg / sizeof(uint32_t))
-
 typedef struct AppleUartReg {
     const char *name; /* the only reason is the debug output */
     hwaddr offset;
@@ -84,55 +60,6 @@ static const AppleUartReg apple_uart_regs[] = {
     { "UFRACVAL", UFRACVAL, 0x00000000 },
 };
 
-#define APPLE_UART_REGS_MEM_SIZE 0x3C
-
-/* UART Control */
-#define UCON_TXTHRESH_ENA (1 << 13)
-#define UCON_RXTHRESH_ENA (1 << 12)
-#define UCON_RXERR_ENA (1 << 11)
-#define UCON_RXTIMEOUT_ENA (1 << 9)
-#define UCON_TXMODE (3 << 2)
-#define UCON_TXMODE_DMA (3 << 2)
-#define UCON_TXMODE_IRQ (1 << 2)
-#define UCON_RXMODE (3 << 0)
-#define UCON_RXMODE_DMA (3 << 0)
-#define UCON_RXMODE_IRQ (1 << 0)
-
-/* UART FIFO Control */
-#define UFCON_FIFO_ENABLE (1 << 0)
-#define UFCON_Rx_FIFO_RESET (1 << 1)
-#define UFCON_Tx_FIFO_RESET (1 << 2)
-#define UFCON_Tx_FIFO_TRIGGER_LEVEL_SHIFT 6
-#define UFCON_Tx_FIFO_TRIGGER_LEVEL (3 << UFCON_Tx_FIFO_TRIGGER_LEVEL_SHIFT)
-#define UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT 4
-#define UFCON_Rx_FIFO_TRIGGER_LEVEL (3 << UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT)
-
-/* Uart FIFO Status */
-#define UFSTAT_Rx_FIFO_COUNT 0xf
-#define UFSTAT_Rx_FIFO_FULL (1 << 8)
-#define UFSTAT_Tx_FIFO_COUNT_SHIFT 4
-#define UFSTAT_Tx_FIFO_COUNT (0xf << UFSTAT_Tx_FIFO_COUNT_SHIFT)
-#define UFSTAT_Tx_FIFO_FULL (1 << 9)
-
-/* UART Line Control */
-#define ULCON_IR_MODE_SHIFT 6
-#define ULCON_PARITY_SHIFT 3
-#define ULCON_STOP_BIT_SHIFT 1
-
-/* UART Tx/Rx Status */
-#define UTRSTAT_Rx_TIMEOUT (1 << 3)
-#define UTRSTAT_Tx_THRESH (1 << 5)
-#define UTRSTAT_Rx_THRESH (1 << 4)
-#define UTRSTAT_Tx_EMPTY (1 << 2)
-#define UTRSTAT_Tx_BUFFER_EMPTY (1 << 1)
-#define UTRSTAT_Rx_BUFFER_DATA_READY (1 << 0)
-
-/* UART Error Status */
-#define UERSTAT_OVERRUN 0x1
-#define UERSTAT_PARITY 0x2
-#define UERSTAT_FRAME 0x4
-#define UERSTAT_BREAK 0x8
-
 typedef struct {
     uint8_t *data;
     uint32_t sp, rp; /* store and retrieve pointers */
@@ -180,30 +107,6 @@ static const char *apple_uart_regname(hwaddr offset)
 }
 
 
-static uint32_t apple_uart_FIFO_trigger_level(uint32_t channel, uint32_t reg)
-{
-    uint32_t level;
-
-    switch (channel) {
-    case 0:
-        level = reg * 32;
-        break;
-    case 1:
-    case 4:
-        level = reg * 8;
-        break;
-    case 2:
-    case 3:
-        level = reg * 2;
-        break;
-    default:
-        level = 0;
-        trace_apple_uart_channel_error(channel);
-        break;
-    }
-    return level;
-}
-
 static uint32_t apple_uart_Tx_FIFO_trigger_level(const AppleUartState *s)
 {
     uint32_t reg;
@@ -216,13 +119,8 @@ static uint32_t apple_uart_Tx_FIFO_trigger_level(const AppleUartState *s)
 
 static uint32_t apple_uart_Rx_FIFO_trigger_level(const AppleUartState *s)
 {
-    uint32_t reg;
-
-    reg = ((s->reg[I_(UFCON)] & UFCON_Rx_FIFO_TRIGGER_LEVEL) >>
-           UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT) +
-          1;
-
-    return apple_uart_FIFO_trigger_level(s->channel, reg);
+    return apple_uart_rx_trigger_level(s->channel, s->reg[I_(UFCON)],
+                                       s->rx_fifo_size);
 }
 
 static void apple_uart_update_irq(AppleUartState *s)
@@ -272,6 +170,23 @@ static void apple_uart_update_irq(AppleUartState *s)
     }
 }
 
+/* The IRQ line is only re-evaluated when the Rx status changes. */
+static void apple_uart_rx_update_status(AppleUartState *s)
+{
+    uint32_t count = fifo8_num_used(&s->rx);
+    uint32_t old = s->reg[I_(UTRSTAT)];
+
+    s->reg[I_(UTRSTAT)] =
+        apple_uart_rx_status(old, count, apple_uart_Rx_FIFO_trigger_level(s));
+    if (count == 0) {
+        timer_del(s->fifo_timeout_timer);
+    }
+
+    if (s->reg[I_(UTRSTAT)] != old) {
+        apple_uart_update_irq(s);
+    }
+}
+
 static void apple_uart_timeout_int(void *opaque)
 {
     AppleUartState *s = opaque;
@@ -364,15 +279,21 @@ static void apple_uart_write(void *opaque, hwaddr offset, uint64_t val,
             fifo8_reset(&s->rx);
             s->reg[I_(UFCON)] &= ~UFCON_Rx_FIFO_RESET;
             trace_apple_uart_rx_fifo_reset(s->channel);
+            apple_uart_rx_update_status(s);
         }
         if (val & UFCON_Tx_FIFO_RESET) {
             fifo8_reset(&s->tx);
             s->reg[I_(UFCON)] &= ~UFCON_Tx_FIFO_RESET;
             trace_apple_uart_tx_fifo_reset(s->channel);
         }
+        /* The FIFO may have been reset or switched on or off. */
+        qemu_chr_fe_accept_input(&s->chr);
         break;
 
     case UTXH:
+        if (s->channel == 0) {
+            apple_boot_timeline_console_putc((uint8_t)val);
+        }
         if (qemu_chr_fe_backend_connected(&s->chr)) {
             s->reg[I_(UTRSTAT)] &=
                 ~(UTRSTAT_Tx_EMPTY | UTRSTAT_Tx_BUFFER_EMPTY);
@@ -425,32 +346,33 @@ static uint64_t apple_uart_read(void *opaque, hwaddr offset, unsigned size)
                               res);
         return res;
     case UFSTAT: /* Read Only */
-        s->reg[I_(UFSTAT)] = fifo8_num_used(&s->rx) & 0xf;
-        if (fifo8_num_free(&s->rx) == 0) {
-            s->reg[I_(UFSTAT)] |= UFSTAT_Rx_FIFO_FULL;
-        }
+        s->reg[I_(UFSTAT)] = apple_uart_rx_fifo_status(&s->rx);
         trace_apple_uart_read(s->channel, offset, apple_uart_regname(offset),
                               s->reg[I_(UFSTAT)]);
         return s->reg[I_(UFSTAT)];
     case URXH:
         if (s->reg[I_(UFCON)] & UFCON_FIFO_ENABLE) {
-            if (fifo8_num_used(&s->rx)) {
-                res = fifo8_pop(&s->rx);
+            if (!fifo8_is_empty(&s->rx)) {
+                bool wake;
+
+                res = apple_uart_rx_pop(&s->rx, &wake);
                 trace_apple_uart_rx(s->channel, res);
-                if (fifo8_is_empty(&s->rx)) {
-                    s->reg[I_(UTRSTAT)] &= ~UTRSTAT_Rx_BUFFER_DATA_READY;
-                } else {
-                    s->reg[I_(UTRSTAT)] |= UTRSTAT_Rx_BUFFER_DATA_READY;
+                apple_uart_rx_update_status(s);
+                if (wake) {
+                    qemu_chr_fe_accept_input(&s->chr);
                 }
             } else {
                 trace_apple_uart_rx_error(s->channel);
                 res = 0;
             }
         } else {
-            s->reg[I_(UTRSTAT)] &= ~UTRSTAT_Rx_BUFFER_DATA_READY;
             res = s->reg[I_(URXH)];
+            if (s->reg[I_(UTRSTAT)] & UTRSTAT_Rx_BUFFER_DATA_READY) {
+                s->reg[I_(UTRSTAT)] &= ~UTRSTAT_Rx_BUFFER_DATA_READY;
+                apple_uart_update_irq(s);
+                qemu_chr_fe_accept_input(&s->chr);
+            }
         }
-        qemu_chr_fe_accept_input(&s->chr);
         trace_apple_uart_read(s->channel, offset, apple_uart_regname(offset),
                               res);
         return res;
@@ -479,29 +401,24 @@ static int apple_uart_can_receive(void *opaque)
 {
     AppleUartState *s = (AppleUartState *)opaque;
 
-    if (s->reg[I_(UFCON)] & UFCON_FIFO_ENABLE) {
-        return fifo8_num_free(&s->rx);
-    } else {
-        return !(s->reg[I_(UTRSTAT)] & UTRSTAT_Rx_BUFFER_DATA_READY);
-    }
+    return apple_uart_rx_room(s->reg, &s->rx);
 }
 
 static void apple_uart_receive(void *opaque, const uint8_t *buf, int size)
 {
     AppleUartState *s = (AppleUartState *)opaque;
+    int avail = apple_uart_can_receive(s);
 
-    if (s->reg[I_(UFCON)] & UFCON_FIFO_ENABLE) {
-        if (fifo8_num_free(&s->rx) < size) {
-            qemu_log_mask(LOG_GUEST_ERROR, "%s: tx overflow: %d < %d\n",
-                          __func__, fifo8_num_free(&s->rx), size);
-            size = fifo8_num_free(&s->rx);
-        }
-        fifo8_push_all(&s->rx, buf, size);
+    /* Only reachable if the FIFO was reconfigured since can_receive. */
+    if (size > avail) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: rx overflow: %d < %d\n",
+                      __func__, avail, size);
+    }
+
+    if (apple_uart_rx_accept(s->reg, &s->rx, buf, size) != 0 &&
+        (s->reg[I_(UFCON)] & UFCON_FIFO_ENABLE)) {
         apple_uart_rx_timeout_set(s);
-    } else {
-        s->reg[I_(URXH)] = buf[0];
     }
-    s->reg[I_(UTRSTAT)] |= UTRSTAT_Rx_BUFFER_DATA_READY;
 
     apple_uart_update_irq(s);
 }
@@ -512,10 +429,7 @@ static void apple_uart_event(void *opaque, QEMUChrEvent event)
     AppleUartState *s = (AppleUartState *)opaque;
 
     if (event == CHR_EVENT_BREAK) {
-        /* When the RxDn is held in logic 0, then a null byte is pushed into the
-         * fifo */
-        fifo8_push(&s->rx, '\0');
-        s->reg[I_(UERSTAT)] |= UERSTAT_BREAK;
+        apple_uart_rx_break(s->reg, &s->rx);
         apple_uart_update_irq(s);
     }
 }
@@ -560,7 +474,7 @@ static const VMStateDescription vmstate_apple_uart = {
         }
 };
 
-DeviceState *apple_uart_create(hwaddr addr, int fifo_size, int channel,
+DeviceState *apple_uart_create(hwaddr addr, int tx_fifo_size, int channel,
                                Chardev *chr, qemu_irq irq)
 {
     DeviceState *dev;
@@ -570,8 +484,8 @@ DeviceState *apple_uart_create(hwaddr addr, int fifo_size, int channel,
 
     qdev_prop_set_chr(dev, "chardev", chr);
     qdev_prop_set_uint32(dev, "channel", channel);
-    qdev_prop_set_uint32(dev, "rx-size", fifo_size);
-    qdev_prop_set_uint32(dev, "tx-size", fifo_size);
+    /* rx-size is left to its default or `-global apple.uart.rx-size=N`. */
+    qdev_prop_set_uint32(dev, "tx-size", tx_fifo_size);
 
     bus = SYS_BUS_DEVICE(dev);
     sysbus_realize_and_unref(bus, &error_fatal);
@@ -603,8 +517,9 @@ static void apple_uart_realize(DeviceState *dev, Error **errp)
 {
     AppleUartState *s = APPLE_UART(dev);
 
-    if (s->rx_fifo_size >= 16) {
-        error_setg(errp, "rx-size must be smaller than 16");
+    if (s->rx_fifo_size == 0 || s->rx_fifo_size > APPLE_UART_RX_FIFO_MAX) {
+        error_setg(errp, "rx-size must be between 1 and %d",
+                   APPLE_UART_RX_FIFO_MAX);
         return;
     }
 
@@ -613,6 +528,10 @@ static void apple_uart_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    if (apple_uart_FIFO_trigger_level(s->channel, 1) == 0) {
+        trace_apple_uart_channel_error(s->channel);
+    }
+
     fifo8_create(&s->rx, s->rx_fifo_size);
     fifo8_create(&s->tx, s->tx_fifo_size);
 
@@ -0,0 +1,223 @@
+/*
+ *  Apple Samsung S5L UART register layout and Rx FIFO bookkeeping
+ *
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HW_CHAR_APPLE_UART_INTERNAL_H
+#define HW_CHAR_APPLE_UART_INTERNAL_H
+
+#include "qemu/fifo8.h"
+
+/*
+ *  Offsets for UART registers relative to SFR base address
+ *  for UARTn
+ *
+ */
+#define ULCON 0x0000 /* Line Control             */
+#define UCON 0x0004 /* Control                  */
+#define UFCON 0x0008 /* FIFO Control             */
+#define UMCON 0x000C /* Modem Control            */
+#define UTRSTAT 0x0010 /* Tx/Rx Status             */
+#define UERSTAT 0x0014 /* UART Error Status        */
+#define UFSTAT 0x0018 /* FIFO Status              */
+#define UMSTAT 0x001C /* Modem Status             */
+#define UTXH 0x0020 /* Transmit Buffer          */
+#define URXH 0x0024 /* Receive Buffer           */
+#define UBRDIV 0x0028 /* Baud Rate Divisor        */
+#define UFRACVAL 0x002C /* Divisor Fractional Value */
+
+/*
+ * for indexing register in the uint32_t array
+ *
+ * 'reg' - register offset (see offsets definitions above)
+ *
+ */
+#define I_(reg) (reg / sizeof(uint32_t))
+
+#define APPLE_UART_REGS_MEM_SIZE 0x3C
+
+/*
+ * The hardware FIFO holds 16 bytes, but a deeper Rx FIFO lets the chardev
+ * hand over large bursts (pasted text, scripted consoles) in one go.
+ */
+#define APPLE_UART_RX_FIFO_MAX 4096
+
+/* UART Control */
+#define UCON_TXTHRESH_ENA (1 << 13)
+#define UCON_RXTHRESH_ENA (1 << 12)
+#define UCON_RXERR_ENA (1 << 11)
+#define UCON_RXTIMEOUT_ENA (1 << 9)
+#define UCON_TXMODE (3 << 2)
+#define UCON_TXMODE_DMA (3 << 2)
+#define UCON_TXMODE_IRQ (1 << 2)
+#define UCON_RXMODE (3 << 0)
+#define UCON_RXMODE_DMA (3 << 0)
+#define UCON_RXMODE_IRQ (1 << 0)
+
+/* UART FIFO Control */
+#define UFCON_FIFO_ENABLE (1 << 0)
+#define UFCON_Rx_FIFO_RESET (1 << 1)
+#define UFCON_Tx_FIFO_RESET (1 << 2)
+#define UFCON_Tx_FIFO_TRIGGER_LEVEL_SHIFT 6
+#define UFCON_Tx_FIFO_TRIGGER_LEVEL (3 << UFCON_Tx_FIFO_TRIGGER_LEVEL_SHIFT)
+#define UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT 4
+#define UFCON_Rx_FIFO_TRIGGER_LEVEL (3 << UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT)
+
+/* Uart FIFO Status */
+#define UFSTAT_Rx_FIFO_COUNT 0xf
+#define UFSTAT_Rx_FIFO_FULL (1 << 8)
+#define UFSTAT_Tx_FIFO_COUNT_SHIFT 4
+#define UFSTAT_Tx_FIFO_COUNT (0xf << UFSTAT_Tx_FIFO_COUNT_SHIFT)
+#define UFSTAT_Tx_FIFO_FULL (1 << 9)
+
+/* UART Line Control */
+#define ULCON_IR_MODE_SHIFT 6
+#define ULCON_PARITY_SHIFT 3
+#define ULCON_STOP_BIT_SHIFT 1
+
+/* UART Tx/Rx Status */
+#define UTRSTAT_Rx_TIMEOUT (1 << 3)
+#define UTRSTAT_Tx_THRESH (1 << 5)
+#define UTRSTAT_Rx_THRESH (1 << 4)
+#define UTRSTAT_Tx_EMPTY (1 << 2)
+#define UTRSTAT_Tx_BUFFER_EMPTY (1 << 1)
+#define UTRSTAT_Rx_BUFFER_DATA_READY (1 << 0)
+
+/* UART Error Status */
+#define UERSTAT_OVERRUN 0x1
+#define UERSTAT_PARITY 0x2
+#define UERSTAT_FRAME 0x4
+#define UERSTAT_BREAK 0x8
+
+/*
+ * Trigger level for a UFCON trigger field value, in bytes. Unknown channels
+ * have no trigger level.
+ */
+static inline uint32_t apple_uart_FIFO_trigger_level(uint32_t channel,
+                                                     uint32_t reg)
+{
+    switch (channel) {
+    case 0:
+        return reg * 32;
+    case 1:
+    case 4:
+        return reg * 8;
+    case 2:
+    case 3:
+        return reg * 2;
+    default:
+        return 0;
+    }
+}
+
+static inline uint32_t apple_uart_rx_trigger_level(uint32_t channel,
+                                                   uint32_t ufcon,
+                                                   uint32_t rx_fifo_size)
+{
+    uint32_t reg = ((ufcon & UFCON_Rx_FIFO_TRIGGER_LEVEL) >>
+                    UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT) +
+                   1;
+
+    /* A level past the FIFO depth would never be reached. */
+    return MIN(apple_uart_FIFO_trigger_level(channel, reg), rx_fifo_size);
+}
+
+/* The Rx half of UFSTAT. The count field saturates when the FIFO is deeper. */
+static inline uint32_t apple_uart_rx_fifo_status(Fifo8 *rx)
+{
+    uint32_t val = MIN(fifo8_num_used(rx), UFSTAT_Rx_FIFO_COUNT);
+
+    if (fifo8_is_full(rx)) {
+        val |= UFSTAT_Rx_FIFO_FULL;
+    }
+    return val;
+}
+
+/*
+ * How many bytes the chardev may hand over. Without the FIFO, URXH holds a
+ * single byte until the guest reads it.
+ */
+static inline int apple_uart_rx_room(const uint32_t *reg, Fifo8 *rx)
+{
+    if (reg[I_(UFCON)] & UFCON_FIFO_ENABLE) {
+        return fifo8_num_free(rx);
+    }
+    return !(reg[I_(UTRSTAT)] & UTRSTAT_Rx_BUFFER_DATA_READY);
+}
+
+/*
+ * Take up to apple_uart_rx_room() bytes of `buf`. Anything past that is
+ * flagged as an overrun in UERSTAT. Returns the number of bytes taken.
+ */
+static inline int apple_uart_rx_accept(uint32_t *reg, Fifo8 *rx,
+                                       const uint8_t *buf, int size)
+{
+    int room = apple_uart_rx_room(reg, rx);
+
+    if (size > room) {
+        reg[I_(UERSTAT)] |= UERSTAT_OVERRUN;
+        size = room;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    if (reg[I_(UFCON)] & UFCON_FIFO_ENABLE) {
+        fifo8_push_all(rx, buf, size);
+    } else {
+        reg[I_(URXH)] = buf[0];
+    }
+    reg[I_(UTRSTAT)] |= UTRSTAT_Rx_BUFFER_DATA_READY;
+    return size;
+}
+
+/* When RxDn is held low a null byte is received, if there is room for it. */
+static inline void apple_uart_rx_break(uint32_t *reg, Fifo8 *rx)
+{
+    if (!fifo8_is_full(rx)) {
+        fifo8_push(rx, '\0');
+    }
+    reg[I_(UERSTAT)] |= UERSTAT_BREAK;
+}
+
+/*
+ * Pop the next byte for a URXH read. `wake` is set when the FIFO was full,
+ * which is the only case where the chardev has stopped sending.
+ */
+static inline uint8_t apple_uart_rx_pop(Fifo8 *rx, bool *wake)
+{
+    *wake = fifo8_is_full(rx);
+    return fifo8_pop(rx);
+}
+
+/*
+ * UTRSTAT once `count` bytes are left. The Rx threshold and timeout
+ * conditions stay asserted until the guest has drained the FIFO below
+ * them, so one interrupt covers a whole burst.
+ */
+static inline uint32_t apple_uart_rx_status(uint32_t utrstat, uint32_t count,
+                                            uint32_t trigger)
+{
+    if (count == 0) {
+        utrstat &= ~(UTRSTAT_Rx_BUFFER_DATA_READY | UTRSTAT_Rx_TIMEOUT);
+    }
+    if (count < trigger) {
+        utrstat &= ~UTRSTAT_Rx_THRESH;
+    }
+    return utrstat;
+}
+
+#endif /* HW_CHAR_APPLE_UART_INTERNAL_H */
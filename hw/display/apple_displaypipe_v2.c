@@ -45,6 +45,7 @@ struct AppleDisplayPipeV2State {
 
     DisplayBackEndState dbe_state;
     QemuConsole *console;
+    bool shared_surface;
 };
 
 #define REG_SPDS_VERSION (0x1014)
@@ -219,17 +220,47 @@ static const MemoryRegionOps dummy_reg_ops = {
     .valid.unaligned = false,
 };
 
+// Only used when the host cannot scan out the guest format directly, that
+// is on big endian hosts, where this is a plain byte swap.
 static void adp_v2_draw_row(void *opaque, uint8_t *dest, const uint8_t *src,
                             int width, int dest_pitch)
 {
-    while (width--) {
-        uint32_t colour = ldl_le_p(src);
-        src += sizeof(colour);
-        memcpy(dest, &colour, sizeof(colour));
-        dest += sizeof(colour);
+    uint32_t *d = (uint32_t *)dest;
+    int i;
+
+    for (i = 0; i < width; i++) {
+        d[i] = ldl_le_p(src + i * sizeof(uint32_t));
     }
 }
 
+static void adp_v2_gfx_update_shared(AppleDisplayPipeV2State *s)
+{
+    DirtyBitmapSnapshot *snap;
+    hwaddr stride = s->width * sizeof(uint32_t);
+    uint32_t y;
+    int first = -1;
+
+    snap = memory_region_snapshot_and_clear_dirty(
+        &s->vram, 0, stride * s->height, DIRTY_MEMORY_VGA);
+
+    for (y = 0; y < s->height; y++) {
+        if (memory_region_snapshot_get_dirty(&s->vram, snap, stride * y,
+                                             stride)) {
+            if (first < 0) {
+                first = y;
+            }
+        } else if (first >= 0) {
+            dpy_gfx_update(s->console, 0, first, s->width, y - first);
+            first = -1;
+        }
+    }
+    if (first >= 0) {
+        dpy_gfx_update(s->console, 0, first, s->width, y - first);
+    }
+
+    g_free(snap);
+}
+
 static void adp_v2_gfx_update(void *opaque)
 {
     AppleDisplayPipeV2State *s = APPLE_DISPLAY_PIPE_V2(opaque);
@@ -239,6 +270,11 @@ static void adp_v2_gfx_update(void *opaque)
 
     int first = 0, last = 0;
 
+    if (s->shared_surface) {
+        adp_v2_gfx_update_shared(s);
+        return;
+    }
+
     if (!s->vram_section.mr) {
         framebuffer_update_memory_section(&s->vram_section, &s->vram, 0,
                                           s->height, stride);
@@ -264,7 +300,24 @@ static void adp_v2_realize(DeviceState *dev, Error **errp)
         DBE_VFTG_CTRL_VFTG_ENABLE | DBE_VFTG_CTRL_VFTG_STATUS |
         DBE_VFTG_CTRL_UPDATE_ENABLE_TIMING | DBE_VFTG_CTRL_UPDATE_REQ_TIMING;
     s->console = graphic_console_init(dev, 0, &adp_v2_ops, s);
-    qemu_console_resize(s->console, s->width, s->height);
+
+    // The guest scans out little endian XRGB8888, which is the native
+    // console format on little endian hosts. The surface can then alias
+    // VRAM and only the dirty rows need to be reported.
+    s->shared_surface = !HOST_BIG_ENDIAN &&
+                        memory_region_size(&s->vram) >=
+                            (uint64_t)s->width * s->height * sizeof(uint32_t);
+    if (s->shared_surface) {
+        memory_region_set_log(&s->vram, true, DIRTY_MEMORY_VGA);
+        dpy_gfx_replace_surface(
+            s->console,
+            qemu_create_displaysurface_from(
+                s->width, s->height, PIXMAN_x8r8g8b8,
+                s->width * sizeof(uint32_t),
+                memory_region_get_ram_ptr(&s->vram)));
+    } else {
+        qemu_console_resize(s->console, s->width, s->height);
+    }
 }
 
 static const Property adp_v2_props[] = {
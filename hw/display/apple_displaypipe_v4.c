@@ -22,12 +22,14 @@
 #include "exec/memory.h"
 #include "hw/display/apple_displaypipe_v4.h"
 #include "hw/irq.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
 #include "hw/qdev-properties.h"
 #include "migration/vmstate.h"
 #include "qemu/log.h"
 #include "ui/console.h"
 #include "framebuffer.h"
 #include "system/dma.h"
+#include "system/replay.h"
 
 // #define DEBUG_DISP
 
@@ -415,7 +417,7 @@ static void adp_v4_update_disp_image(AppleDisplayPipeV4State *s)
         return;
     }
 
-    qemu_bh_schedule(s->update_disp_image_bh);
+    replay_bh_schedule_event(s->update_disp_image_bh);
 }
 
 static void adp_v4_reg_write(void *opaque, hwaddr addr, uint64_t data,
@@ -810,6 +812,7 @@ static void adp_v4_update_disp_image_bh(void *opaque)
     }
 
     s->blend_unit.dirty = false;
+    apple_boot_milestone("first-display-flip");
 }
 
 static uint32_t adp_timing_info[] = { 0x33C, 0x90, 0x1, 0x1,
@@ -1,6 +1,7 @@
 #include "qemu/osdep.h"
 #include "hw/arm/apple-silicon/dtb.h"
 #include "hw/intc/apple_aic.h"
+#include "hw/intc/apple_aic_internal.h"
 #include "hw/irq.h"
 #include "hw/pci/msi.h"
 #include "migration/vmstate.h"
@@ -11,95 +12,6 @@
 #include "qemu/timer.h"
 #include "trace.h"
 
-/*
- * AIC splits IRQs into domains (ipid)
- * In T8030 device tree, we have aic->ipid_length = 72
- * => IRQ(extInts) max nr = ((len(ipid_mask)>>2)<<5) = 0x240 (interrupts)
- * -> num domains = (0x240 + 31)>>5 = 18 (domains)
- * 0x240/18 = 32 (bits) of an uint32_t
- *
- * Commands such as REG_AIC_EIR_MASK_SET/CLR assign each domain to a 32bit
- * register. When masking/unmasking-ing IRQ n, write to (aic_base +
- * command_reg_base + (n / 32) * 4) a uint32_t which has (n % 32)-th bit set,
- * command_reg_base is 0x4100 for REG_AIC_EIR_MASK_SET, 0x4180 for
- * REG_AIC_EIR_MASK_CLR.
- *
- * T8030 uses both fast IPI, and AIC IPIs.
- * AIC IPIs' vectors are right after IRQs' vectors.
- * num IRQ + (X * 2) -> self_ipi (cpuX->cpuX)
- * num IRQ + (Y * 2) + 1 -> other_ipi (cpuX->cpuY)
- */
-
-// TODO: this is hardcoded for T8030
-#define AIC_INT_COUNT (576)
-#define AIC_CPU_COUNT (6)
-#define AIC_VERSION (2)
-
-#define REG_AIC_REV (0x0000)
-#define REG_AIC_CAP0 (0x0004)
-#define REG_AIC_CAP1 (0x0008)
-#define REG_AIC_RST (0x000C)
-
-#define REG_AIC_GLB_CFG (0x0010)
-#define AIC_GLBCFG_IEN (1 << 0)
-#define AIC_GLBCFG_AEWT(_t) ((_t) << 4)
-#define AIC_GLBCFG_SEWT(_t) ((_t) << 8)
-#define AIC_GLBCFG_AIWT(_t) ((_t) << 12)
-#define AIC_GLBCFG_SIWT(_t) ((_t) << 16)
-#define AIC_GLBCFG_SYNC_ACG (1 << 29)
-#define AIC_GLBCFG_EIR_ACG (1 << 30)
-#define AIC_GLBCFG_REG_ACG (1 << 31)
-#define AIC_GLBCFG_WT_MASK (15)
-#define AIC_GLBCFG_WT_64MICRO (7)
-
-#define REG_AIC_WHOAMI (0x2000)
-#define REG_AIC_IACK (0x2004)
-#define REG_AIC_IPI_SET (0x2008)
-#define REG_AIC_IPI_CLR (0x200C)
-#define AIC_IPI_NORMAL (1 << 0)
-#define AIC_IPI_SELF (1 << 31)
-#define REG_AIC_IPI_MASK_SET (0x2024)
-#define REG_AIC_IPI_MASK_CLR (0x2028)
-#define REG_AIC_IPI_DEFER_SET (0x202C)
-#define REG_AIC_IPI_DEFER_CLR (0x2030)
-
-#define REG_AIC_EIR_DEST(_n) (0x3000 + ((_n) * 4))
-#define REG_AIC_EIR_SW_SET(_n) (0x4000 + ((_n) * 4))
-#define REG_AIC_EIR_SW_CLR(_n) (0x4080 + ((_n) * 4))
-#define REG_AIC_EIR_MASK_SET(_n) (0x4100 + ((_n) * 4))
-#define REG_AIC_EIR_MASK_CLR(_n) (0x4180 + ((_n) * 4))
-#define REG_AIC_EIR_INT_RO(_n) (0x4200 + ((_n) * 4))
-
-#define REG_AIC_WHOAMI_Pn(_n) (0x5000 + ((_n) * 0x80))
-#define REG_AIC_IACK_Pn(_n) (0x5004 + ((_n) * 0x80))
-#define REG_AIC_IPI_SET_Pn(_n) (0x5008 + ((_n) * 0x80))
-#define REG_AIC_IPI_CLR_Pn(_n) (0x500C + ((_n) * 0x80))
-#define REG_AIC_IPI_MASK_SET_Pn(_n) (0x5024 + ((_n) * 0x80))
-#define REG_AIC_IPI_MASK_CLR_Pn(_n) (0x5028 + ((_n) * 0x80))
-#define REG_AIC_IPI_DEFER_SET_Pn(_n) (0x502C + ((_n) * 0x80))
-#define REG_AIC_IPI_DEFER_CLR_Pn(_n) (0x5030 + ((_n) * 0x80))
-
-#define kAIC_INT_SPURIOUS (0x00000)
-#define kAIC_INT_EXT (0x10000)
-#define kAIC_INT_IPI (0x40000)
-#define kAIC_INT_IPI_NORM (0x40001)
-#define kAIC_INT_IPI_SELF (0x40002)
-
-#define AIC_INT_EXT(_v) (((_v) & 0x70000) == kAIC_INT_EXT)
-#define AIC_INT_IPI(_v) (((_v) & 0x70000) == kAIC_INT_IPI)
-
-#define AIC_INT_EXTID(_v) ((_v) & 0x3FF)
-
-#define AIC_SRC_TO_EIR(_s) ((_s) >> 5)
-#define AIC_SRC_TO_MASK(_s) (1 << ((_s) & 0x1F))
-#define AIC_EIR_TO_SRC(_s, _v) (((_s) << 5) + ((_v) & 0x1F))
-
-#define kAIC_MAX_EXTID (AIC_INT_COUNT)
-#define kAIC_VEC_IPI (kAIC_MAX_EXTID)
-#define kAIC_NUM_INTS (kAIC_VEC_IPI + 1)
-
-#define kAIC_NUM_EIRS AIC_SRC_TO_EIR(kAIC_MAX_EXTID)
-
 #define kAICWT 64000
 
 #define kCNTFRQ (24000000)
@@ -111,59 +23,104 @@ static inline uint64_t apple_aic_emulate_timer(void)
     return qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) / period_ns;
 }
 
+/* Whether the cpu has an unmasked IPI pending, call with mutex locked. */
+static inline bool apple_aic_ipi_pending(AppleAICState *s, AppleAICCPU *o)
+{
+    if (o->pendingIPI & AIC_IPI_SELF & ~o->ipi_mask) {
+        return true;
+    }
+
+    return (~o->ipi_mask & AIC_IPI_NORMAL) &&
+           (o->pendingIPI & MAKE_64BIT_MASK(0, s->numCPU));
+}
+
 /*
- * Check state and interrupt cpus, call with mutex locked
+ * Work out which cpus have to be interrupted, call with mutex locked.
+ * Sets `deferred` if any cpu has a deferred IPI.
  */
-static void apple_aic_update(AppleAICState *s)
+static uint32_t apple_aic_route(AppleAICState *s, bool *deferred)
 {
     uint32_t intr = 0;
     uint32_t potential = 0;
+    uint32_t pending;
+    uint32_t eir;
     int i;
 
+    *deferred = false;
     for (i = 0; i < s->numCPU; i++) {
-        s->cpus[i].pendingIPI |= s->cpus[i].deferredIPI;
-        s->cpus[i].deferredIPI = 0;
-    }
+        *deferred |= s->cpus[i].deferredIPI != 0;
 
-    for (i = 0; i < s->numCPU; i++) {
-        if ((s->cpus[i].pendingIPI & AIC_IPI_SELF) & (~s->cpus[i].ipi_mask)) {
-            intr |= (1 << i);
-        }
-        if ((~s->cpus[i].ipi_mask & AIC_IPI_NORMAL) &&
-            (s->cpus[i].pendingIPI & ((1 << s->numCPU) - 1))) {
-            intr |= (1 << i);
+        if (apple_aic_ipi_pending(s, &s->cpus[i])) {
+            intr |= BIT(i);
         }
     }
 
-    i = -1;
-    while ((i = find_next_bit32(s->eir_state, s->numIRQ, i + 1)) < s->numIRQ) {
-        int dest;
-        if ((test_bit32(i, s->eir_mask) == 0) && (dest = s->eir_dest[i])) {
+    for (eir = 0; eir < s->numEIR; eir++) {
+        pending = s->eir_state[eir] & ~s->eir_mask[eir];
+
+        while (pending != 0) {
+            uint32_t dest;
+
+            i = AIC_EIR_TO_SRC(eir, ctz32(pending));
+            pending &= pending - 1;
+
+            dest = s->eir_dest[i];
+            if (dest == 0) {
+                continue;
+            }
             if (((intr & dest) == 0)) {
                 /* The interrupt doesn't have a cpu that can process it yet */
                 uint32_t cpu = find_first_bit32(&s->eir_dest[i], s->numCPU);
-                intr |= (1 << cpu);
+                intr |= BIT(cpu);
                 potential |= dest;
             } else {
                 int k;
                 for (k = 0; k < s->numCPU; k++) {
-                    if (((intr & (1 << k)) == 0) && (potential & (1 << k))) {
+                    if (((intr & BIT(k)) == 0) && (potential & BIT(k))) {
                         /*
                          * cpu K isn't in the interrupt list
                          * and can handle some of the previous interrupts
                          */
-                        intr |= (1 << k);
+                        intr |= BIT(k);
                         break;
                     }
                 }
             }
         }
     }
+
+    return intr;
+}
+
+/*
+ * Check state and interrupt cpus, call with mutex locked.
+ * Returns true while any cpu has an undelivered interrupt or deferred IPI.
+ */
+static bool apple_aic_update(AppleAICState *s)
+{
+    bool deferred;
+    uint32_t intr = apple_aic_route(s, &deferred);
+    int i;
+
     for (i = 0; i < s->numCPU; i++) {
-        if (intr & (1 << i)) {
+        if (intr & BIT(i)) {
             qemu_irq_raise(s->cpus[i].irq);
         }
     }
+
+    return intr != 0 || deferred;
+}
+
+/*
+ * Deliver newly pending state right away and only keep the tick armed
+ * while something is outstanding, so an idle guest does not wake the host
+ * every kAICWT. Call with mutex locked.
+ */
+static void apple_aic_kick(AppleAICState *s)
+{
+    if (apple_aic_update(s) && !timer_pending(s->timer)) {
+        timer_mod_ns(s->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + kAICWT);
+    }
 }
 
 static void apple_aic_set_irq(void *opaque, int irq, int level)
@@ -175,6 +132,7 @@ static void apple_aic_set_irq(void *opaque, int irq, int level)
     trace_aic_set_irq(irq, level);
     if (level) {
         set_bit32(irq, s->eir_state);
+        apple_aic_kick(s);
     } else {
         clear_bit32(irq, s->eir_state);
     }
@@ -183,12 +141,18 @@ static void apple_aic_set_irq(void *opaque, int irq, int level)
 static void apple_aic_tick(void *opaque)
 {
     AppleAICState *s = APPLE_AIC(opaque);
+    int i;
 
     QEMU_LOCK_GUARD(&s->mutex);
 
-    apple_aic_update(s);
+    for (i = 0; i < s->numCPU; i++) {
+        s->cpus[i].pendingIPI |= s->cpus[i].deferredIPI;
+        s->cpus[i].deferredIPI = 0;
+    }
 
-    timer_mod_ns(s->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + kAICWT);
+    if (apple_aic_update(s)) {
+        timer_mod_ns(s->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + kAICWT);
+    }
 }
 
 static void apple_aic_reset(DeviceState *dev)
@@ -210,25 +174,41 @@ static void apple_aic_reset(DeviceState *dev)
     }
 }
 
-static void apple_aic_write(void *opaque, hwaddr addr, uint64_t data,
-                            unsigned size)
+/* Resolve a REG_AIC_*_Pn access to the target cpu, or NULL. */
+static inline AppleAICCPU *apple_aic_decode_cpu(AppleAICState *s, hwaddr addr)
 {
-    AppleAICCPU *o = (AppleAICCPU *)opaque;
-    AppleAICState *s = APPLE_AIC(o->aic);
-    uint32_t val = (uint32_t)data;
+    uint32_t cpu = AIC_REGION(addr - REG_AIC_WHOAMI_Pn(0));
 
-    QEMU_LOCK_GUARD(&s->mutex);
+    if (unlikely(cpu >= s->numCPU)) {
+        return NULL;
+    }
 
-    switch (addr) {
-    case REG_AIC_RST:
-        apple_aic_reset(DEVICE(s));
-        break;
-    case REG_AIC_GLB_CFG:
-        s->global_cfg = data;
-        break;
-    case REG_AIC_IPI_SET: {
-        int i;
+    return &s->cpus[cpu];
+}
+
+/*
+ * Select the EIR word of a banked register, or -1 if it is past the end.
+ * `offset` is relative to the start of the bank.
+ */
+static inline int apple_aic_decode_eir(AppleAICState *s, hwaddr offset)
+{
+    uint32_t eir = offset / 4;
 
+    if (unlikely(eir >= s->numEIR)) {
+        return -1;
+    }
+
+    return eir;
+}
+
+/* Call with mutex locked. */
+static bool apple_aic_write_local(AppleAICState *s, AppleAICCPU *o,
+                                  hwaddr addr, uint32_t val)
+{
+    int i;
+
+    switch (addr) {
+    case REG_AIC_IPI_SET:
         for (i = 0; i < s->numCPU; i++) {
             if (val & (1 << i)) {
                 set_bit32(o->cpu_id, &s->cpus[i].pendingIPI);
@@ -244,11 +224,9 @@ static void apple_aic_write(void *opaque, hwaddr addr, uint64_t data,
                 qemu_irq_raise(o->irq);
             }
         }
-        break;
-    }
-    case REG_AIC_IPI_CLR: {
-        int i;
-
+        apple_aic_kick(s);
+        return true;
+    case REG_AIC_IPI_CLR:
         for (i = 0; i < s->numCPU; i++) {
             if (val & (1 << i)) {
                 clear_bit32(o->cpu_id, &s->cpus[i].pendingIPI);
@@ -258,17 +236,15 @@ static void apple_aic_write(void *opaque, hwaddr addr, uint64_t data,
         if (val & AIC_IPI_SELF) {
             o->pendingIPI &= ~AIC_IPI_SELF;
         }
-        break;
-    }
+        return true;
     case REG_AIC_IPI_MASK_SET:
         o->ipi_mask |= (val & (AIC_IPI_NORMAL | AIC_IPI_SELF));
-        break;
+        return true;
     case REG_AIC_IPI_MASK_CLR:
         o->ipi_mask &= ~(val & (AIC_IPI_NORMAL | AIC_IPI_SELF));
-        break;
-    case REG_AIC_IPI_DEFER_SET: {
-        int i;
-
+        apple_aic_kick(s);
+        return true;
+    case REG_AIC_IPI_DEFER_SET:
         for (i = 0; i < s->numCPU; i++) {
             if (val & (1 << i)) {
                 set_bit32(o->cpu_id, &s->cpus[i].deferredIPI);
@@ -278,11 +254,9 @@ static void apple_aic_write(void *opaque, hwaddr addr, uint64_t data,
         if (val & AIC_IPI_SELF) {
             o->deferredIPI |= AIC_IPI_SELF;
         }
-        break;
-    }
-    case REG_AIC_IPI_DEFER_CLR: {
-        int i;
-
+        apple_aic_kick(s);
+        return true;
+    case REG_AIC_IPI_DEFER_CLR:
         for (i = 0; i < s->numCPU; i++) {
             if (val & (1 << i)) {
                 clear_bit32(o->cpu_id, &s->cpus[i].deferredIPI);
@@ -292,176 +266,227 @@ static void apple_aic_write(void *opaque, hwaddr addr, uint64_t data,
         if (val & AIC_IPI_SELF) {
             o->deferredIPI &= ~AIC_IPI_SELF;
         }
-        break;
+        return true;
+    default:
+        return false;
     }
-    case REG_AIC_EIR_DEST(0)... REG_AIC_EIR_DEST(AIC_INT_COUNT): {
+}
+
+static void apple_aic_write(void *opaque, hwaddr addr, uint64_t data,
+                            unsigned size)
+{
+    AppleAICCPU *o = (AppleAICCPU *)opaque;
+    AppleAICState *s = o->aic;
+    AppleAICCPU *cpu;
+    uint32_t val = (uint32_t)data;
+    uint32_t unmasked;
+    int eir;
+
+    QEMU_LOCK_GUARD(&s->mutex);
+
+    switch (apple_aic_decode(addr)) {
+    case AIC_REGION_CPU:
+        cpu = apple_aic_decode_cpu(s, addr);
+        if (cpu != NULL &&
+            apple_aic_write_local(
+                s, cpu, REG_AIC_WHOAMI + (addr & (AIC_REGION_SIZE - 1)),
+                val)) {
+            return;
+        }
+        break;
+    case AIC_REGION_LOCAL:
+        if (apple_aic_write_local(s, o, addr, val)) {
+            return;
+        }
+        break;
+    case AIC_REGION_EIR_DEST: {
         uint32_t vector = (addr - REG_AIC_EIR_DEST(0)) / 4;
+
         if (unlikely(vector >= s->numIRQ)) {
-            break;
+            return;
         }
         s->eir_dest[vector] = val;
-        break;
+        apple_aic_kick(s);
+        return;
     }
-    case REG_AIC_EIR_SW_SET(0)... REG_AIC_EIR_SW_SET(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_SW_SET(0)) / 4;
-        if (unlikely(eir >= s->numEIR)) {
-            break;
+    case AIC_REGION_EIR_SW_SET:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_SW_SET(0));
+        if (eir >= 0) {
+            s->eir_state[eir] |= val;
+            apple_aic_kick(s);
         }
-        s->eir_state[eir] |= val;
-        break;
-    }
-    case REG_AIC_EIR_SW_CLR(0)... REG_AIC_EIR_SW_CLR(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_SW_CLR(0)) / 4;
-        if (unlikely(eir >= s->numEIR)) {
-            break;
+        return;
+    case AIC_REGION_EIR_SW_CLR:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_SW_CLR(0));
+        if (eir >= 0) {
+            s->eir_state[eir] &= ~val;
         }
-        s->eir_state[eir] &= ~val;
-        break;
-    }
-    case REG_AIC_EIR_MASK_SET(0)... REG_AIC_EIR_MASK_SET(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_MASK_SET(0)) / 4;
-        if (unlikely(eir >= s->numEIR)) {
-            break;
+        return;
+    case AIC_REGION_EIR_MASK_SET:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_MASK_SET(0));
+        if (eir >= 0) {
+            s->eir_mask[eir] |= val;
         }
-        s->eir_mask[eir] |= val;
-        break;
-    }
-    case REG_AIC_EIR_MASK_CLR(0)... REG_AIC_EIR_MASK_CLR(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_MASK_CLR(0)) / 4;
-
-        if (unlikely(eir >= s->numEIR)) {
-            break;
+        return;
+    case AIC_REGION_EIR_MASK_CLR:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_MASK_CLR(0));
+        if (eir < 0) {
+            return;
         }
 
+        /* Unmasking already unmasked sources is a no-op. */
+        unmasked = s->eir_mask[eir] & val;
         s->eir_mask[eir] &= ~val;
-        break;
-    }
-    case REG_AIC_WHOAMI_Pn(0)... REG_AIC_WHOAMI_Pn(AIC_CPU_COUNT) - 4: {
-        uint32_t cpu = ((addr - 0x5000) / 0x80);
-        if (unlikely(cpu >= s->numCPU)) {
+        if (unmasked != 0) {
+            apple_aic_kick(s);
+        }
+        return;
+    case AIC_REGION_GLOBAL:
+        switch (addr) {
+        case REG_AIC_RST:
+            apple_aic_reset(DEVICE(s));
+            return;
+        case REG_AIC_GLB_CFG:
+            s->global_cfg = data;
+            return;
+        default:
             break;
         }
-        addr = addr - 0x5000 + 0x2000 - 0x80 * cpu;
-        qemu_mutex_unlock(&s->mutex);
-        apple_aic_write(&s->cpus[cpu], addr, data, size);
-        qemu_mutex_lock(&s->mutex);
         break;
-    }
     default:
-        qemu_log_mask(LOG_UNIMP,
-                      "AIC: Write to unsupported reg 0x" HWADDR_FMT_plx
-                      " cpu %u: 0x%x\n",
-                      addr, o->cpu_id, val);
         break;
     }
+
+    qemu_log_mask(LOG_UNIMP,
+                  "AIC: Write to unsupported reg 0x" HWADDR_FMT_plx
+                  " cpu %u: 0x%x\n",
+                  addr, o->cpu_id, val);
 }
 
-static uint64_t apple_aic_read(void *opaque, hwaddr addr, unsigned size)
+/* Claim the next interrupt for the cpu, call with mutex locked. */
+static uint32_t apple_aic_iack(AppleAICState *s, AppleAICCPU *o)
 {
-    AppleAICCPU *o = (AppleAICCPU *)opaque;
-    AppleAICState *s = APPLE_AIC(o->aic);
+    uint32_t pending;
+    uint32_t eir;
+    int i;
 
-    QEMU_LOCK_GUARD(&s->mutex);
+    qemu_irq_lower(o->irq);
+    if (o->pendingIPI & AIC_IPI_SELF & ~o->ipi_mask) {
+        o->ipi_mask |= AIC_IPI_SELF;
+        return kAIC_INT_IPI | kAIC_INT_IPI_SELF;
+    }
 
-    switch (addr) {
-    case REG_AIC_REV:
-        return 2;
-    case REG_AIC_CAP0:
-        return (((uint64_t)s->numCPU - 1) << 16) | (s->numIRQ);
-    case REG_AIC_GLB_CFG:
-        return s->global_cfg;
-    case REG_AIC_WHOAMI:
-        return o->cpu_id;
-    case REG_AIC_IACK: {
-        int i;
-
-        qemu_irq_lower(o->irq);
-        if (o->pendingIPI & AIC_IPI_SELF & ~o->ipi_mask) {
-            o->ipi_mask |= AIC_IPI_SELF;
-            return kAIC_INT_IPI | kAIC_INT_IPI_SELF;
+    if (~o->ipi_mask & AIC_IPI_NORMAL) {
+        if (o->pendingIPI & MAKE_64BIT_MASK(0, s->numCPU)) {
+            o->ipi_mask |= AIC_IPI_NORMAL;
+            return kAIC_INT_IPI | kAIC_INT_IPI_NORM;
         }
+    }
 
-        if (~o->ipi_mask & AIC_IPI_NORMAL) {
-            if (o->pendingIPI & ((1 << s->numCPU) - 1)) {
-                o->ipi_mask |= AIC_IPI_NORMAL;
-                return kAIC_INT_IPI | kAIC_INT_IPI_NORM;
-            }
-        }
+    for (eir = 0; eir < s->numEIR; eir++) {
+        pending = s->eir_state[eir] & ~s->eir_mask[eir];
 
-        i = -1;
-        while ((i = find_next_bit32(s->eir_state, s->numIRQ, i + 1)) <
-               s->numIRQ) {
-            if (test_bit32(i, s->eir_mask) == 0) {
-                if (s->eir_dest[i] & (1 << o->cpu_id)) {
-                    set_bit32(i, s->eir_mask);
-                    return kAIC_INT_EXT | AIC_INT_EXTID(i);
-                }
+        while (pending != 0) {
+            i = AIC_EIR_TO_SRC(eir, ctz32(pending));
+            pending &= pending - 1;
+
+            if (s->eir_dest[i] & (1 << o->cpu_id)) {
+                set_bit32(i, s->eir_mask);
+                return kAIC_INT_EXT | AIC_INT_EXTID(i);
             }
         }
-        return kAIC_INT_SPURIOUS;
     }
-    case REG_AIC_EIR_DEST(0)... REG_AIC_EIR_DEST(AIC_INT_COUNT): {
-        uint32_t vector = (addr - REG_AIC_EIR_DEST(0)) / 4;
 
-        if (unlikely(vector >= s->numIRQ)) {
-            break;
-        }
+    return kAIC_INT_SPURIOUS;
+}
 
-        return s->eir_dest[vector];
+/* Call with mutex locked. */
+static bool apple_aic_read_local(AppleAICState *s, AppleAICCPU *o,
+                                 hwaddr addr, uint64_t *val)
+{
+    switch (addr) {
+    case REG_AIC_WHOAMI:
+        *val = o->cpu_id;
+        return true;
+    case REG_AIC_IACK:
+        *val = apple_aic_iack(s, o);
+        return true;
+    default:
+        return false;
     }
-    case REG_AIC_EIR_MASK_SET(0)... REG_AIC_EIR_MASK_SET(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_MASK_SET(0)) / 4;
+}
 
-        if (unlikely(eir >= s->numEIR)) {
-            break;
-        }
+static uint64_t apple_aic_read(void *opaque, hwaddr addr, unsigned size)
+{
+    AppleAICCPU *o = (AppleAICCPU *)opaque;
+    AppleAICState *s = o->aic;
+    AppleAICCPU *cpu;
+    uint64_t val;
+    int eir;
 
-        return s->eir_mask[eir];
-    }
-    case REG_AIC_EIR_MASK_CLR(0)... REG_AIC_EIR_MASK_CLR(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_MASK_CLR(0)) / 4;
+    QEMU_LOCK_GUARD(&s->mutex);
 
-        if (unlikely(eir >= s->numEIR)) {
-            break;
+    switch (apple_aic_decode(addr)) {
+    case AIC_REGION_CPU:
+        cpu = apple_aic_decode_cpu(s, addr);
+        if (cpu == NULL) {
+            return -1;
         }
-
-        return s->eir_mask[eir];
-    }
-    case REG_AIC_EIR_INT_RO(0)... REG_AIC_EIR_INT_RO(kAIC_NUM_EIRS): {
-        uint32_t eir = (addr - REG_AIC_EIR_INT_RO(0)) / 4;
-
-        if (unlikely(eir >= s->numEIR)) {
-            break;
+        if (apple_aic_read_local(
+                s, cpu, REG_AIC_WHOAMI + (addr & (AIC_REGION_SIZE - 1)),
+                &val)) {
+            return val;
         }
-        return s->eir_state[eir];
-    }
-    case REG_AIC_WHOAMI_Pn(0)... REG_AIC_WHOAMI_Pn(AIC_CPU_COUNT) - 4: {
-        uint32_t cpu = ((addr - 0x5000) / 0x80);
-        uint64_t val;
+        break;
+    case AIC_REGION_LOCAL:
+        if (apple_aic_read_local(s, o, addr, &val)) {
+            return val;
+        }
+        break;
+    case AIC_REGION_EIR_DEST: {
+        uint32_t vector = (addr - REG_AIC_EIR_DEST(0)) / 4;
 
-        if (unlikely(cpu >= s->numCPU)) {
-            break;
+        if (unlikely(vector >= s->numIRQ)) {
+            return -1;
         }
 
-        addr = addr - 0x5000 + 0x2000 - 0x80 * cpu;
-        qemu_mutex_unlock(&s->mutex);
-        val = apple_aic_read(&s->cpus[cpu], addr, size);
-        qemu_mutex_lock(&s->mutex);
-        return val;
+        return s->eir_dest[vector];
     }
-    default:
-        if (addr == s->time_base + 0x20) {
-            return apple_aic_emulate_timer() & 0xFFFFFFFF;
-        } else if (addr == s->time_base + 0x28) {
-            return (apple_aic_emulate_timer() >> 32) & 0xFFFFFFFF;
-        } else {
-            qemu_log_mask(LOG_UNIMP,
-                          "AIC: Read from unsupported reg 0x" HWADDR_FMT_plx
-                          " cpu: %u\n",
-                          addr, o->cpu_id);
+    case AIC_REGION_EIR_MASK_SET:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_MASK_SET(0));
+        return eir >= 0 ? s->eir_mask[eir] : -1;
+    case AIC_REGION_EIR_MASK_CLR:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_MASK_CLR(0));
+        return eir >= 0 ? s->eir_mask[eir] : -1;
+    case AIC_REGION_EIR_INT_RO:
+        eir = apple_aic_decode_eir(s, addr - REG_AIC_EIR_INT_RO(0));
+        return eir >= 0 ? s->eir_state[eir] : -1;
+    case AIC_REGION_GLOBAL:
+        switch (addr) {
+        case REG_AIC_REV:
+            return AIC_VERSION;
+        case REG_AIC_CAP0:
+            return (((uint64_t)s->numCPU - 1) << 16) | (s->numIRQ);
+        case REG_AIC_GLB_CFG:
+            return s->global_cfg;
+        default:
+            break;
         }
         break;
+    default:
+        break;
+    }
+
+    if (addr == s->time_base + 0x20) {
+        return apple_aic_emulate_timer() & 0xFFFFFFFF;
+    } else if (addr == s->time_base + 0x28) {
+        return (apple_aic_emulate_timer() >> 32) & 0xFFFFFFFF;
     }
+
+    qemu_log_mask(LOG_UNIMP,
+                  "AIC: Read from unsupported reg 0x" HWADDR_FMT_plx
+                  " cpu: %u\n",
+                  addr, o->cpu_id);
     return -1;
 }
 
@@ -506,7 +531,6 @@ static void apple_aic_realize(DeviceState *dev, struct Error **errp)
     s->eir_state = g_new0(uint32_t, s->numEIR);
 
     s->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, apple_aic_tick, dev);
-    timer_mod_ns(s->timer, kAICWT);
     msi_nonbroken = true;
 }
 
@@ -539,9 +563,12 @@ SysBusDevice *apple_aic_create(uint32_t numCPU, DTBNode *node,
     s->base_size = reg[1];
 
     prop = dtb_find_prop(node, "ipid-mask");
+    g_assert_nonnull(prop);
     s->numEIR = prop->length / 4;
     s->numIRQ = s->numEIR * 32;
+    g_assert_cmpuint(s->numIRQ, <=, AIC_MAX_INT);
 
+    g_assert_cmpuint(numCPU, <=, AIC_MAX_CPU);
     s->numCPU = numCPU;
     dtb_set_prop_u32(node, "#main-cpus", s->numCPU);
 
@@ -573,10 +600,29 @@ static const VMStateDescription vmstate_apple_aic_cpu = {
         }
 };
 
+static int apple_aic_post_load(void *opaque, int version_id)
+{
+    AppleAICState *s = APPLE_AIC(opaque);
+    bool deferred;
+
+    QEMU_LOCK_GUARD(&s->mutex);
+
+    /*
+     * The cpus bring their own IRQ line levels along, only the tick has
+     * to be re-armed if something was still outstanding.
+     */
+    if ((apple_aic_route(s, &deferred) != 0 || deferred) &&
+        !timer_pending(s->timer)) {
+        timer_mod_ns(s->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + kAICWT);
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_apple_aic = {
     .name = "apple_aic",
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = apple_aic_post_load,
     .fields =
         (const VMStateField[]){
             VMSTATE_UINT32(numEIR, AppleAICState),
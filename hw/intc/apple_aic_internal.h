@@ -0,0 +1,171 @@
+/*
+ * Apple Interrupt Controller register layout.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_INTC_APPLE_AIC_INTERNAL_H
+#define HW_INTC_APPLE_AIC_INTERNAL_H
+
+#include "exec/hwaddr.h"
+
+/*
+ * AIC splits IRQs into domains (ipid)
+ * In T8030 device tree, we have aic->ipid_length = 72
+ * => IRQ(extInts) max nr = ((len(ipid_mask)>>2)<<5) = 0x240 (interrupts)
+ * -> num domains = (0x240 + 31)>>5 = 18 (domains)
+ * 0x240/18 = 32 (bits) of an uint32_t
+ *
+ * Commands such as REG_AIC_EIR_MASK_SET/CLR assign each domain to a 32bit
+ * register. When masking/unmasking-ing IRQ n, write to (aic_base +
+ * command_reg_base + (n / 32) * 4) a uint32_t which has (n % 32)-th bit set,
+ * command_reg_base is 0x4100 for REG_AIC_EIR_MASK_SET, 0x4180 for
+ * REG_AIC_EIR_MASK_CLR.
+ *
+ * T8030 uses both fast IPI, and AIC IPIs.
+ * AIC IPIs' vectors are right after IRQs' vectors.
+ * num IRQ + (X * 2) -> self_ipi (cpuX->cpuX)
+ * num IRQ + (Y * 2) + 1 -> other_ipi (cpuX->cpuY)
+ */
+
+/*
+ * The actual counts come from the device tree (ipid-mask) and the machine.
+ * These are the limits of the register layout: the EIR_DEST window holds
+ * 1024 vectors, and IPI CPU masks are 31 bits wide as bit 31 is AIC_IPI_SELF.
+ */
+#define AIC_MAX_INT (1024)
+#define AIC_MAX_CPU (31)
+#define AIC_VERSION (2)
+
+#define REG_AIC_REV (0x0000)
+#define REG_AIC_CAP0 (0x0004)
+#define REG_AIC_CAP1 (0x0008)
+#define REG_AIC_RST (0x000C)
+
+#define REG_AIC_GLB_CFG (0x0010)
+#define AIC_GLBCFG_IEN (1 << 0)
+#define AIC_GLBCFG_AEWT(_t) ((_t) << 4)
+#define AIC_GLBCFG_SEWT(_t) ((_t) << 8)
+#define AIC_GLBCFG_AIWT(_t) ((_t) << 12)
+#define AIC_GLBCFG_SIWT(_t) ((_t) << 16)
+#define AIC_GLBCFG_SYNC_ACG (1 << 29)
+#define AIC_GLBCFG_EIR_ACG (1 << 30)
+#define AIC_GLBCFG_REG_ACG (1 << 31)
+#define AIC_GLBCFG_WT_MASK (15)
+#define AIC_GLBCFG_WT_64MICRO (7)
+
+#define REG_AIC_WHOAMI (0x2000)
+#define REG_AIC_IACK (0x2004)
+#define REG_AIC_IPI_SET (0x2008)
+#define REG_AIC_IPI_CLR (0x200C)
+#define AIC_IPI_NORMAL (1 << 0)
+#define AIC_IPI_SELF (1 << 31)
+#define REG_AIC_IPI_MASK_SET (0x2024)
+#define REG_AIC_IPI_MASK_CLR (0x2028)
+#define REG_AIC_IPI_DEFER_SET (0x202C)
+#define REG_AIC_IPI_DEFER_CLR (0x2030)
+
+#define REG_AIC_EIR_DEST(_n) (0x3000 + ((_n) * 4))
+#define REG_AIC_EIR_SW_SET(_n) (0x4000 + ((_n) * 4))
+#define REG_AIC_EIR_SW_CLR(_n) (0x4080 + ((_n) * 4))
+#define REG_AIC_EIR_MASK_SET(_n) (0x4100 + ((_n) * 4))
+#define REG_AIC_EIR_MASK_CLR(_n) (0x4180 + ((_n) * 4))
+#define REG_AIC_EIR_INT_RO(_n) (0x4200 + ((_n) * 4))
+
+#define REG_AIC_WHOAMI_Pn(_n) (0x5000 + ((_n) * 0x80))
+#define REG_AIC_IACK_Pn(_n) (0x5004 + ((_n) * 0x80))
+#define REG_AIC_IPI_SET_Pn(_n) (0x5008 + ((_n) * 0x80))
+#define REG_AIC_IPI_CLR_Pn(_n) (0x500C + ((_n) * 0x80))
+#define REG_AIC_IPI_MASK_SET_Pn(_n) (0x5024 + ((_n) * 0x80))
+#define REG_AIC_IPI_MASK_CLR_Pn(_n) (0x5028 + ((_n) * 0x80))
+#define REG_AIC_IPI_DEFER_SET_Pn(_n) (0x502C + ((_n) * 0x80))
+#define REG_AIC_IPI_DEFER_CLR_Pn(_n) (0x5030 + ((_n) * 0x80))
+
+#define kAIC_INT_SPURIOUS (0x00000)
+#define kAIC_INT_EXT (0x10000)
+#define kAIC_INT_IPI (0x40000)
+#define kAIC_INT_IPI_NORM (0x40001)
+#define kAIC_INT_IPI_SELF (0x40002)
+
+#define AIC_INT_EXT(_v) (((_v) & 0x70000) == kAIC_INT_EXT)
+#define AIC_INT_IPI(_v) (((_v) & 0x70000) == kAIC_INT_IPI)
+
+#define AIC_INT_EXTID(_v) ((_v) & 0x3FF)
+
+#define AIC_SRC_TO_EIR(_s) ((_s) >> 5)
+#define AIC_SRC_TO_MASK(_s) (1 << ((_s) & 0x1F))
+#define AIC_EIR_TO_SRC(_s, _v) (((_s) << 5) + ((_v) & 0x1F))
+
+#define kAIC_MAX_EXTID (AIC_MAX_INT)
+#define kAIC_VEC_IPI (kAIC_MAX_EXTID)
+#define kAIC_NUM_INTS (kAIC_VEC_IPI + 1)
+
+#define kAIC_NUM_EIRS AIC_SRC_TO_EIR(kAIC_MAX_EXTID)
+
+/*
+ * The register file is decoded in two steps: the 128 byte block an access
+ * falls in selects the handler through apple_aic_regions, and the handler
+ * only has to look at the offset within its block. Each block of the
+ * REG_AIC_*_Pn window aliases the local registers of one cpu.
+ */
+typedef enum {
+    AIC_REGION_UNMAPPED = 0,
+    AIC_REGION_GLOBAL,
+    AIC_REGION_LOCAL,
+    AIC_REGION_EIR_DEST,
+    AIC_REGION_EIR_SW_SET,
+    AIC_REGION_EIR_SW_CLR,
+    AIC_REGION_EIR_MASK_SET,
+    AIC_REGION_EIR_MASK_CLR,
+    AIC_REGION_EIR_INT_RO,
+    AIC_REGION_CPU,
+} AppleAICRegion;
+
+#define AIC_REGION_SHIFT (7)
+#define AIC_REGION_SIZE (1 << AIC_REGION_SHIFT)
+#define AIC_REGION(_addr) ((_addr) >> AIC_REGION_SHIFT)
+#define AIC_REGION_END REG_AIC_WHOAMI_Pn(AIC_MAX_CPU)
+
+static const uint8_t apple_aic_regions[AIC_REGION(AIC_REGION_END)] = {
+    [AIC_REGION(REG_AIC_REV)] = AIC_REGION_GLOBAL,
+    [AIC_REGION(REG_AIC_WHOAMI)] = AIC_REGION_LOCAL,
+    [AIC_REGION(REG_AIC_EIR_DEST(0))... AIC_REGION(
+        REG_AIC_EIR_DEST(AIC_MAX_INT) - 4)] = AIC_REGION_EIR_DEST,
+    [AIC_REGION(REG_AIC_EIR_SW_SET(0))] = AIC_REGION_EIR_SW_SET,
+    [AIC_REGION(REG_AIC_EIR_SW_CLR(0))] = AIC_REGION_EIR_SW_CLR,
+    [AIC_REGION(REG_AIC_EIR_MASK_SET(0))] = AIC_REGION_EIR_MASK_SET,
+    [AIC_REGION(REG_AIC_EIR_MASK_CLR(0))] = AIC_REGION_EIR_MASK_CLR,
+    [AIC_REGION(REG_AIC_EIR_INT_RO(0))] = AIC_REGION_EIR_INT_RO,
+    [AIC_REGION(REG_AIC_WHOAMI_Pn(0))... AIC_REGION(AIC_REGION_END - 4)] =
+        AIC_REGION_CPU,
+};
+
+QEMU_BUILD_BUG_ON(REG_AIC_EIR_SW_SET(kAIC_NUM_EIRS) -
+                      REG_AIC_EIR_SW_SET(0) !=
+                  AIC_REGION_SIZE);
+QEMU_BUILD_BUG_ON(REG_AIC_WHOAMI_Pn(1) - REG_AIC_WHOAMI_Pn(0) !=
+                  AIC_REGION_SIZE);
+
+static inline AppleAICRegion apple_aic_decode(hwaddr addr)
+{
+    if (unlikely(addr >= AIC_REGION_END)) {
+        return AIC_REGION_UNMAPPED;
+    }
+
+    return apple_aic_regions[AIC_REGION(addr)];
+}
+
+#endif /* HW_INTC_APPLE_AIC_INTERNAL_H */
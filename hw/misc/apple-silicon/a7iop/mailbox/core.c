@@ -13,6 +13,7 @@
 #include "qemu/lockable.h"
 #include "qemu/log.h"
 #include "qemu/queue.h"
+#include "system/replay.h"
 
 #define MAX_MESSAGE_COUNT 15
 
@@ -190,12 +191,15 @@ static void apple_a7iop_mailbox_send(AppleA7IOPMailbox *s,
     QEMU_LOCK_GUARD(&s->lock);
     trace_apple_a7iop_mailbox_send(s->role, ldq_le_p(msg->data),
                                    ldq_le_p(msg->data + sizeof(uint64_t)));
+    if (s->observer != NULL) {
+        s->observer(s->observer_opaque, s, msg, true);
+    }
     QTAILQ_INSERT_TAIL(&s->inbox, msg, next);
     s->count++;
     apple_a7iop_mailbox_update_irq(s);
 
     if (s->bh != NULL) {
-        qemu_bh_schedule(s->bh);
+        replay_bh_schedule_event(s->bh);
     }
 }
 
@@ -263,6 +267,9 @@ static AppleA7IOPMessage *apple_a7iop_mailbox_recv(AppleA7IOPMailbox *s)
     stl_le_p(msg->data + 0xC, ldl_le_p(msg->data + 0xC) | CTRL_COUNT(s->count));
     trace_apple_a7iop_mailbox_recv(s->role, ldq_le_p(msg->data),
                                    ldq_le_p(msg->data + sizeof(uint64_t)));
+    if (s->observer != NULL) {
+        s->observer(s->observer_opaque, s, msg, false);
+    }
     s->count--;
     apple_a7iop_mailbox_update_irq(s);
     return msg;
@@ -2,9 +2,12 @@
 #include "hw/misc/apple-silicon/a7iop/mailbox/core.h"
 #include "hw/misc/apple-silicon/a7iop/private.h"
 #include "hw/misc/apple-silicon/a7iop/rtkit.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
 #include "hw/resettable.h"
+#include "qapi/visitor.h"
 #include "qemu/lockable.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
 #include "trace.h"
 
 const VMStateDescription vmstate_apple_rtkit = {
@@ -35,6 +38,32 @@ const VMStateDescription vmstate_apple_rtkit = {
 #define MSG_TYPE_ROLLCALL (8)
 #define MSG_TYPE_SET_AP_PSTATE (11)
 
+static const char *const apple_rtkit_pstate_names[RTKIT_PSTATE_COUNT] = {
+    [RTKIT_PSTATE_OFF] = "off",
+    [RTKIT_PSTATE_ON] = "on",
+    [RTKIT_PSTATE_PWRGATE] = "pwrgate",
+    [RTKIT_PSTATE_SLEEP] = "sleep",
+};
+
+static void apple_rtkit_set_pstate(AppleRTKit *s, AppleRTKitPState pstate)
+{
+    AppleRTKitIOReport *r = &s->ioreport;
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+
+    if (r->pstate == pstate) {
+        return;
+    }
+
+    trace_apple_rtkit_set_pstate(APPLE_A7IOP(s)->role,
+                                 apple_rtkit_pstate_names[r->pstate],
+                                 apple_rtkit_pstate_names[pstate]);
+
+    r->residency_ns[r->pstate] += now - r->pstate_entered_ns;
+    r->pstate = pstate;
+    r->pstate_entered_ns = now;
+    r->transitions += 1;
+}
+
 static inline AppleA7IOPMessage *apple_rtkit_construct_msg(uint32_t ep,
                                                            uint64_t data)
 {
@@ -52,6 +81,10 @@ static inline AppleA7IOPMessage *apple_rtkit_construct_msg(uint32_t ep,
 static inline void apple_rtkit_send_msg(AppleRTKit *s, uint32_t ep,
                                         uint64_t data)
 {
+    trace_apple_rtkit_send_msg(APPLE_A7IOP(s)->role, ep, data);
+    if (ep < ARRAY_SIZE(s->ioreport.tx)) {
+        s->ioreport.tx[ep] += 1;
+    }
     apple_a7iop_send_ap(APPLE_A7IOP(s), apple_rtkit_construct_msg(ep, data));
 }
 
@@ -72,15 +105,14 @@ static inline void apple_rtkit_register_ep(AppleRTKit *s, uint32_t ep,
                                            AppleRTKitEPHandler *handler,
                                            bool user)
 {
-    AppleRTKitEPData *data;
+    AppleRTKitEPData *data = &s->endpoints[ep];
 
     g_assert_nonnull(opaque);
-    g_assert_null(g_tree_lookup(s->endpoints, GUINT_TO_POINTER(ep)));
-    data = g_new0(AppleRTKitEPData, 1);
+    g_assert_null(data->opaque);
     data->opaque = opaque;
     data->handler = handler;
     data->user = user;
-    g_tree_insert(s->endpoints, GUINT_TO_POINTER(ep), data);
+    s->ep_mask[ep / 32] |= BIT(ep % 32);
 }
 
 void apple_rtkit_register_control_ep(AppleRTKit *s, uint32_t ep, void *opaque,
@@ -99,11 +131,8 @@ void apple_rtkit_register_user_ep(AppleRTKit *s, uint32_t ep, void *opaque,
 
 static inline void apple_rtkit_unregister_ep(AppleRTKit *s, uint32_t ep)
 {
-    void *ep_data = g_tree_lookup(s->endpoints, GUINT_TO_POINTER(ep));
-    if (ep_data != NULL) {
-        g_tree_remove(s->endpoints, GUINT_TO_POINTER(ep));
-        g_free(ep_data);
-    }
+    memset(&s->endpoints[ep], 0, sizeof(s->endpoints[ep]));
+    s->ep_mask[ep / 32] &= ~BIT(ep % 32);
 }
 
 void apple_rtkit_unregister_control_ep(AppleRTKit *s, uint32_t ep)
@@ -118,55 +147,54 @@ void apple_rtkit_unregister_user_ep(AppleRTKit *s, uint32_t ep)
     apple_rtkit_unregister_ep(s, ep + EP_USER_START);
 }
 
-static gboolean iop_rollcall(gpointer key, gpointer value, gpointer data)
+static void iop_queue_rollcall(AppleRTKit *s, uint32_t block, uint32_t mask,
+                               bool ended)
 {
-    AppleRTKitRollcallData *d = (AppleRTKitRollcallData *)data;
-    AppleRTKit *s = d->s;
     AppleRTKitManagementMessage mgmt_msg = { 0 };
     AppleA7IOPMessage *msg;
 
-    uint32_t ep = (uint64_t)key;
-    if ((uint64_t)key < 1) {
-        return false;
-    }
-
-    if (ep / EP_USER_START != d->last_block && d->mask) {
-        mgmt_msg.type = MSG_TYPE_ROLLCALL;
-        mgmt_msg.rollcall.epMask = d->mask;
-        mgmt_msg.rollcall.epBlock = d->last_block;
-        mgmt_msg.rollcall.epEnded = false;
-        msg = apple_rtkit_construct_msg(EP_MANAGEMENT, mgmt_msg.raw);
-        QTAILQ_INSERT_TAIL(&s->rollcall, msg, next);
-        d->mask = 0;
-    }
-    d->last_block = ep / EP_USER_START;
-    d->mask |= 1 << (ep & (EP_USER_START - 1));
-    return false;
+    mgmt_msg.type = MSG_TYPE_ROLLCALL;
+    mgmt_msg.rollcall.epMask = mask;
+    mgmt_msg.rollcall.epBlock = block;
+    mgmt_msg.rollcall.epEnded = ended;
+    msg = apple_rtkit_construct_msg(EP_MANAGEMENT, mgmt_msg.raw);
+    QTAILQ_INSERT_TAIL(&s->rollcall, msg, next);
 }
 
 static void iop_start_rollcall(AppleRTKit *s)
 {
     AppleA7IOP *a7iop;
-    AppleRTKitRollcallData data = { 0 };
     AppleA7IOPMessage *msg;
-    AppleRTKitManagementMessage mgmt_msg = { 0 };
+    uint32_t mask[ARRAY_SIZE(s->ep_mask)];
+    uint32_t last_block;
+    uint32_t block;
 
     a7iop = APPLE_A7IOP(s);
 
-    data.s = s;
     while (!QTAILQ_EMPTY(&s->rollcall)) {
         msg = QTAILQ_FIRST(&s->rollcall);
         QTAILQ_REMOVE(&s->rollcall, msg, next);
         g_free(msg);
     }
     s->ep0_status = EP0_WAIT_ROLLCALL;
-    g_tree_foreach(s->endpoints, iop_rollcall, &data);
-    mgmt_msg.type = MSG_TYPE_ROLLCALL;
-    mgmt_msg.rollcall.epMask = data.mask;
-    mgmt_msg.rollcall.epBlock = data.last_block;
-    mgmt_msg.rollcall.epEnded = true;
-    msg = apple_rtkit_construct_msg(EP_MANAGEMENT, mgmt_msg.raw);
-    QTAILQ_INSERT_TAIL(&s->rollcall, msg, next);
+
+    // The management endpoint is implied and never announced.
+    memcpy(mask, s->ep_mask, sizeof(mask));
+    mask[0] &= ~BIT(EP_MANAGEMENT);
+
+    last_block = 0;
+    for (block = 0; block < ARRAY_SIZE(mask); block++) {
+        if (mask[block] != 0) {
+            last_block = block;
+        }
+    }
+
+    for (block = 0; block < last_block; block++) {
+        if (mask[block] != 0) {
+            iop_queue_rollcall(s, block, mask[block], false);
+        }
+    }
+    iop_queue_rollcall(s, last_block, mask[last_block], true);
 
     msg = QTAILQ_FIRST(&s->rollcall);
     QTAILQ_REMOVE(&s->rollcall, msg, next);
@@ -214,10 +242,16 @@ static void apple_rtkit_handle_mgmt_msg(void *opaque, uint32_t ep,
         switch (MSG_GET_PSTATE(msg->raw)) {
         case PSTATE_WAIT_VR:
         case PSTATE_ON: {
+            apple_rtkit_set_pstate(s, RTKIT_PSTATE_ON);
             apple_a7iop_cpu_start(a7iop, true);
             break;
         }
+        case PSTATE_PWRGATE: {
+            apple_rtkit_set_pstate(s, RTKIT_PSTATE_PWRGATE);
+            break;
+        }
         case PSTATE_SLPNOMEM: {
+            apple_rtkit_set_pstate(s, RTKIT_PSTATE_SLEEP);
             m.type = MSG_TYPE_SET_AP_PSTATE_ACK;
             m.power.state = MSG_GET_PSTATE(msg->raw);
             apple_a7iop_set_cpu_status(a7iop, CPU_STATUS_IDLE);
@@ -238,6 +272,7 @@ static void apple_rtkit_handle_mgmt_msg(void *opaque, uint32_t ep,
             m.power.state = 32;
             s->ep0_status = EP0_IDLE;
             trace_apple_rtkit_rollcall_finished(a7iop->role);
+            apple_boot_milestone_fmt("rtkit-%s-running", a7iop->role);
             apple_rtkit_send_msg(s, ep, m.raw);
 
             if (s->ops != NULL && s->ops->boot_done != NULL) {
@@ -281,6 +316,7 @@ static void apple_rtkit_iop_start(AppleA7IOP *s)
 
     trace_apple_rtkit_iop_start(s->role);
 
+    apple_rtkit_set_pstate(rtk, RTKIT_PSTATE_ON);
     apple_a7iop_set_cpu_status(s, apple_a7iop_get_cpu_status(s) &
                                       ~CPU_STATUS_IDLE);
 
@@ -299,6 +335,7 @@ static void apple_rtkit_iop_wakeup(AppleA7IOP *s)
 
     trace_apple_rtkit_iop_wakeup(s->role);
 
+    apple_rtkit_set_pstate(rtk, RTKIT_PSTATE_ON);
     apple_a7iop_set_cpu_status(s, apple_a7iop_get_cpu_status(s) &
                                       ~CPU_STATUS_IDLE);
 
@@ -326,8 +363,15 @@ static void apple_rtkit_bh(void *opaque)
     while (!apple_a7iop_mailbox_is_empty(a7iop->iop_mailbox)) {
         msg = apple_a7iop_recv_iop(a7iop);
         rtk_msg = (AppleRTKitMessage *)msg->data;
-        data = g_tree_lookup(s->endpoints, GUINT_TO_POINTER(rtk_msg->endpoint));
-        if (data && data->handler) {
+        trace_apple_rtkit_recv_msg(a7iop->role, rtk_msg->endpoint,
+                                   rtk_msg->msg);
+        if (rtk_msg->endpoint < ARRAY_SIZE(s->ioreport.rx)) {
+            s->ioreport.rx[rtk_msg->endpoint] += 1;
+        }
+        data = rtk_msg->endpoint < RTKIT_EP_COUNT ?
+                   &s->endpoints[rtk_msg->endpoint] :
+                   NULL;
+        if (data != NULL && data->handler != NULL) {
             data->handler(data->opaque,
                           data->user ? rtk_msg->endpoint - EP_USER_START :
                                        rtk_msg->endpoint,
@@ -342,11 +386,6 @@ static const AppleA7IOPOps apple_rtkit_iop_ops = {
     .wakeup = apple_rtkit_iop_wakeup,
 };
 
-static gint g_uint_cmp(gconstpointer a, gconstpointer b)
-{
-    return a - b;
-}
-
 void apple_rtkit_init(AppleRTKit *s, void *opaque, const char *role,
                       uint64_t mmio_size, AppleA7IOPVersion version,
                       uint32_t protocol_version, const AppleRTKitOps *ops)
@@ -359,7 +398,6 @@ void apple_rtkit_init(AppleRTKit *s, void *opaque, const char *role,
                                          &DEVICE(s)->mem_reentrancy_guard));
 
     s->opaque = opaque ? opaque : s;
-    s->endpoints = g_tree_new(g_uint_cmp);
     s->protocol_version = protocol_version;
     s->ops = ops;
     QTAILQ_INIT(&s->rollcall);
@@ -399,6 +437,10 @@ static void apple_rtkit_reset(Object *obj, ResetType type)
 
     s->ep0_status = EP0_IDLE;
 
+    memset(&s->ioreport, 0, sizeof(s->ioreport));
+    s->ioreport.pstate = RTKIT_PSTATE_OFF;
+    s->ioreport.pstate_entered_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+
     while (!QTAILQ_EMPTY(&s->rollcall)) {
         msg = QTAILQ_FIRST(&s->rollcall);
         QTAILQ_REMOVE(&s->rollcall, msg, next);
@@ -406,6 +448,85 @@ static void apple_rtkit_reset(Object *obj, ResetType type)
     }
 }
 
+static bool apple_rtkit_visit_residency(Visitor *v, int64_t *residency_ns,
+                                        Error **errp)
+{
+    int i;
+
+    if (!visit_start_struct(v, "residency-ns", NULL, 0, errp)) {
+        return false;
+    }
+
+    for (i = 0; i < RTKIT_PSTATE_COUNT; i++) {
+        if (!visit_type_int64(v, apple_rtkit_pstate_names[i], &residency_ns[i],
+                              errp)) {
+            visit_end_struct(v, NULL);
+            return false;
+        }
+    }
+
+    visit_end_struct(v, NULL);
+    return true;
+}
+
+static bool apple_rtkit_visit_endpoints(AppleRTKitIOReport *r, Visitor *v,
+                                        Error **errp)
+{
+    uint32_t ep;
+
+    if (!visit_start_list(v, "endpoints", NULL, 0, errp)) {
+        return false;
+    }
+
+    for (ep = 0; ep < ARRAY_SIZE(r->rx); ep++) {
+        if (r->rx[ep] == 0 && r->tx[ep] == 0) {
+            continue;
+        }
+
+        if (!visit_start_struct(v, NULL, NULL, 0, errp)) {
+            return false;
+        }
+        if (!visit_type_uint32(v, "endpoint", &ep, errp) ||
+            !visit_type_uint64(v, "rx", &r->rx[ep], errp) ||
+            !visit_type_uint64(v, "tx", &r->tx[ep], errp)) {
+            visit_end_struct(v, NULL);
+            return false;
+        }
+        visit_end_struct(v, NULL);
+    }
+
+    visit_end_list(v, NULL);
+    return true;
+}
+
+static void apple_rtkit_get_ioreport(Object *obj, Visitor *v, const char *name,
+                                     void *opaque, Error **errp)
+{
+    AppleRTKit *s = APPLE_RTKIT(obj);
+    AppleRTKitIOReport r;
+    g_autofree char *pstate = NULL;
+
+    WITH_QEMU_LOCK_GUARD(&s->lock) {
+        r = s->ioreport;
+    }
+
+    // Account the time spent in the current state up to now.
+    r.residency_ns[r.pstate] +=
+        qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) - r.pstate_entered_ns;
+    pstate = g_strdup(apple_rtkit_pstate_names[r.pstate]);
+
+    if (!visit_start_struct(v, name, NULL, 0, errp)) {
+        return;
+    }
+    if (visit_type_str(v, "pstate", &pstate, errp) &&
+        visit_type_uint64(v, "transitions", &r.transitions, errp) &&
+        apple_rtkit_visit_residency(v, r.residency_ns, errp) &&
+        apple_rtkit_visit_endpoints(&r, v, errp)) {
+        visit_check_struct(v, errp);
+    }
+    visit_end_struct(v, NULL);
+}
+
 static void apple_rtkit_class_init(ObjectClass *klass, void *data)
 {
     ResettableClass *rc;
@@ -417,6 +538,11 @@ static void apple_rtkit_class_init(ObjectClass *klass, void *data)
     rtkc = APPLE_RTKIT_CLASS(klass);
 
     dc->desc = "Apple RTKit IOP";
+    object_class_property_add(klass, "ioreport", "AppleRTKitIOReport",
+                              apple_rtkit_get_ioreport, NULL, NULL, NULL);
+    object_class_property_set_description(
+        klass, "ioreport",
+        "Power state residency and per-endpoint message counts of the IOP");
     resettable_class_set_parent_phases(rc, NULL, apple_rtkit_reset, NULL,
                                        &rtkc->parent_reset);
     set_bit(DEVICE_CATEGORY_MISC, dc->categories);
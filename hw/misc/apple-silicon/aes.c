@@ -12,7 +12,9 @@
 #include "qemu/main-loop.h"
 #include "qemu/module.h"
 #include "qemu/rcu.h"
+#include "system/cpu-timers.h"
 #include "system/dma.h"
+#include "system/replay.h"
 #include "trace.h"
 
 OBJECT_DECLARE_SIMPLE_TYPE(AppleAESState, APPLE_AES)
@@ -58,6 +60,12 @@ struct AppleAESState {
     AESKey keys[2];
     uint8_t iv[4][16];
     bool stopped;
+    /*
+     * Under icount or record/replay the worker thread would complete
+     * commands at a wall-clock dependent point of guest execution, so
+     * the queue is drained synchronously from the MMIO path instead.
+     */
+    bool sync;
     uint32_t board_id;
 };
 
@@ -105,6 +113,7 @@ static QCryptoCipherMode key_mode(block_mode_t mode)
 
 static void apple_aes_reset(DeviceState *s);
 static void *aes_thread(void *opaque);
+static void aes_process_queue_sync(AppleAESState *s);
 
 static void aes_update_irq(AppleAESState *s)
 {
@@ -150,7 +159,10 @@ static void aes_empty_fifo(AppleAESState *s)
 
 static void aes_start(AppleAESState *s)
 {
-    if (s->stopped) {
+    if (s->sync) {
+        s->stopped = false;
+        aes_process_queue_sync(s);
+    } else if (s->stopped) {
         s->stopped = false;
         qemu_thread_create(&s->thread, TYPE_APPLE_AES, aes_thread, s,
                            QEMU_THREAD_JOINABLE);
@@ -159,7 +171,9 @@ static void aes_start(AppleAESState *s)
 
 static void aes_stop(AppleAESState *s)
 {
-    if (!s->stopped) {
+    if (s->sync) {
+        s->stopped = true;
+    } else if (!s->stopped) {
         s->stopped = true;
         qemu_cond_signal(&s->thread_cond);
         qemu_thread_join(&s->thread);
@@ -170,10 +184,12 @@ static bool aes_process_command(AppleAESState *s, AESCommand *cmd)
 {
     trace_apple_aes_process_command(COMMAND_OPCODE(cmd->command));
     bool locked = false;
-#define lock_reg()     \
-    do {               \
-        bql_lock();    \
-        locked = true; \
+#define lock_reg()         \
+    do {                   \
+        if (!s->sync) {    \
+            bql_lock();    \
+        }                  \
+        locked = true;     \
     } while (0)
     switch (COMMAND_OPCODE(cmd->command)) {
     case OPCODE_KEY: {
@@ -365,6 +381,28 @@ static void *aes_thread(void *opaque)
     return NULL;
 }
 
+static void aes_process_queue_sync(AppleAESState *s)
+{
+    while (!s->stopped) {
+        AESCommand *cmd = NULL;
+        WITH_QEMU_LOCK_GUARD(&s->queue_mutex)
+        {
+            cmd = QTAILQ_FIRST(&s->queue);
+            if (cmd) {
+                QTAILQ_REMOVE(&s->queue, cmd, entry);
+            }
+        }
+        if (!cmd) {
+            break;
+        }
+        aes_process_command(s, cmd);
+        s->reg.command_fifo_status.level -= cmd->data_len;
+        aes_update_command_fifo_status(s);
+        g_free(cmd->data);
+        g_free(cmd);
+    }
+}
+
 static void aes_security_reg_write(void *opaque, hwaddr addr, uint64_t data,
                                    unsigned size)
 {
@@ -528,6 +566,13 @@ static void aes_reg_write(void *opaque, hwaddr addr, uint64_t data,
             }
         }
 
+        /*
+         * Account for the word before queueing the command; the queue may
+         * be drained (and the level decremented) right away.
+         */
+        s->reg.command_fifo_status.level++;
+        aes_update_command_fifo_status(s);
+
         if (s->data && s->data_len <= s->data_read) {
             AESCommand *cmd = g_malloc0(sizeof(AESCommand));
             cmd->command = s->command;
@@ -542,13 +587,15 @@ static void aes_reg_write(void *opaque, hwaddr addr, uint64_t data,
             {
                 QTAILQ_INSERT_TAIL(&s->queue, cmd, entry);
             }
-            qemu_cond_signal(&s->thread_cond);
+            if (s->sync) {
+                aes_process_queue_sync(s);
+            } else {
+                qemu_cond_signal(&s->thread_cond);
+            }
         }
 
         nowrite = true;
         val = 0;
-        s->reg.command_fifo_status.level++;
-        aes_update_command_fifo_status(s);
         break;
     case REG_AES_CONFIG:
         break;
@@ -664,6 +711,7 @@ static void apple_aes_realize(DeviceState *dev, Error **errp)
     s->dma_mr = MEMORY_REGION(obj);
     address_space_init(&s->dma_as, s->dma_mr, TYPE_APPLE_AES);
 
+    s->sync = icount_enabled() || replay_mode != REPLAY_MODE_NONE;
     qemu_cond_init(&s->thread_cond);
     qemu_mutex_init(&s->queue_mutex);
     apple_aes_reset(dev);
@@ -21,7 +21,10 @@
 #include "exec/memattrs.h"
 #include "hw/misc/apple-silicon/a7iop/rtkit.h"
 #include "hw/misc/apple-silicon/aop.h"
+#include "migration/qemu-file-types.h"
+#include "migration/vmstate.h"
 #include "qapi/error.h"
+#include "qemu/error-report.h"
 #include "qemu/log.h"
 #include "system/dma.h"
 
@@ -752,6 +755,74 @@ static void apple_aop_reset_hold(Object *obj, ResetType type)
     g_list_foreach(s->endpoints, apple_aop_ep_reset_foreach, NULL);
 }
 
+// Endpoints are registered at creation time in a fixed order, so the list
+// is migrated positionally, prefixed by its length.
+static int get_aop_endpoints(QEMUFile *f, void *pv, size_t size,
+                             const VMStateField *field)
+{
+    GList *endpoints = *(GList **)pv;
+    AppleAOPEndpoint *ep;
+    uint32_t count;
+    GList *l;
+
+    count = qemu_get_be32(f);
+    if (count != g_list_length(endpoints)) {
+        error_report("%s: endpoint count mismatch (%u != %u)", __func__,
+                     count, g_list_length(endpoints));
+        return -EINVAL;
+    }
+
+    for (l = endpoints; l != NULL; l = l->next) {
+        ep = l->data;
+        QEMU_LOCK_GUARD(&ep->mutex);
+        ep->state = qemu_get_be32(f);
+        ep->rx_off = qemu_get_be32(f);
+        ep->tx_off = qemu_get_be32(f);
+        ep->seq = qemu_get_be16(f);
+    }
+
+    return 0;
+}
+
+static int put_aop_endpoints(QEMUFile *f, void *pv, size_t size,
+                             const VMStateField *field, JSONWriter *vmdesc)
+{
+    GList *endpoints = *(GList **)pv;
+    AppleAOPEndpoint *ep;
+    GList *l;
+
+    qemu_put_be32(f, g_list_length(endpoints));
+    for (l = endpoints; l != NULL; l = l->next) {
+        ep = l->data;
+        QEMU_LOCK_GUARD(&ep->mutex);
+        qemu_put_be32(f, ep->state);
+        qemu_put_be32(f, ep->rx_off);
+        qemu_put_be32(f, ep->tx_off);
+        qemu_put_be16(f, ep->seq);
+    }
+
+    return 0;
+}
+
+static const VMStateInfo vmstate_info_aop_endpoints = {
+    .name = "aop_endpoints",
+    .get = get_aop_endpoints,
+    .put = put_aop_endpoints,
+};
+
+static const VMStateDescription vmstate_apple_aop = {
+    .name = "AppleAOPState",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_APPLE_RTKIT(parent_obj, AppleAOPState),
+            VMSTATE_SINGLE(endpoints, AppleAOPState, 0,
+                           vmstate_info_aop_endpoints, GList *),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static void apple_aop_class_init(ObjectClass *klass, void *data)
 {
     ResettableClass *rc;
@@ -768,7 +839,7 @@ static void apple_aop_class_init(ObjectClass *klass, void *data)
                                        &aopc->parent_reset);
     dc->desc = "Apple Always-On Processor";
     dc->user_creatable = false;
-    // dc->vmsd = &vmstate_apple_aop;
+    dc->vmsd = &vmstate_apple_aop;
     set_bit(DEVICE_CATEGORY_MISC, dc->categories);
 }
 
@@ -0,0 +1,241 @@
+/*
+ * Apple SoC boot phase timeline.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/misc/apple-silicon/boot-timeline.h"
+#include "qapi/error.h"
+#include "qapi/qobject-output-visitor.h"
+#include "qemu/error-report.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "qobject/qjson.h"
+#include "qobject/qobject.h"
+#include "system/cpu-timers.h"
+#include "system/system.h"
+#include "trace.h"
+
+#define CONSOLE_LINE_MAX (256)
+
+typedef struct {
+    char *name;
+    int64_t host_ns;
+    int64_t virtual_ns;
+    int64_t icount;
+} AppleBootMilestone;
+
+typedef struct {
+    /* Milestone to record. */
+    const char *name;
+    /* Substring of a kernel console line that marks it. */
+    const char *needle;
+    /* Milestone that must already be recorded, or NULL. */
+    const char *after;
+} AppleBootConsolePattern;
+
+static const AppleBootConsolePattern console_patterns[] = {
+    { "root-mount", "BSD root: ", NULL },
+    { "launchd-start", "launchd", "root-mount" },
+};
+
+static struct {
+    bool enabled;
+    bool scan_console;
+    int64_t origin_ns;
+    GArray *milestones;
+    char *output_filename;
+    Notifier exit_notifier;
+    char line[CONSOLE_LINE_MAX];
+    size_t line_len;
+} timeline;
+
+static bool apple_boot_timeline_has(const char *name)
+{
+    AppleBootMilestone *m;
+    guint i;
+
+    for (i = 0; i < timeline.milestones->len; i++) {
+        m = &g_array_index(timeline.milestones, AppleBootMilestone, i);
+        if (strcmp(m->name, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void apple_boot_milestone_clear(gpointer data)
+{
+    g_free(((AppleBootMilestone *)data)->name);
+}
+
+void apple_boot_milestone(const char *name)
+{
+    AppleBootMilestone m;
+
+    if (!timeline.enabled || apple_boot_timeline_has(name)) {
+        return;
+    }
+
+    m.name = g_strdup(name);
+    m.host_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - timeline.origin_ns;
+    m.virtual_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    m.icount = icount_enabled() ? icount_get_raw() : -1;
+    g_array_append_val(timeline.milestones, m);
+
+    trace_apple_boot_milestone(m.name, m.host_ns, m.virtual_ns, m.icount);
+}
+
+void apple_boot_milestone_fmt(const char *fmt, ...)
+{
+    g_autofree char *name = NULL;
+    va_list ap;
+
+    if (!timeline.enabled) {
+        return;
+    }
+
+    va_start(ap, fmt);
+    name = g_strdup_vprintf(fmt, ap);
+    va_end(ap);
+
+    apple_boot_milestone(name);
+}
+
+static void apple_boot_timeline_console_line(void)
+{
+    size_t i;
+
+    timeline.line[timeline.line_len] = '\0';
+
+    for (i = 0; i < ARRAY_SIZE(console_patterns); i++) {
+        const AppleBootConsolePattern *p = &console_patterns[i];
+
+        if (p->after != NULL && !apple_boot_timeline_has(p->after)) {
+            continue;
+        }
+        if (strstr(timeline.line, p->needle) != NULL) {
+            apple_boot_milestone(p->name);
+        }
+    }
+}
+
+void apple_boot_timeline_console_putc(uint8_t ch)
+{
+    if (!timeline.scan_console) {
+        return;
+    }
+
+    if (ch == '\n' || ch == '\r') {
+        if (timeline.line_len != 0) {
+            apple_boot_timeline_console_line();
+            timeline.line_len = 0;
+        }
+    } else if (timeline.line_len < CONSOLE_LINE_MAX - 1) {
+        timeline.line[timeline.line_len++] = ch;
+    }
+}
+
+bool apple_boot_timeline_visit(Visitor *v, const char *name, Error **errp)
+{
+    AppleBootMilestone *m;
+    guint i;
+
+    if (!visit_start_list(v, name, NULL, 0, errp)) {
+        return false;
+    }
+
+    for (i = 0; timeline.milestones != NULL && i < timeline.milestones->len;
+         i++) {
+        m = &g_array_index(timeline.milestones, AppleBootMilestone, i);
+
+        if (!visit_start_struct(v, NULL, NULL, 0, errp)) {
+            return false;
+        }
+        if (!visit_type_str(v, "name", &m->name, errp) ||
+            !visit_type_int64(v, "host-ns", &m->host_ns, errp) ||
+            !visit_type_int64(v, "virtual-ns", &m->virtual_ns, errp)) {
+            visit_end_struct(v, NULL);
+            return false;
+        }
+        if (m->icount >= 0 &&
+            !visit_type_int64(v, "icount", &m->icount, errp)) {
+            visit_end_struct(v, NULL);
+            return false;
+        }
+        visit_end_struct(v, NULL);
+    }
+
+    visit_end_list(v, NULL);
+    return true;
+}
+
+static void apple_boot_timeline_write(Notifier *notifier, void *data)
+{
+    g_autoptr(GError) gerr = NULL;
+    g_autoptr(GString) json = NULL;
+    QObject *obj = NULL;
+    Visitor *v;
+
+    v = qobject_output_visitor_new(&obj);
+    if (apple_boot_timeline_visit(v, NULL, &error_warn)) {
+        visit_complete(v, &obj);
+    }
+    visit_free(v);
+
+    if (obj == NULL) {
+        return;
+    }
+
+    json = qobject_to_json_pretty(obj, true);
+    qobject_unref(obj);
+
+    if (!g_file_set_contents(timeline.output_filename, json->str, json->len,
+                             &gerr)) {
+        warn_report("Failed to write boot timeline to `%s`: %s",
+                    timeline.output_filename, gerr->message);
+    }
+}
+
+void apple_boot_timeline_enable(const char *output_filename)
+{
+    g_assert_false(timeline.enabled);
+
+    timeline.enabled = true;
+    timeline.milestones = g_array_new(false, false, sizeof(AppleBootMilestone));
+    g_array_set_clear_func(timeline.milestones, apple_boot_milestone_clear);
+    timeline.origin_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+
+    if (output_filename != NULL) {
+        timeline.scan_console = true;
+        timeline.output_filename = g_strdup(output_filename);
+        timeline.exit_notifier.notify = apple_boot_timeline_write;
+        qemu_add_exit_notifier(&timeline.exit_notifier);
+    }
+}
+
+void apple_boot_timeline_restart(void)
+{
+    if (!timeline.enabled) {
+        return;
+    }
+
+    g_array_set_size(timeline.milestones, 0);
+    timeline.origin_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    timeline.line_len = 0;
+}
@@ -21,11 +21,14 @@
  */
 
 #include "qemu/osdep.h"
+#include "exec/address-spaces.h"
 #include "hw/irq.h"
 #include "hw/misc/unimp.h"
 #include "hw/pci-host/apcie.h"
 #include "hw/pci/msi.h"
+#include "migration/vmstate.h"
 #include "qapi/error.h"
+#include "qemu/bitops.h"
 #include "qemu/log.h"
 // #include "hw/pci/msix.h"
 #include "hw/pci/pci_bridge.h"
@@ -54,12 +57,21 @@
 #define APPLE_PCIE_PHY_DEBUG_R1_XMLH_LINK_UP BIT(4)
 #define APPLE_PCIE_LINK_WIDTH_SPEED_CONTROL 0x80C
 #define APPLE_PCIE_PORT_LOGIC_SPEED_CHANGE BIT(17)
+#endif
 #define APPLE_PCIE_MSI_ADDR_LO 0x820
 #define APPLE_PCIE_MSI_ADDR_HI 0x824
 #define APPLE_PCIE_MSI_INTR0_ENABLE 0x828
 #define APPLE_PCIE_MSI_INTR0_MASK 0x82C
 #define APPLE_PCIE_MSI_INTR0_STATUS 0x830
-#endif
+#define APPLE_PCIE_MSI_INTR_BANK_SIZE 0xC
+#define APPLE_PCIE_MSI_INTR_END                 \
+    (APPLE_PCIE_MSI_INTR0_ENABLE +              \
+     APPLE_PCIE_NUM_MSI_BANKS * APPLE_PCIE_MSI_INTR_BANK_SIZE)
+
+// default vector count if the device tree has no #msi-vectors
+#define APPLE_PCIE_MSI_DEFAULT_VECTORS 32
+// vectors per root port: 0 for PME/hotplug, 1 for AER
+#define APPLE_PCIE_PORT_MSI_VECTORS 2
 
 static void apple_pcie_root_bus_class_init(ObjectClass *klass, void *data)
 {
@@ -73,9 +85,8 @@ static void apple_pcie_root_bus_class_init(ObjectClass *klass, void *data)
     k->max_dev = 1;
 }
 
-#if 0
 static uint64_t apple_pcie_root_msi_read(void *opaque, hwaddr addr,
-                                              unsigned size)
+                                         unsigned size)
 {
     /*
      * Attempts to read from the MSI address are undefined in
@@ -91,15 +102,45 @@ static uint64_t apple_pcie_root_msi_read(void *opaque, hwaddr addr,
     return 0;
 }
 
+static void apple_pcie_root_msi_update_bank(ApplePCIEHost *host, int bank)
+{
+    ApplePCIEMSIBank *intr = &host->msi.intr[bank];
+    uint32_t pending = intr->status & ~intr->mask;
+    int vector = bank * APPLE_PCIE_MSI_VECTORS_PER_BANK;
+    int i;
+
+    for (i = 0; i < APPLE_PCIE_MSI_VECTORS_PER_BANK &&
+                vector + i < host->msi.num_vectors;
+         i++) {
+        qemu_set_irq(host->msi.irqs[vector + i], (pending >> i) & 1);
+    }
+}
+
 static void apple_pcie_root_msi_write(void *opaque, hwaddr addr,
-                                           uint64_t data, unsigned size)
+                                      uint64_t data, unsigned size)
 {
     ApplePCIEHost *host = APPLE_PCIE_HOST(opaque);
+    ApplePCIEMSIBank *intr;
+    uint32_t vector = data;
+    uint32_t bit;
+
+    // the message data is the vector number
+    if (vector >= host->msi.num_vectors) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "%s: MSI vector %u out of range (%u vectors)\n",
+                      __func__, vector, host->msi.num_vectors);
+        return;
+    }
 
-    host->msi.intr[0].status |= BIT(data) & host->msi.intr[0].enable;
+    intr = &host->msi.intr[vector / APPLE_PCIE_MSI_VECTORS_PER_BANK];
+    bit = BIT(vector % APPLE_PCIE_MSI_VECTORS_PER_BANK);
+    if (!(intr->enable & bit)) {
+        return;
+    }
 
-    if (host->msi.intr[0].status & ~host->msi.intr[0].mask) {
-        qemu_set_irq(host->pci.msi, 1);
+    intr->status |= bit;
+    if (!(intr->mask & bit)) {
+        qemu_set_irq(host->msi.irqs[vector], 1);
     }
 }
 
@@ -114,16 +155,97 @@ static const MemoryRegionOps apple_pcie_host_msi_ops = {
 };
 
 static void apple_pcie_root_update_msi_mapping(ApplePCIEHost *host)
-
 {
-    MemoryRegion *mem   = &host->msi.iomem;
-    const uint64_t base = host->msi.base;
-    const bool enable   = host->msi.intr[0].enable;
+    MemoryRegion *mem = &host->msi.iomem;
+    bool enable = false;
+    int i;
+
+    for (i = 0; i < APPLE_PCIE_NUM_MSI_BANKS; i++) {
+        enable |= host->msi.intr[i].enable != 0;
+    }
 
-    memory_region_set_address(mem, base);
+    memory_region_set_address(mem, host->msi.base);
     memory_region_set_enabled(mem, enable);
 }
-#endif
+
+static bool apple_pcie_root_msi_reg_read(ApplePCIEHost *host, hwaddr addr,
+                                         uint32_t *val)
+{
+    ApplePCIEMSIBank *intr;
+
+    switch (addr) {
+    case APPLE_PCIE_MSI_ADDR_LO:
+        *val = extract64(host->msi.base, 0, 32);
+        return true;
+    case APPLE_PCIE_MSI_ADDR_HI:
+        *val = extract64(host->msi.base, 32, 32);
+        return true;
+    case APPLE_PCIE_MSI_INTR0_ENABLE ... APPLE_PCIE_MSI_INTR_END - 1:
+        intr = &host->msi.intr[(addr - APPLE_PCIE_MSI_INTR0_ENABLE) /
+                               APPLE_PCIE_MSI_INTR_BANK_SIZE];
+        switch ((addr - APPLE_PCIE_MSI_INTR0_ENABLE) %
+                APPLE_PCIE_MSI_INTR_BANK_SIZE) {
+        case APPLE_PCIE_MSI_INTR0_ENABLE - APPLE_PCIE_MSI_INTR0_ENABLE:
+            *val = intr->enable;
+            break;
+        case APPLE_PCIE_MSI_INTR0_MASK - APPLE_PCIE_MSI_INTR0_ENABLE:
+            *val = intr->mask;
+            break;
+        case APPLE_PCIE_MSI_INTR0_STATUS - APPLE_PCIE_MSI_INTR0_ENABLE:
+            *val = intr->status;
+            break;
+        default:
+            *val = 0;
+            break;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool apple_pcie_root_msi_reg_write(ApplePCIEHost *host, hwaddr addr,
+                                          uint32_t val)
+{
+    ApplePCIEMSIBank *intr;
+    int bank;
+
+    switch (addr) {
+    case APPLE_PCIE_MSI_ADDR_LO:
+        host->msi.base = deposit64(host->msi.base, 0, 32, val);
+        apple_pcie_root_update_msi_mapping(host);
+        return true;
+    case APPLE_PCIE_MSI_ADDR_HI:
+        host->msi.base = deposit64(host->msi.base, 32, 32, val);
+        apple_pcie_root_update_msi_mapping(host);
+        return true;
+    case APPLE_PCIE_MSI_INTR0_ENABLE ... APPLE_PCIE_MSI_INTR_END - 1:
+        bank = (addr - APPLE_PCIE_MSI_INTR0_ENABLE) /
+               APPLE_PCIE_MSI_INTR_BANK_SIZE;
+        intr = &host->msi.intr[bank];
+        switch ((addr - APPLE_PCIE_MSI_INTR0_ENABLE) %
+                APPLE_PCIE_MSI_INTR_BANK_SIZE) {
+        case APPLE_PCIE_MSI_INTR0_ENABLE - APPLE_PCIE_MSI_INTR0_ENABLE:
+            intr->enable = val;
+            intr->status &= val;
+            apple_pcie_root_update_msi_mapping(host);
+            break;
+        case APPLE_PCIE_MSI_INTR0_MASK - APPLE_PCIE_MSI_INTR0_ENABLE:
+            intr->mask = val;
+            break;
+        case APPLE_PCIE_MSI_INTR0_STATUS - APPLE_PCIE_MSI_INTR0_ENABLE:
+            // write 1 to clear
+            intr->status &= ~val;
+            break;
+        default:
+            break;
+        }
+        apple_pcie_root_msi_update_bank(host, bank);
+        return true;
+    default:
+        return false;
+    }
+}
 
 static void machine_set_gpio(int interrupt_num, int level)
 {
@@ -230,6 +352,9 @@ static uint64_t apple_pcie_root_common_read(void *opaque, hwaddr addr,
         val = 0x1;
         break;
     default:
+        if (apple_pcie_root_msi_reg_read(host, addr, &val)) {
+            break;
+        }
         // val = 0;
         val = host->root_common_regs[addr >> 2];
         break;
@@ -276,6 +401,9 @@ static void apple_pcie_root_common_write(void *opaque, hwaddr addr,
         }
         break;
     default:
+        if (apple_pcie_root_msi_reg_write(host, addr, data)) {
+            return;
+        }
         break;
     }
     host->root_common_regs[addr >> 2] = data;
@@ -659,6 +787,7 @@ static const char *apple_pcie_host_root_bus_path(PCIHostState *host_bridge,
 static void apple_pcie_host_reset(DeviceState *dev)
 {
     ApplePCIEHost *host = APPLE_PCIE_HOST(dev);
+    int i;
     // PCIDevice *pci_dev = PCI_DEVICE(dev);
     // uint8_t *pci_conf = pci_dev->config;
     // uint32_t config;
@@ -677,6 +806,13 @@ static void apple_pcie_host_reset(DeviceState *dev)
     host->root_refclk_buffer_enabled = 0x0;
     memset(host->root_common_regs, 0, sizeof(host->root_common_regs));
 
+    host->msi.base = 0;
+    memset(host->msi.intr, 0, sizeof(host->msi.intr));
+    for (i = 0; i < host->msi.num_vectors; i++) {
+        qemu_irq_lower(host->msi.irqs[i]);
+    }
+    apple_pcie_root_update_msi_mapping(host);
+
     // pci_set_long(pci_conf + PCI_PREF_LIMIT_UPPER32, 0x11);
     // pci_set_long(pci_conf + 0x12c, 0x11);
     // pci_set_byte(pci_conf + PCI_INTERRUPT_LINE, 0xff);
@@ -799,13 +935,20 @@ SysBusDevice *apple_pcie_create(DTBNode *node)
 
     const char *s800x_compatible_substring = "apcie,s800";
 
-    prop = dtb_find_prop(s->node, "compatible");
-    g_assert_nonnull(prop);
-
     for (i = 0; i < ARRAY_SIZE(host->irqs); i++) {
         sysbus_init_irq(sbd, &host->irqs[i]);
     }
-    sysbus_init_irq(sbd, &host->msi);
+
+    prop = dtb_find_prop(s->node, "#msi-vectors");
+    host->msi.num_vectors = prop == NULL ? APPLE_PCIE_MSI_DEFAULT_VECTORS :
+                                           *(uint32_t *)prop->data;
+    g_assert_cmpuint(host->msi.num_vectors, <=, APPLE_PCIE_MAX_MSI_VECTORS);
+    // one output per vector, the machine routes them to distinct AIC inputs
+    qdev_init_gpio_out_named(dev, host->msi.irqs, "msi",
+                             host->msi.num_vectors);
+
+    prop = dtb_find_prop(s->node, "compatible");
+    g_assert_nonnull(prop);
 
     uint64_t common_index, port_index, port_count, port_entries, root_mappings,
         port_mappings;
@@ -1124,9 +1267,9 @@ static int apple_pcie_port_interrupts_init(PCIDevice *d, Error **errp)
     ///IOH_EP_MSI_SUPPORTED_FLAGS & PCI_MSI_FLAGS_MASKBIT, errp);
     // rc = msi_init(d, 0, 1, true, false, errp);
     msi_nonbroken = true;
-    // offset 0x50, only 1 vector for the first bridge, 64-bit enabled,
-    // per-vector-mask disabled
-    rc = msi_init(d, 0x50, 1, true, false, errp);
+    // offset 0x50, PME/hotplug and AER vectors, 64-bit enabled,
+    // per-vector-mask enabled
+    rc = msi_init(d, 0x50, APPLE_PCIE_PORT_MSI_VECTORS, true, true, errp);
     if (rc < 0) {
         assert(rc == -ENOTSUP);
     }
@@ -1170,6 +1313,28 @@ static const Property apple_pcie_port_props[] = {
     DEFINE_PROP_UINT32("device_id", ApplePCIEPort, device_id, 0),
 };
 
+static const VMStateDescription vmstate_apple_pcie_port = {
+    .name = "apple-pcie-port",
+    .priority = MIG_PRI_PCI_BUS,
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .post_load = pcie_cap_slot_post_load,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_PCI_DEVICE(parent_obj.parent_obj.parent_obj.parent_obj,
+                               ApplePCIEPort),
+            VMSTATE_STRUCT(
+                parent_obj.parent_obj.parent_obj.parent_obj.exp.aer_log,
+                ApplePCIEPort, 0, vmstate_pcie_aer_log, PCIEAERLog),
+            VMSTATE_UINT32(port_last_interrupt, ApplePCIEPort),
+            VMSTATE_UINT32(port_cfg_port_config, ApplePCIEPort),
+            VMSTATE_UINT32(port_cfg_refclk_config, ApplePCIEPort),
+            VMSTATE_UINT32(port_cfg_rootport_perst, ApplePCIEPort),
+            VMSTATE_UINT32(port_refclk_buffer_enabled, ApplePCIEPort),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static void apple_pcie_port_class_init(ObjectClass *klass, void *data)
 {
     PCIDeviceClass *k = PCI_DEVICE_CLASS(klass);
@@ -1178,6 +1343,7 @@ static void apple_pcie_port_class_init(ObjectClass *klass, void *data)
     PCIERootPortClass *rpc = PCIE_ROOT_PORT_CLASS(klass);
 
     dc->desc = "Apple PCIE Root Port";
+    dc->vmsd = &vmstate_apple_pcie_port;
     k->vendor_id = PCI_VENDOR_ID_APPLE;
     // s8000: 0x1003 for the bridge ; + 1 if manual-enable property exists?
     // t8030: 0x1002?
@@ -1206,6 +1372,18 @@ static void apple_pcie_port_class_init(ObjectClass *klass, void *data)
     dc->hotpluggable = false;
 }
 
+static AddressSpace *apple_pcie_host_get_iommu_as(PCIBus *bus, void *opaque,
+                                                  int devfn)
+{
+    ApplePCIEHost *s = APPLE_PCIE_HOST(opaque);
+
+    return &s->dma_as;
+}
+
+static const PCIIOMMUOps apple_pcie_host_iommu_ops = {
+    .get_address_space = apple_pcie_host_get_iommu_as,
+};
+
 static void apple_pcie_host_realize(DeviceState *dev, Error **errp)
 {
     PCIHostState *pci = PCI_HOST_BRIDGE(dev);
@@ -1226,6 +1404,30 @@ static void apple_pcie_host_realize(DeviceState *dev, Error **errp)
     pci->bus = pci_register_root_bus(dev, "apcie", apple_pcie_set_irq,
                                      pci_swizzle_map_irq_fn, s, &s->mmio,
                                      &s->io, 0, 4, TYPE_APPLE_PCIE_ROOT_BUS);
+
+    /*
+     * Endpoint DMA, including MSI writes, goes through the bus master
+     * address space, so the doorbell has to live there rather than in
+     * the PCI memory window.
+     */
+    memory_region_init(&s->dma_root, OBJECT(s), "pcie-dma-root", UINT64_MAX);
+    memory_region_init_alias(&s->dma_sysmem, OBJECT(s), "pcie-dma-sysmem",
+                             get_system_memory(), 0, UINT64_MAX);
+    memory_region_add_subregion(&s->dma_root, 0, &s->dma_sysmem);
+
+    memory_region_init_io(&s->msi.iomem, OBJECT(s), &apple_pcie_host_msi_ops,
+                          s, "pcie-msi", 0x4);
+    /*
+     * We initially place MSI interrupt I/O region at address 0 and
+     * disable it. It'll be later moved to correct offset and enabled
+     * in apple_pcie_root_update_msi_mapping() as a part of
+     * initialization done by guest OS
+     */
+    memory_region_add_subregion_overlap(&s->dma_root, 0, &s->msi.iomem, 1);
+    memory_region_set_enabled(&s->msi.iomem, false);
+
+    address_space_init(&s->dma_as, &s->dma_root, "pcie-dma");
+    pci_setup_iommu(pci->bus, &apple_pcie_host_iommu_ops, s);
     // pci->bus->flags |= PCI_BUS_EXTENDED_CONFIG_SPACE;
 }
 
@@ -1238,6 +1440,52 @@ static const Property apple_pcie_root_props[] = {
 };
 #endif
 
+static int apple_pcie_host_post_load(void *opaque, int version_id)
+{
+    ApplePCIEHost *host = APPLE_PCIE_HOST(opaque);
+
+    /*
+     * Only the doorbell mapping is derived here. The MSI vector levels
+     * are already part of the migrated state of the interrupt controller.
+     */
+    apple_pcie_root_update_msi_mapping(host);
+
+    return 0;
+}
+
+static const VMStateDescription vmstate_apple_pcie_msi_bank = {
+    .name = "ApplePCIEMSIBank",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT32(enable, ApplePCIEMSIBank),
+            VMSTATE_UINT32(mask, ApplePCIEMSIBank),
+            VMSTATE_UINT32(status, ApplePCIEMSIBank),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
+static const VMStateDescription vmstate_apple_pcie_host = {
+    .name = "apple-pcie-host",
+    .version_id = 0,
+    .minimum_version_id = 0,
+    .post_load = apple_pcie_host_post_load,
+    .fields =
+        (const VMStateField[]){
+            VMSTATE_UINT32(root_phy_enabled, ApplePCIEHost),
+            VMSTATE_UINT32(root_refclk_buffer_enabled, ApplePCIEHost),
+            VMSTATE_UINT32_ARRAY(root_common_regs, ApplePCIEHost,
+                                 APCIE_COMMON_REGS_LENGTH / sizeof(uint32_t)),
+            VMSTATE_UINT64(msi.base, ApplePCIEHost),
+            VMSTATE_STRUCT_ARRAY(msi.intr, ApplePCIEHost,
+                                 APPLE_PCIE_NUM_MSI_BANKS, 0,
+                                 vmstate_apple_pcie_msi_bank,
+                                 ApplePCIEMSIBank),
+            VMSTATE_END_OF_LIST(),
+        },
+};
+
 static void apple_pcie_host_class_init(ObjectClass *klass, void *data)
 {
     PCIHostBridgeClass *hc = PCI_HOST_BRIDGE_CLASS(klass);
@@ -1248,6 +1496,7 @@ static void apple_pcie_host_class_init(ObjectClass *klass, void *data)
     hc->root_bus_path = apple_pcie_host_root_bus_path;
     dc->realize = apple_pcie_host_realize;
     device_class_set_legacy_reset(dc, apple_pcie_host_reset);
+    dc->vmsd = &vmstate_apple_pcie_host;
     // dc->fw_name = "pci";
 
     dc->user_creatable = false;
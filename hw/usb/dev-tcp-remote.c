@@ -19,6 +19,7 @@
 
 #include "qemu/osdep.h"
 #include "hw/qdev-properties.h"
+#include "exec/replay-core.h"
 #include "hw/usb.h"
 #include "migration/blocker.h"
 #include "qapi/error.h"
@@ -612,6 +613,8 @@ static void usb_tcp_remote_realize(USBDevice *dev, Error **errp)
                "%s does not support migration "
                "while connected",
                TYPE_USB_TCP_REMOTE);
+    /* Packets arrive from the host socket and are not recorded. */
+    replay_add_blocker(TYPE_USB_TCP_REMOTE);
     qemu_thread_create(&s->thread, TYPE_USB_TCP_REMOTE ".thread",
                        &usb_tcp_remote_thread, s, QEMU_THREAD_JOINABLE);
 }
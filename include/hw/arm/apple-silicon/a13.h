@@ -28,8 +28,11 @@
 #include "qemu/queue.h"
 #include "cpu.h"
 
-#define A13_MAX_CPU 6
-#define A13_MAX_CLUSTER 2
+// Bounded by the AIC, whose IPI CPU masks are 31 bits wide.
+#define A13_MAX_CPU 31
+#define A13_MAX_CLUSTER 8
+// The CPU count of version 1 cluster migration streams.
+#define A13_V1_MAX_CPU 6
 
 #define TYPE_APPLE_A13 "apple-a13-cpu"
 OBJECT_DECLARE_TYPE(AppleA13State, AppleA13Class, APPLE_A13)
@@ -99,7 +102,6 @@ typedef struct AppleA13State {
     A13_CPREG_VAR_DEF(PMSR);
     A13_CPREG_VAR_DEF(S3_4_c15_c0_5);
     A13_CPREG_VAR_DEF(AMX_STATUS_EL1);
-    A13_CPREG_VAR_DEF(AMX_CTL_EL1);
     A13_CPREG_VAR_DEF(ARM64_REG_CYC_OVRD);
     A13_CPREG_VAR_DEF(ARM64_REG_ACC_CFG);
     A13_CPREG_VAR_DEF(S3_5_c15_c10_1);
@@ -119,6 +121,9 @@ typedef struct AppleA13Cluster {
     AppleA13State *cpus[A13_MAX_CPU];
     uint32_t deferredIPI[A13_MAX_CPU][A13_MAX_CPU];
     uint32_t noWakeIPI[A13_MAX_CPU][A13_MAX_CPU];
+    // The part of the IPI matrices that version 1 streams carry.
+    uint32_t deferredIPI_v1[A13_V1_MAX_CPU][A13_V1_MAX_CPU];
+    uint32_t noWakeIPI_v1[A13_V1_MAX_CPU][A13_V1_MAX_CPU];
     uint64_t tick;
     uint64_t ipi_cr;
     QTAILQ_ENTRY(AppleA13Cluster) next;
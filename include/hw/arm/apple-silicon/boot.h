@@ -28,6 +28,7 @@
 #include "qemu/osdep.h"
 #include "exec/hwaddr.h"
 #include "hw/arm/apple-silicon/dtb.h"
+#include "qapi/qapi-builtin-types.h"
 
 #define BOOT_ARGS_REVISION_2 (2)
 #define BOOT_ARGS_VERSION_2 (2)
@@ -314,6 +315,9 @@ uint8_t *macho_get_buffer(MachoHeader64 *hdr);
 
 void macho_free(MachoHeader64 *hdr);
 
+/* Forget the name indexes of the headers in [start, end). */
+void macho_index_drop(const uint8_t *start, const uint8_t *end);
+
 uint32_t macho_build_version(MachoHeader64 *mh);
 
 uint32_t macho_platform(MachoHeader64 *mh);
@@ -336,6 +340,9 @@ MachoSegmentCommand64 *macho_get_segment(MachoHeader64 *header,
 
 MachoSection64 *macho_get_section(MachoSegmentCommand64 *seg, const char *name);
 
+MachoSection64 *macho_find_section(MachoHeader64 *header, const char *segname,
+                                   const char *sect_name);
+
 uint64_t xnu_slide_hdr_va(MachoHeader64 *header, uint64_t hdr_va);
 
 void *xnu_va_to_ptr(uint64_t va);
@@ -358,8 +365,23 @@ void macho_allocate_segment_records(DTBNode *memory_map, MachoHeader64 *mh);
 hwaddr arm_load_macho(MachoHeader64 *mh, AddressSpace *as, MemoryRegion *mem,
                       DTBNode *memory_map, hwaddr phys_base, hwaddr virt_slide);
 
-void macho_load_raw_file(const char *filename, AddressSpace *as,
-                         MemoryRegion *mem, hwaddr file_pa, uint64_t *size);
+void macho_set_image_cache_dir(const char *dir);
+
+/*
+ * Create the shared mapping for an image that macho_load_image() places on
+ * reset. Only valid at machine init, once the image cache directory is set.
+ */
+void macho_share_image(const char *name, const void *data, uint64_t size);
+
+/* The same for the read-only segments of a kernel that is loaded unslid. */
+void macho_share_segments(MachoHeader64 *mh);
+
+void macho_load_image(AddressSpace *as, MemoryRegion *mem, const char *name,
+                      hwaddr pa, const void *data, uint64_t size);
+
+void macho_load_raw_file(const char *filename, const char *name,
+                         AddressSpace *as, MemoryRegion *mem, hwaddr file_pa,
+                         uint64_t *size);
 
 DTBNode *load_dtb_from_file(const char *filename);
 
@@ -368,9 +390,40 @@ void macho_populate_dtb(DTBNode *root, AppleBootInfo *info);
 void macho_load_dtb(DTBNode *root, AddressSpace *as, MemoryRegion *mem,
                     AppleBootInfo *info);
 
-uint8_t *load_trustcache_from_file(const char *filename, uint64_t *size);
+/*
+ * Load a trust cache, followed by any extra ones, into the segment layout
+ * the kernel expects. Entries are sorted and deduplicated as needed.
+ */
+uint8_t *load_trustcache_from_file(const char *filename,
+                                   const strList *extra_filenames,
+                                   uint64_t *size);
+
+uint8_t *load_ramdisk_from_file(const char *filename, uint64_t *size);
 
 void macho_load_ramdisk(const char *filename, AddressSpace *as,
                         MemoryRegion *mem, hwaddr pa, uint64_t *size);
 
+typedef struct {
+    /* Inputs; images with a NULL filename are skipped. */
+    const char *kernel_filename;
+    const char *dtb_filename;
+    const char *trustcache_filename;
+    const strList *extra_trustcache_filenames;
+    const char *ramdisk_filename;
+    /* Outputs. */
+    MachoHeader64 *kernel;
+    DTBNode *device_tree;
+    uint8_t *trustcache;
+    uint64_t trustcache_size;
+    uint8_t *ramdisk;
+    uint64_t ramdisk_size;
+} AppleBootImages;
+
+/*
+ * Decode the boot images concurrently, one host thread per image, and
+ * return once all of them are done. The results are identical to calling
+ * the individual loaders one after another.
+ */
+void apple_boot_load_images(AppleBootImages *images);
+
 #endif /* HW_ARM_APPLE_SILICON_BOOT_H */
@@ -46,6 +46,26 @@ hwaddr ptov_bases(hwaddr pa, hwaddr phys_base, hwaddr virt_base);
 MemoryRegion *allocate_ram(MemoryRegion *top, const char *name, hwaddr addr,
                            hwaddr size, int priority);
 
+/// Zeroes `size` bytes at `addr`. Page aligned spans of anonymous RAM are
+/// discarded instead of written, so the host only faults in the pages the
+/// guest actually touches afterwards.
+void clear_ram(AddressSpace *as, hwaddr addr, hwaddr size);
+
+/// Creates the region a read-only boot image is shared through: a private
+/// mapping of a content-addressed file in `cache_dir`, so that instances
+/// loading the same image share its pages until they write to them.
+/// Must only be called at machine init, so that the RAM blocks that are
+/// migrated do not depend on what is loaded on reset.
+/// Returns false if the image can't be shared.
+bool allocate_shared_image(const char *name, const char *cache_dir,
+                           const void *data, hwaddr size);
+
+/// Maps the shared image `name` at `addr`, discarding any guest writes to it.
+/// Returns false if the image must be copied into RAM instead, which is also
+/// the case if `data` is no longer what it was created with.
+bool map_shared_image(MemoryRegion *top, const char *name, hwaddr addr,
+                      const void *data, hwaddr size);
+
 typedef struct CarveoutAllocator CarveoutAllocator;
 
 /// Creates a new carveout allocator
@@ -66,6 +66,7 @@ typedef struct {
     AppleBootInfo boot_info;
     AppleVideoArgs video_args;
     char *trustcache_filename;
+    strList *extra_trustcache_filenames;
     char *ticket_filename;
     char *seprom_filename;
     char *sep_fw_filename;
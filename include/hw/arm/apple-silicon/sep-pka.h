@@ -0,0 +1,46 @@
+/*
+ * Apple SEP PKA attestation.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_ARM_APPLE_SILICON_SEP_PKA_H
+#define HW_ARM_APPLE_SILICON_SEP_PKA_H
+
+/*
+ * Only the ECPUB attestation of the PKA block is computed, and data
+ * migration is only acknowledged. Its ECDH and ECDSA operations are not
+ * modelled at all: which command values select them and where their
+ * operands and results live is not known.
+ */
+
+#define APPLE_PKA_ECID_WORDS (5)
+#define APPLE_PKA_DIGEST_SIZE (32)
+#define APPLE_PKA_INPUT_SIZE (0x80)
+// Uncompressed P-256 point without the 0x04 prefix: X then Y, big endian.
+#define APPLE_PKA_PUBLIC_KEY_SIZE (64)
+
+/*
+ * Derive the per-device attestation key from the identity locked into the
+ * PKA block, and compute its public point along with the hash binding it
+ * to the image digest and the request data.
+ */
+void apple_pka_ecpub_attest(const uint32_t *ecid_chipid_misc,
+                            uint32_t chip_revision, const uint8_t *img4_dgst,
+                            const uint8_t *input, uint8_t *public_key,
+                            uint8_t *attest_hash);
+
+#endif /* HW_ARM_APPLE_SILICON_SEP_PKA_H */
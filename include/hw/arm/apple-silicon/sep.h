@@ -22,6 +22,7 @@
 #define HW_ARM_APPLE_SILICON_SEP_H
 
 #include "qemu/osdep.h"
+#include "crypto/cipher.h"
 #include "hw/arm/apple-silicon/dtb.h"
 #include "hw/i2c/i2c.h"
 #include "hw/misc/apple-silicon/a7iop/core.h"
@@ -48,7 +49,19 @@ DECLARE_INSTANCE_CHECKER(AppleSSCState, APPLE_SSC, TYPE_APPLE_SSC)
 #define SEP_DMA_MAPPING_SIZE (SEPFW_MAPPING_SIZE * 2)
 #define SEP_SHMBUF_BASE (SEPFW_MAPPING_SIZE + 0xC000)
 
+// Holds the cipher for the most recently used key, so that blocks which
+// keep reusing a key don't set up a new cipher for every operation.
 typedef struct {
+    QCryptoCipher *cipher;
+    QCryptoCipherAlgo alg;
+    QCryptoCipherMode mode;
+    uint8_t key[32];
+    size_t key_len;
+} AppleSEPCipherCache;
+
+typedef struct {
+    AppleSEPState *sep;
+    AppleSEPCipherCache cipher_cache;
     uint8_t key[32];
     uint8_t fifo[16];
     uint32_t offset_0x70;
@@ -60,6 +73,8 @@ typedef struct {
 } AppleTRNGState;
 
 typedef struct {
+    AppleSEPState *sep;
+    AppleSEPCipherCache cipher_cache;
     uint32_t chip_id;
     uint32_t status; // 0x4
     uint32_t command; // 0x8
@@ -105,6 +120,9 @@ typedef struct {
 } AppleAESSState;
 
 typedef struct {
+    AppleSEPState *sep;
+    QEMUTimer *timer;
+    uint32_t pending_command;
     uint32_t command; // 0x0
     uint32_t status0; // 0x4
     uint32_t status_in0; // 0x8
@@ -113,8 +131,8 @@ typedef struct {
     uint8_t output0[32]; // 0x60 ; read_cmd_0x2
     uint8_t input0[0x80]; // 0x80 ; write_cmd_0x0 ; SMRK_pub ; 1024 bits ;
                           // measurement==0x34_bytes
-    uint8_t public_key[32]; // 0x100 // for AESS ; read_cmd_0x0 ; read
-                            // public_key ; status_in0 needs to be 0x1
+    uint8_t public_key[64]; // 0x100 // for AESS ; read_cmd_0x0 ; read
+                            // public_key (X, Y) ; status_in0 needs to be 0x1
     uint8_t attest_hash[32]; // 0x180 ; read_cmd_0x3 ; read attest_hash ;
                              // status_in0 needs to be 0x1
     uint8_t input1[0x20a]; // 0x200 .. 0x40a (not inclusive) ; write_cmd_0x1 ;
@@ -125,6 +143,20 @@ typedef struct {
     uint32_t ecid_chipid_misc[5]; // 0x860
 } ApplePKAState;
 
+// One sample of the SEP trace ring, readable as `trace-ring`.
+typedef struct {
+    int64_t ns;
+    // SEP core PC, or 0 when the event did not originate from it.
+    uint64_t pc;
+    // Register offset, or the first word of a mailbox message.
+    uint64_t addr;
+    // Written value, or the second word of a mailbox message.
+    uint64_t value;
+    uint8_t kind;
+    uint8_t block;
+    uint8_t size;
+} AppleSEPTraceEntry;
+
 #define KBKDF_CMAC_OUTPUT_LEN 0x48
 #define AES_CCM_NONCE_LENGTH 12
 #define AES_CCM_AUTH_LENGTH 8
@@ -275,6 +307,10 @@ struct AppleSEPState {
     bool pmgr_fuse_changer_bit1_was_set;
     uint8_t key_fcfg_offset_0x14_index;
     uint16_t key_fcfg_offset_0x14_values[5];
+    uint32_t pka_latency_ns;
+    uint32_t trace_ring_size;
+    AppleSEPTraceEntry *trace_ring;
+    uint64_t trace_ring_count;
 };
 
 AppleSEPState *apple_sep_create(DTBNode *node, MemoryRegion *ool_mr, vaddr base,
@@ -56,18 +56,25 @@ typedef struct {
     unsigned long dram_size;
     AppleA13State *cpus[A13_MAX_CPU];
     AppleA13Cluster clusters[A13_MAX_CLUSTER];
+    uint32_t num_clusters;
+    uint32_t cluster_cores;
     SysBusDevice *aic;
     MemoryRegion *sys_mem;
     MemoryRegion *dram;
     MachoHeader64 *kernel;
     DTBNode *device_tree;
     uint8_t *trustcache;
+    uint8_t *ramdisk;
+    uint64_t ramdisk_size;
     AppleBootInfo boot_info;
     AppleVideoArgs video_args;
     char *trustcache_filename;
+    strList *extra_trustcache_filenames;
     char *ticket_filename;
     char *sep_rom_filename;
     char *sep_fw_filename;
+    char *image_cache_dir;
+    char *boot_timeline_filename;
     BootMode boot_mode;
     uint32_t rtkit_protocol_ver;
     uint32_t sio_protocol;
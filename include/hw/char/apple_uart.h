@@ -6,6 +6,6 @@
 #include "qom/object.h"
 #include "target/arm/cpu-qom.h"
 
-DeviceState *apple_uart_create(hwaddr addr, int fifo_size, int channel,
+DeviceState *apple_uart_create(hwaddr addr, int tx_fifo_size, int channel,
                                Chardev *chr, qemu_irq irq);
 #endif /* APPLE_UART_H */
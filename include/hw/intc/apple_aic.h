@@ -10,14 +10,18 @@ OBJECT_DECLARE_SIMPLE_TYPE(AppleAICState, APPLE_AIC)
 
 typedef struct AppleAICState AppleAICState;
 
+/*
+ * Everything touched on interrupt delivery and acknowledge comes first so
+ * it shares a cache line; the MMIO region is only needed at realize time.
+ */
 typedef struct {
     AppleAICState *aic;
     qemu_irq irq;
-    MemoryRegion iomem;
     uint32_t cpu_id;
     uint32_t pendingIPI;
     uint32_t deferredIPI;
     uint32_t ipi_mask;
+    MemoryRegion iomem;
 } AppleAICCPU;
 
 struct AppleAICState {
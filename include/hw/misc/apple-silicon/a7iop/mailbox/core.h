@@ -58,6 +58,10 @@ typedef struct {
 } QEMU_PACKED SetOOLMessage;
 
 
+typedef void AppleA7IOPMailboxObserver(void *opaque, AppleA7IOPMailbox *s,
+                                       const AppleA7IOPMessage *msg,
+                                       bool send);
+
 struct AppleA7IOPMailbox {
     /*< private >*/
     SysBusDevice parent_obj;
@@ -66,6 +70,9 @@ struct AppleA7IOPMailbox {
     QemuMutex lock;
     MemoryRegion mmio;
     QEMUBH *bh;
+    // Optional, called for every message entering or leaving the inbox.
+    AppleA7IOPMailboxObserver *observer;
+    void *observer_opaque;
     QTAILQ_HEAD(, AppleA7IOPMessage) inbox;
     QTAILQ_HEAD(, AppleA7IOPInterruptStatusMessage) interrupt_status;
     uint32_t count;
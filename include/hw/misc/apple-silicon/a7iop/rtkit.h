@@ -59,6 +59,8 @@ typedef union {
     };
 } AppleRTKitManagementMessage;
 
+#define RTKIT_EP_COUNT (256)
+
 typedef void AppleRTKitEPHandler(void *opaque, uint32_t ep, uint64_t msg);
 
 typedef struct {
@@ -67,18 +69,30 @@ typedef struct {
     bool user;
 } AppleRTKitEPData;
 
-typedef struct {
-    AppleRTKit *s;
-    uint32_t mask;
-    uint32_t last_block;
-} AppleRTKitRollcallData;
-
 typedef struct {
     void (*start)(void *opaque);
     void (*wakeup)(void *opaque);
     void (*boot_done)(void *opaque);
 } AppleRTKitOps;
 
+typedef enum {
+    RTKIT_PSTATE_OFF = 0,
+    RTKIT_PSTATE_ON,
+    RTKIT_PSTATE_PWRGATE,
+    RTKIT_PSTATE_SLEEP,
+    RTKIT_PSTATE_COUNT,
+} AppleRTKitPState;
+
+/* Host side statistics of the emulated IOP, readable as `ioreport`. */
+typedef struct {
+    uint64_t rx[256];
+    uint64_t tx[256];
+    AppleRTKitPState pstate;
+    int64_t pstate_entered_ns;
+    int64_t residency_ns[RTKIT_PSTATE_COUNT];
+    uint64_t transitions;
+} AppleRTKitIOReport;
+
 struct AppleRTKitClass {
     /*< private >*/
     SysBusDevice base_class;
@@ -97,8 +111,11 @@ struct AppleRTKit {
     void *opaque;
     uint8_t ep0_status;
     uint32_t protocol_version;
-    GTree *endpoints;
+    AppleRTKitEPData endpoints[RTKIT_EP_COUNT];
+    /* One bit per registered endpoint, one word per rollcall block. */
+    uint32_t ep_mask[RTKIT_EP_COUNT / 32];
     QTAILQ_HEAD(, AppleA7IOPMessage) rollcall;
+    AppleRTKitIOReport ioreport;
 };
 
 void apple_rtkit_send_control_msg(AppleRTKit *s, uint32_t ep, uint64_t data);
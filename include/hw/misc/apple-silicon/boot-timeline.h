@@ -0,0 +1,44 @@
+/*
+ * Apple SoC boot phase timeline.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_MISC_APPLE_SILICON_BOOT_TIMELINE_H
+#define HW_MISC_APPLE_SILICON_BOOT_TIMELINE_H
+
+#include "qapi/visitor.h"
+
+/*
+ * Milestones are recorded once per boot, the first time they are reached.
+ * Devices may report them unconditionally; nothing is recorded unless the
+ * machine has enabled the timeline. Must be called with the BQL held.
+ */
+void apple_boot_timeline_enable(const char *output_filename);
+void apple_boot_timeline_restart(void);
+void apple_boot_milestone(const char *name);
+void G_GNUC_PRINTF(1, 2) apple_boot_milestone_fmt(const char *fmt, ...);
+
+/*
+ * Feed kernel console output to the pattern based milestone detection.
+ * Only done when the timeline is written to a file, as it scans every line.
+ */
+void apple_boot_timeline_console_putc(uint8_t ch);
+
+/* Visit the recorded timeline as a list of milestone structs. */
+bool apple_boot_timeline_visit(Visitor *v, const char *name, Error **errp);
+
+#endif /* HW_MISC_APPLE_SILICON_BOOT_TIMELINE_H */
@@ -51,22 +51,24 @@ struct ApplePCIERootBus {
     PCIBus parent;
 };
 
-#if 0
 typedef struct ApplePCIEMSIBank {
     uint32_t enable;
     uint32_t mask;
     uint32_t status;
 } ApplePCIEMSIBank;
 
+#define APPLE_PCIE_MSI_VECTORS_PER_BANK 32
+#define APPLE_PCIE_MAX_MSI_VECTORS 256
+#define APPLE_PCIE_NUM_MSI_BANKS \
+    (APPLE_PCIE_MAX_MSI_VECTORS / APPLE_PCIE_MSI_VECTORS_PER_BANK)
+
 typedef struct ApplePCIEMSI {
-    uint64_t     base;
+    uint64_t base;
     MemoryRegion iomem;
-
-#define APPLE_PCIE_NUM_MSI_BANKS 1
-
+    uint32_t num_vectors;
+    qemu_irq irqs[APPLE_PCIE_MAX_MSI_VECTORS];
     ApplePCIEMSIBank intr[APPLE_PCIE_NUM_MSI_BANKS];
 } ApplePCIEMSI;
-#endif
 
 struct ApplePCIEHost {
     PCIExpressHost parent_obj;
@@ -77,11 +79,13 @@ struct ApplePCIEHost {
 #endif
     MemoryRegion mmio, io;
     qemu_irq irqs[4];
-    qemu_irq msi;
 
-#if 0
+    // bus master view: system memory with the MSI doorbell on top
+    MemoryRegion dma_root;
+    MemoryRegion dma_sysmem;
+    AddressSpace dma_as;
+
     ApplePCIEMSI msi;
-#endif
     // uint32_t clkreq_gpio_id;
     // uint32_t clkreq_gpio_value;
 
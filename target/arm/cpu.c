@@ -2361,6 +2361,14 @@ static void arm_cpu_realizefn(DeviceState *dev, Error **errp)
         unset_feature(env, ARM_FEATURE_EL2);
     }
 
+    if (arm_feature(env, ARM_FEATURE_GXF) &&
+        arm_feature(env, ARM_FEATURE_EL3)) {
+        /* The GXF guarded mode MMU indexes reuse the EL3 TLBs. */
+        error_setg(errp, "GXF is not supported together with EL3; "
+                   "set has_el3=false");
+        return;
+    }
+
     if (!cpu->has_pmu) {
         unset_feature(env, ARM_FEATURE_PMU);
     }
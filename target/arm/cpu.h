@@ -642,6 +642,15 @@ typedef struct CPUArchState {
         uint64_t mprr_el_br_el1[4][2];
     } sprr;
 
+    /* Apple AMX coprocessor, see amx_helper.c */
+    struct {
+        uint64_t x[8][8];
+        uint64_t y[8][8];
+        uint64_t z[64][8];
+        uint64_t ctl;
+        bool active;
+    } amx;
+
     struct {
         /* M profile has up to 4 stack pointers:
          * a Main Stack Pointer and a Process Stack Pointer for each
@@ -2557,6 +2566,7 @@ enum arm_features {
      */
     ARM_FEATURE_BACKCOMPAT_CNTFRQ, /* 62.5MHz timer default */
     ARM_FEATURE_GXF, /* has Apple's GXF support */
+    ARM_FEATURE_AMX, /* has Apple's AMX coprocessor */
 };
 
 static inline int arm_feature(CPUARMState *env, int feature)
@@ -2903,6 +2913,7 @@ bool write_cpustate_to_list(ARMCPU *cpu, bool kvm_sync);
 #define ARM_MMU_IDX_A     0x10  /* A profile */
 #define ARM_MMU_IDX_NOTLB 0x20  /* does not have a TLB */
 #define ARM_MMU_IDX_M     0x40  /* M profile */
+#define ARM_MMU_IDX_GXF   0x80  /* Apple GXF guarded mode */
 
 /* Meanings of the bits for M profile mmu idx values */
 #define ARM_MMU_IDX_M_PRIV   0x1
@@ -2943,6 +2954,14 @@ typedef enum ARMMMUIdx {
     ARMMMUIdx_Phys_Root  = 14 | ARM_MMU_IDX_A,
     ARMMMUIdx_Phys_Realm = 15 | ARM_MMU_IDX_A,
 
+    /*
+     * Apple GXF guarded EL1&0 regime (GL1). These get TLBs of their own so
+     * that GENTER and GEXIT do not have to flush the EL1 translations.
+     * CPUs with GXF have no EL3, so they reuse the EL3 core indexes.
+     */
+    ARMMMUIdx_GE10_1     = ARMMMUIdx_E3 | ARM_MMU_IDX_GXF,
+    ARMMMUIdx_GE10_1_PAN = ARMMMUIdx_E30_3_PAN | ARM_MMU_IDX_GXF,
+
     /*
      * These are not allocated TLBs and are used only for AT system
      * instructions or for the first stage of an S12 page table walk.
@@ -2984,6 +3003,8 @@ typedef enum ARMMMUIdxBit {
     TO_CORE_BIT(E30_3_PAN),
     TO_CORE_BIT(Stage2),
     TO_CORE_BIT(Stage2_S),
+    TO_CORE_BIT(GE10_1),
+    TO_CORE_BIT(GE10_1_PAN),
 
     TO_CORE_BIT(MUser),
     TO_CORE_BIT(MPriv),
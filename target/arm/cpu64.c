@@ -775,7 +775,13 @@ static void aarch64_max_initfn(Object *obj)
 static void aarch64_apple_gxf_initfn(Object *obj) {
     aarch64_max_initfn(obj);
     if (tcg_enabled()) {
+        /*
+         * The guarded MMU indexes reuse the EL3 TLBs, so drop EL3 before
+         * post_init adds has_el3; realize then clears the EL3 ID fields.
+         */
+        unset_feature(&ARM_CPU(obj)->env, ARM_FEATURE_EL3);
         set_feature(&ARM_CPU(obj)->env, ARM_FEATURE_GXF);
+        set_feature(&ARM_CPU(obj)->env, ARM_FEATURE_AMX);
     }
 }
 
@@ -419,7 +419,8 @@ int alle1_tlbmask(CPUARMState *env)
             ARMMMUIdxBit_E10_1_PAN |
             ARMMMUIdxBit_E10_0 |
             ARMMMUIdxBit_Stage2 |
-            ARMMMUIdxBit_Stage2_S);
+            ARMMMUIdxBit_Stage2_S |
+            gxf_tlbmask(env));
 }
 
 static const ARMCPRegInfo cp_reginfo[] = {
@@ -3599,7 +3600,9 @@ static uint64_t do_ats_write(CPUARMState *env, uint64_t value,
         if (arm_feature(env, ARM_FEATURE_EL2)) {
             if (mmu_idx == ARMMMUIdx_E10_0 ||
                 mmu_idx == ARMMMUIdx_E10_1 ||
-                mmu_idx == ARMMMUIdx_E10_1_PAN) {
+                mmu_idx == ARMMMUIdx_E10_1_PAN ||
+                mmu_idx == ARMMMUIdx_GE10_1 ||
+                mmu_idx == ARMMMUIdx_GE10_1_PAN) {
                 format64 |= env->cp15.hcr_el2 & (HCR_VM | HCR_DC);
             } else {
                 format64 |= arm_current_el(env) == 2;
@@ -11473,6 +11476,8 @@ int arm_mmu_idx_to_el(ARMMMUIdx mmu_idx)
         return 0;
     case ARMMMUIdx_E10_1:
     case ARMMMUIdx_E10_1_PAN:
+    case ARMMMUIdx_GE10_1:
+    case ARMMMUIdx_GE10_1_PAN:
         return 1;
     case ARMMMUIdx_E2:
     case ARMMMUIdx_E20_2:
@@ -11516,7 +11521,13 @@ ARMMMUIdx arm_mmu_idx_el(CPUARMState *env, int el)
         }
         break;
     case 1:
-        if (arm_pan_enabled(env)) {
+        if (arm_is_guarded(env)) {
+            if (arm_pan_enabled(env)) {
+                idx = ARMMMUIdx_GE10_1_PAN;
+            } else {
+                idx = ARMMMUIdx_GE10_1;
+            }
+        } else if (arm_pan_enabled(env)) {
             idx = ARMMMUIdx_E10_1_PAN;
         } else {
             idx = ARMMMUIdx_E10_1;
@@ -976,21 +976,28 @@ static inline int arm_to_core_mmu_idx(ARMMMUIdx mmu_idx)
     return mmu_idx & ARM_MMU_IDX_COREIDX_MASK;
 }
 
+static inline ARMMMUIdx core_to_aa64_mmu_idx(CPUARMState *env, int mmu_idx)
+{
+    /* AArch64 is always a-profile. */
+    ARMMMUIdx idx = mmu_idx | ARM_MMU_IDX_A;
+
+    /* The guarded mode indexes share their core index with EL3. */
+    if (arm_feature(env, ARM_FEATURE_GXF) &&
+        (idx == ARMMMUIdx_E3 || idx == ARMMMUIdx_E30_3_PAN)) {
+        idx |= ARM_MMU_IDX_GXF;
+    }
+    return idx;
+}
+
 static inline ARMMMUIdx core_to_arm_mmu_idx(CPUARMState *env, int mmu_idx)
 {
     if (arm_feature(env, ARM_FEATURE_M)) {
         return mmu_idx | ARM_MMU_IDX_M;
     } else {
-        return mmu_idx | ARM_MMU_IDX_A;
+        return core_to_aa64_mmu_idx(env, mmu_idx);
     }
 }
 
-static inline ARMMMUIdx core_to_aa64_mmu_idx(int mmu_idx)
-{
-    /* AArch64 is always a-profile. */
-    return mmu_idx | ARM_MMU_IDX_A;
-}
-
 int arm_mmu_idx_to_el(ARMMMUIdx mmu_idx);
 
 /* Return the MMU index for a v7M CPU in the specified security state */
@@ -1054,6 +1061,8 @@ static inline bool regime_has_2_ranges(ARMMMUIdx mmu_idx)
     case ARMMMUIdx_E10_0:
     case ARMMMUIdx_E10_1:
     case ARMMMUIdx_E10_1_PAN:
+    case ARMMMUIdx_GE10_1:
+    case ARMMMUIdx_GE10_1_PAN:
     case ARMMMUIdx_E20_0:
     case ARMMMUIdx_E20_2:
     case ARMMMUIdx_E20_2_PAN:
@@ -1068,6 +1077,7 @@ static inline bool regime_is_pan(CPUARMState *env, ARMMMUIdx mmu_idx)
     switch (mmu_idx) {
     case ARMMMUIdx_Stage1_E1_PAN:
     case ARMMMUIdx_E10_1_PAN:
+    case ARMMMUIdx_GE10_1_PAN:
     case ARMMMUIdx_E20_2_PAN:
     case ARMMMUIdx_E30_3_PAN:
         return true;
@@ -1076,6 +1086,22 @@ static inline bool regime_is_pan(CPUARMState *env, ARMMMUIdx mmu_idx)
     }
 }
 
+/* Return true if this regime translates for GXF guarded mode */
+static inline bool regime_is_guarded(CPUARMState *env, ARMMMUIdx mmu_idx)
+{
+    switch (mmu_idx) {
+    case ARMMMUIdx_GE10_1:
+    case ARMMMUIdx_GE10_1_PAN:
+        return true;
+    case ARMMMUIdx_Stage1_E1:
+    case ARMMMUIdx_Stage1_E1_PAN:
+        /* AT instructions translate for the current GXF state. */
+        return arm_is_guarded(env);
+    default:
+        return false;
+    }
+}
+
 static inline bool regime_is_stage2(ARMMMUIdx mmu_idx)
 {
     return mmu_idx == ARMMMUIdx_Stage2 || mmu_idx == ARMMMUIdx_Stage2_S;
@@ -1102,6 +1128,8 @@ static inline uint32_t regime_el(CPUARMState *env, ARMMMUIdx mmu_idx)
     case ARMMMUIdx_Stage1_E1_PAN:
     case ARMMMUIdx_E10_1:
     case ARMMMUIdx_E10_1_PAN:
+    case ARMMMUIdx_GE10_1:
+    case ARMMMUIdx_GE10_1_PAN:
     case ARMMMUIdx_MPrivNegPri:
     case ARMMMUIdx_MUserNegPri:
     case ARMMMUIdx_MPriv:
@@ -1992,6 +2020,15 @@ uint64_t gt_direct_access_timer_offset(CPUARMState *env, int timeridx);
  */
 int alle1_tlbmask(CPUARMState *env);
 
+/* Return the TLBs holding GXF guarded EL1&0 translations, if any */
+static inline int gxf_tlbmask(CPUARMState *env)
+{
+    if (!arm_feature(env, ARM_FEATURE_GXF)) {
+        return 0;
+    }
+    return ARMMMUIdxBit_GE10_1 | ARMMMUIdxBit_GE10_1_PAN;
+}
+
 /* Set the float_status behaviour to match the Arm defaults */
 void arm_set_default_fp_behaviours(float_status *s);
 /* Set the float_status behaviour to match Arm FPCR.AH=1 behaviour */
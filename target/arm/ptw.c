@@ -150,6 +150,10 @@ ARMMMUIdx stage_1_mmu_idx(ARMMMUIdx mmu_idx)
         return ARMMMUIdx_Stage1_E1;
     case ARMMMUIdx_E10_1_PAN:
         return ARMMMUIdx_Stage1_E1_PAN;
+    case ARMMMUIdx_GE10_1:
+        return ARMMMUIdx_Stage1_E1;
+    case ARMMMUIdx_GE10_1_PAN:
+        return ARMMMUIdx_Stage1_E1_PAN;
     default:
         return mmu_idx;
     }
@@ -259,6 +263,8 @@ static bool regime_translation_disabled(CPUARMState *env, ARMMMUIdx mmu_idx,
     case ARMMMUIdx_E10_0:
     case ARMMMUIdx_E10_1:
     case ARMMMUIdx_E10_1_PAN:
+    case ARMMMUIdx_GE10_1:
+    case ARMMMUIdx_GE10_1_PAN:
         /* TGE means that EL0/1 act as if SCTLR_EL1.M is zero */
         hcr_el2 = arm_hcr_el2_eff_secstate(env, space);
         if (hcr_el2 & HCR_TGE) {
@@ -1050,14 +1056,16 @@ pte_to_sprr_prot_is_guarded(CPUARMState *env, int ap, int xn, int pxn, bool guar
  * R/W/X protection flags.
  *
  * @env:     CPUARMState
+ * @mmu_idx: MMU index indicating required translation regime
  * @ap:      The 2-bit simple AP (AP[2:1])
  * @xn:      XN (execute-never) bits
  * @pxn:     PXN (privileged-execute-never) bits
  */
 static inline int
-pte_to_sprr_prot(CPUARMState *env, int ap, int xn, int pxn)
+pte_to_sprr_prot(CPUARMState *env, ARMMMUIdx mmu_idx, int ap, int xn, int pxn)
 {
-    return pte_to_sprr_prot_is_guarded(env, ap, xn, pxn, arm_is_guarded(env));
+    return pte_to_sprr_prot_is_guarded(env, ap, xn, pxn,
+                                       regime_is_guarded(env, mmu_idx));
 }
 
 static bool get_phys_addr_v5(CPUARMState *env, S1Translate *ptw,
@@ -2154,8 +2162,10 @@ static bool get_phys_addr_lpae(CPUARMState *env, S1Translate *ptw,
 
         user_rw = simple_ap_to_rw_prot_is_user(ap, true);
         if (arm_is_sprr_enabled(env)) {
-            prot_rw = pte_to_sprr_prot(env, ap, xn, pxn) & (PAGE_READ | PAGE_WRITE);
-            xn = pxn = !(pte_to_sprr_prot(env, ap, xn, pxn) & PAGE_EXEC);
+            prot_rw = pte_to_sprr_prot(env, mmu_idx, ap, xn, pxn) &
+                      (PAGE_READ | PAGE_WRITE);
+            xn = pxn = !(pte_to_sprr_prot(env, mmu_idx, ap, xn, pxn) &
+                         PAGE_EXEC);
         } else {
             prot_rw = simple_ap_to_rw_prot_is_user(ap, false);
         }
@@ -2168,7 +2178,8 @@ static bool get_phys_addr_lpae(CPUARMState *env, S1Translate *ptw,
                                     xn, pxn, result->f.attrs.space, out_space);
 
         if (access_type == MMU_INST_FETCH) {
-            if (arm_is_sprr_enabled(env) && !arm_is_guarded(env)) {
+            if (arm_is_sprr_enabled(env) &&
+                !regime_is_guarded(env, mmu_idx)) {
                 if (!(result->f.prot & (1 << access_type))) {
                     int gl_prot = pte_to_sprr_prot_is_guarded(env, ap, xn,
                                                                  pxn, true);
@@ -3535,6 +3546,12 @@ static bool get_phys_addr_nogpc(CPUARMState *env, S1Translate *ptw,
     case ARMMMUIdx_E10_1:
         s1_mmu_idx = ARMMMUIdx_Stage1_E1;
         goto do_twostage;
+    case ARMMMUIdx_GE10_1:
+        s1_mmu_idx = ARMMMUIdx_Stage1_E1;
+        goto do_twostage;
+    case ARMMMUIdx_GE10_1_PAN:
+        s1_mmu_idx = ARMMMUIdx_Stage1_E1_PAN;
+        goto do_twostage;
     case ARMMMUIdx_E10_1_PAN:
         s1_mmu_idx = ARMMMUIdx_Stage1_E1_PAN;
     do_twostage:
@@ -3665,6 +3682,8 @@ bool get_phys_addr(CPUARMState *env, vaddr address,
     case ARMMMUIdx_E10_0:
     case ARMMMUIdx_E10_1:
     case ARMMMUIdx_E10_1_PAN:
+    case ARMMMUIdx_GE10_1:
+    case ARMMMUIdx_GE10_1_PAN:
     case ARMMMUIdx_E20_0:
     case ARMMMUIdx_E20_2:
     case ARMMMUIdx_E20_2_PAN:
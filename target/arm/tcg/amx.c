@@ -0,0 +1,162 @@
+/*
+ * Apple AMX matrix coprocessor, register file operations
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "fpu/softfloat.h"
+#include "amx_internal.h"
+
+/*
+ * The same host-endian fixups as vec_internal.h, which cannot be used
+ * here as it needs cpu.h.
+ */
+#if HOST_BIG_ENDIAN
+#define AMX_H1(x) ((x) ^ 7)
+#define AMX_H2(x) ((x) ^ 3)
+#define AMX_H4(x) ((x) ^ 1)
+#else
+#define AMX_H1(x) (x)
+#define AMX_H2(x) (x)
+#define AMX_H4(x) (x)
+#endif
+#define AMX_H8(x) (x)
+
+void amx_gather(const uint64_t *file, unsigned int offset, uint64_t *out)
+{
+    const uint8_t *src = (const uint8_t *)file;
+    uint8_t *dst = (uint8_t *)out;
+    int i;
+
+    if ((offset & 7) == 0) {
+        for (i = 0; i < AMX_REG_WORDS; i++) {
+            out[i] = file[((offset >> 3) + i) % AMX_FILE_WORDS];
+        }
+        return;
+    }
+
+    for (i = 0; i < AMX_REG_SIZE; i++) {
+        dst[AMX_H1(i)] = src[AMX_H1((offset + i) % (AMX_FILE_WORDS * 8))];
+    }
+}
+
+void amx_scatter(uint64_t *file, unsigned int offset, const uint64_t *in)
+{
+    const uint8_t *src = (const uint8_t *)in;
+    uint8_t *dst = (uint8_t *)file;
+    int i;
+
+    if ((offset & 7) == 0) {
+        for (i = 0; i < AMX_REG_WORDS; i++) {
+            file[((offset >> 3) + i) % AMX_FILE_WORDS] = in[i];
+        }
+        return;
+    }
+
+    for (i = 0; i < AMX_REG_SIZE; i++) {
+        dst[AMX_H1((offset + i) % (AMX_FILE_WORDS * 8))] = src[AMX_H1(i)];
+    }
+}
+
+void amx_interleave_z(uint64_t (*z)[AMX_REG_WORDS], uint64_t operand,
+                      uint64_t *buf, bool store)
+{
+    unsigned int half = extract64(operand, 56, 1);
+    unsigned int row = extract64(operand, 57, 5) * 2;
+    uint32_t *lanes = (uint32_t *)buf;
+    uint32_t *zr;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        zr = (uint32_t *)z[row + (i & 1)];
+        if (store) {
+            lanes[AMX_H4(i)] = zr[AMX_H4(half * 8 + i / 2)];
+        } else {
+            zr[AMX_H4(half * 8 + i / 2)] = lanes[AMX_H4(i)];
+        }
+    }
+}
+
+bool amx_extr(uint64_t *file, uint64_t (*z)[AMX_REG_WORDS],
+              unsigned int offset, uint64_t operand)
+{
+    if (AMX_OPERAND_EXTR_MODE(operand)) {
+        return false;
+    }
+    amx_scatter(file, offset, z[AMX_OPERAND_ZROW(operand)]);
+    return true;
+}
+
+/*
+ * In matrix mode the outer product of X and Y is accumulated into an
+ * interleaved set of Z rows: Y lane j goes to row j * stride + zrow.
+ * In vector mode X and Y are multiplied lane by lane into a single row.
+ */
+#define DO_AMX_FMA(NAME, TYPE, H, LANES, ZERO, ONE, MULADD)                 \
+void NAME(const uint64_t *xfile, const uint64_t *yfile,                     \
+          uint64_t (*zfile)[AMX_REG_WORDS], uint64_t operand, int flags,    \
+          float_status *fpst)                                               \
+{                                                                           \
+    const int stride = 64 / (LANES);                                        \
+    uint64_t xbuf[AMX_REG_WORDS], ybuf[AMX_REG_WORDS];                      \
+    TYPE *x = (TYPE *)xbuf, *y = (TYPE *)ybuf, *z;                          \
+    unsigned int zrow = AMX_OPERAND_ZROW(operand);                          \
+    bool skip_z = AMX_OPERAND_SKIP_Z(operand);                              \
+    int i, j;                                                               \
+                                                                            \
+    amx_gather(xfile, AMX_OPERAND_XOFF(operand), xbuf);                     \
+    amx_gather(yfile, AMX_OPERAND_YOFF(operand), ybuf);                     \
+    for (i = 0; i < (LANES); i++) {                                         \
+        if (AMX_OPERAND_SKIP_X(operand)) {                                  \
+            x[i] = (ONE);                                                   \
+        }                                                                   \
+        if (AMX_OPERAND_SKIP_Y(operand)) {                                  \
+            y[i] = (ONE);                                                   \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    if (AMX_OPERAND_VECTOR(operand)) {                                      \
+        z = (TYPE *)zfile[zrow];                                            \
+        for (i = 0; i < (LANES); i++) {                                     \
+            TYPE acc = skip_z ? (ZERO) : z[H(i)];                           \
+            z[H(i)] = MULADD(x[H(i)], y[H(i)], acc, flags, fpst);           \
+        }                                                                   \
+        return;                                                             \
+    }                                                                       \
+                                                                            \
+    for (j = 0; j < (LANES); j++) {                                         \
+        TYPE yj = y[H(j)];                                                  \
+        z = (TYPE *)zfile[j * stride + zrow % stride];                      \
+        for (i = 0; i < (LANES); i++) {                                     \
+            TYPE acc = skip_z ? (ZERO) : z[H(i)];                           \
+            z[H(i)] = MULADD(x[H(i)], yj, acc, flags, fpst);                \
+        }                                                                   \
+    }                                                                       \
+}
+
+#define amx_mac16_op(a, b, c, flags, fpst) ((int16_t)((c) + (a) * (b)))
+
+DO_AMX_FMA(amx_fma64, float64, AMX_H8, 8, float64_zero, float64_one,
+           float64_muladd)
+DO_AMX_FMA(amx_fma32, float32, AMX_H4, 16, float32_zero, float32_one,
+           float32_muladd)
+DO_AMX_FMA(amx_fma16, float16, AMX_H2, 32, float16_zero, float16_one,
+           float16_muladd)
+DO_AMX_FMA(amx_mac16, int16_t, AMX_H2, 32, 0, 1, amx_mac16_op)
+
+#undef DO_AMX_FMA
+#undef amx_mac16_op
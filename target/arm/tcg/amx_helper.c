@@ -0,0 +1,236 @@
+/*
+ * Apple AMX matrix coprocessor
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "cpu.h"
+#include "internals.h"
+#include "exec/exec-all.h"
+#include "exec/cpu_ldst.h"
+#include "exec/helper-proto.h"
+#include "fpu/softfloat.h"
+#include "amx_internal.h"
+
+/*
+ * Memory access, exceptions and the enable state live here; the register
+ * file operations are in amx.c.
+ */
+
+#define AMX_CTL_EN BIT_ULL(63)
+
+enum {
+    AMX_OP_LDX = 0,
+    AMX_OP_LDY = 1,
+    AMX_OP_STX = 2,
+    AMX_OP_STY = 3,
+    AMX_OP_LDZ = 4,
+    AMX_OP_STZ = 5,
+    AMX_OP_LDZI = 6,
+    AMX_OP_STZI = 7,
+    AMX_OP_EXTRX = 8,
+    AMX_OP_EXTRY = 9,
+    AMX_OP_FMA64 = 10,
+    AMX_OP_FMS64 = 11,
+    AMX_OP_FMA32 = 12,
+    AMX_OP_FMS32 = 13,
+    AMX_OP_MAC16 = 14,
+    AMX_OP_FMA16 = 15,
+    AMX_OP_FMS16 = 16,
+    AMX_OP_SETCLR = 17,
+};
+
+static G_NORETURN void amx_undef(CPUARMState *env, uintptr_t ra)
+{
+    raise_exception_ra(env, EXCP_UDEF, syn_uncategorized(),
+                       exception_target_el(env), ra);
+}
+
+static void amx_load(CPUARMState *env, uint64_t addr, uint64_t *dst,
+                     uintptr_t ra)
+{
+    uint64_t buf[AMX_REG_WORDS];
+    int i;
+
+    /* Fault before touching the register file. */
+    for (i = 0; i < AMX_REG_WORDS; i++) {
+        buf[i] = cpu_ldq_le_data_ra(env, addr + i * 8, ra);
+    }
+    memcpy(dst, buf, sizeof(buf));
+}
+
+static void amx_store(CPUARMState *env, uint64_t addr, const uint64_t *src,
+                      uintptr_t ra)
+{
+    int i;
+
+    /* Fault before storing anything if the row crosses into a bad page. */
+    if ((addr & TARGET_PAGE_MASK) !=
+        ((addr + AMX_REG_SIZE - 1) & TARGET_PAGE_MASK)) {
+        probe_write(env, addr + AMX_REG_SIZE - 1, 1, arm_env_mmu_index(env),
+                    ra);
+    }
+    for (i = 0; i < AMX_REG_WORDS; i++) {
+        cpu_stq_le_data_ra(env, addr + i * 8, src[i], ra);
+    }
+}
+
+static void amx_ldst_xy(CPUARMState *env, uint64_t *file, uint64_t operand,
+                        bool store, uintptr_t ra)
+{
+    uint64_t addr = AMX_OPERAND_PTR(operand);
+    unsigned int reg = extract64(operand, 56, 3);
+    int i;
+
+    for (i = 0; i <= AMX_OPERAND_PAIR(operand); i++) {
+        uint64_t *r = &file[((reg + i) % 8) * AMX_REG_WORDS];
+
+        if (store) {
+            amx_store(env, addr + i * AMX_REG_SIZE, r, ra);
+        } else {
+            amx_load(env, addr + i * AMX_REG_SIZE, r, ra);
+        }
+    }
+}
+
+static void amx_ldst_z(CPUARMState *env, uint64_t operand, bool store,
+                       uintptr_t ra)
+{
+    uint64_t addr = AMX_OPERAND_PTR(operand);
+    unsigned int row = extract64(operand, 56, 6);
+    int i;
+
+    for (i = 0; i <= AMX_OPERAND_PAIR(operand); i++) {
+        uint64_t *r = env->amx.z[(row + i) % AMX_Z_ROWS];
+
+        if (store) {
+            amx_store(env, addr + i * AMX_REG_SIZE, r, ra);
+        } else {
+            amx_load(env, addr + i * AMX_REG_SIZE, r, ra);
+        }
+    }
+}
+
+static void amx_ldst_zi(CPUARMState *env, uint64_t operand, bool store,
+                        uintptr_t ra)
+{
+    uint64_t addr = AMX_OPERAND_PTR(operand);
+    uint64_t buf[AMX_REG_WORDS];
+
+    if (store) {
+        amx_interleave_z(env->amx.z, operand, buf, true);
+        amx_store(env, addr, buf, ra);
+    } else {
+        amx_load(env, addr, buf, ra);
+        amx_interleave_z(env->amx.z, operand, buf, false);
+    }
+}
+
+static void amx_init_fpst(float_status *fpst)
+{
+    memset(fpst, 0, sizeof(*fpst));
+    arm_set_default_fp_behaviours(fpst);
+    set_default_nan_mode(true, fpst);
+    /* AMX has no exception flags; this also enables the hardfloat path. */
+    fpst->float_exception_flags = float_flag_inexact;
+}
+
+void HELPER(amx)(CPUARMState *env, uint32_t op, uint64_t operand)
+{
+    uint64_t *x = &env->amx.x[0][0];
+    uint64_t *y = &env->amx.y[0][0];
+    uintptr_t ra = GETPC();
+    float_status fpst;
+
+    if (!(env->amx.ctl & AMX_CTL_EN)) {
+        amx_undef(env, ra);
+    }
+
+    if (op == AMX_OP_SETCLR) {
+        switch (operand) {
+        case 0:
+            env->amx.active = true;
+            return;
+        case 1:
+            env->amx.active = false;
+            return;
+        default:
+            amx_undef(env, ra);
+        }
+    }
+
+    if (!env->amx.active) {
+        amx_undef(env, ra);
+    }
+
+    amx_init_fpst(&fpst);
+
+    switch (op) {
+    case AMX_OP_LDX:
+    case AMX_OP_STX:
+        amx_ldst_xy(env, x, operand, op == AMX_OP_STX, ra);
+        break;
+    case AMX_OP_LDY:
+    case AMX_OP_STY:
+        amx_ldst_xy(env, y, operand, op == AMX_OP_STY, ra);
+        break;
+    case AMX_OP_LDZ:
+    case AMX_OP_STZ:
+        amx_ldst_z(env, operand, op == AMX_OP_STZ, ra);
+        break;
+    case AMX_OP_LDZI:
+    case AMX_OP_STZI:
+        amx_ldst_zi(env, operand, op == AMX_OP_STZI, ra);
+        break;
+    case AMX_OP_EXTRX:
+        if (!amx_extr(x, env->amx.z, extract64(operand, 10, 9), operand)) {
+            amx_undef(env, ra);
+        }
+        break;
+    case AMX_OP_EXTRY:
+        if (!amx_extr(y, env->amx.z, extract64(operand, 0, 9), operand)) {
+            amx_undef(env, ra);
+        }
+        break;
+    case AMX_OP_FMA64:
+        amx_fma64(x, y, env->amx.z, operand, 0, &fpst);
+        break;
+    case AMX_OP_FMS64:
+        amx_fma64(x, y, env->amx.z, operand, float_muladd_negate_product,
+                  &fpst);
+        break;
+    case AMX_OP_FMA32:
+        amx_fma32(x, y, env->amx.z, operand, 0, &fpst);
+        break;
+    case AMX_OP_FMS32:
+        amx_fma32(x, y, env->amx.z, operand, float_muladd_negate_product,
+                  &fpst);
+        break;
+    case AMX_OP_MAC16:
+        amx_mac16(x, y, env->amx.z, operand, 0, &fpst);
+        break;
+    case AMX_OP_FMA16:
+        amx_fma16(x, y, env->amx.z, operand, 0, &fpst);
+        break;
+    case AMX_OP_FMS16:
+        amx_fma16(x, y, env->amx.z, operand, float_muladd_negate_product,
+                  &fpst);
+        break;
+    default:
+        amx_undef(env, ra);
+    }
+}
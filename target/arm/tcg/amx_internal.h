@@ -0,0 +1,96 @@
+/*
+ * Apple AMX matrix coprocessor, register file operations
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TARGET_ARM_AMX_INTERNAL_H
+#define TARGET_ARM_AMX_INTERNAL_H
+
+#include "qemu/bitops.h"
+#include "fpu/softfloat-types.h"
+
+/*
+ * The register file is 8 X and 8 Y registers and 64 Z rows, all 64 bytes
+ * wide. Registers are kept as little-endian 64-bit words so narrower lanes
+ * are addressed with host-endian fixups like the vector registers.
+ *
+ * Every instruction takes a single 64-bit operand from a GPR. Memory
+ * operations carry a 56-bit pointer in the low bits, the arithmetic ones
+ * carry byte offsets into the X and Y files (which wrap around) and a
+ * Z row.
+ *
+ * Nothing in here touches CPUARMState, so the operations can be checked
+ * against a reference model outside of a CPU.
+ */
+
+#define AMX_REG_SIZE (64)
+#define AMX_REG_WORDS (AMX_REG_SIZE / 8)
+#define AMX_FILE_WORDS (8 * AMX_REG_WORDS)
+#define AMX_Z_ROWS (64)
+
+#define AMX_OPERAND_PTR(op) sextract64(op, 0, 56)
+#define AMX_OPERAND_PAIR(op) extract64(op, 62, 1)
+
+#define AMX_OPERAND_XOFF(op) extract64(op, 0, 9)
+#define AMX_OPERAND_YOFF(op) extract64(op, 10, 9)
+#define AMX_OPERAND_ZROW(op) extract64(op, 20, 6)
+#define AMX_OPERAND_SKIP_Z(op) extract64(op, 27, 1)
+#define AMX_OPERAND_SKIP_Y(op) extract64(op, 28, 1)
+#define AMX_OPERAND_SKIP_X(op) extract64(op, 29, 1)
+#define AMX_OPERAND_VECTOR(op) extract64(op, 63, 1)
+
+/* Lane width, direction and alternate-form selectors of extrx/extry. */
+#define AMX_OPERAND_EXTR_MODE(op) extract64(op, 26, 38)
+
+/* Copy 64 bytes starting at byte `offset` of an X or Y file. */
+void amx_gather(const uint64_t *file, unsigned int offset, uint64_t *out);
+
+/* Copy 64 bytes into an X or Y file, starting at byte `offset`. */
+void amx_scatter(uint64_t *file, unsigned int offset, const uint64_t *in);
+
+/*
+ * Move one half of a pair of Z rows to or from `buf` for ldzi/stzi.
+ * `buf` alternates 32-bit lanes between the even and the odd row.
+ */
+void amx_interleave_z(uint64_t (*z)[AMX_REG_WORDS], uint64_t operand,
+                      uint64_t *buf, bool store);
+
+/*
+ * Move a Z row into X (extrx) or Y (extry) at byte `offset`. Returns false,
+ * without touching the file, for the lane modes that are not implemented.
+ */
+bool amx_extr(uint64_t *file, uint64_t (*z)[AMX_REG_WORDS],
+              unsigned int offset, uint64_t operand);
+
+/*
+ * The multiply-accumulate ops. `flags` takes float_muladd_negate_product
+ * for the fms forms and is ignored by mac16.
+ */
+void amx_fma64(const uint64_t *x, const uint64_t *y,
+               uint64_t (*z)[AMX_REG_WORDS], uint64_t operand, int flags,
+               float_status *fpst);
+void amx_fma32(const uint64_t *x, const uint64_t *y,
+               uint64_t (*z)[AMX_REG_WORDS], uint64_t operand, int flags,
+               float_status *fpst);
+void amx_fma16(const uint64_t *x, const uint64_t *y,
+               uint64_t (*z)[AMX_REG_WORDS], uint64_t operand, int flags,
+               float_status *fpst);
+void amx_mac16(const uint64_t *x, const uint64_t *y,
+               uint64_t (*z)[AMX_REG_WORDS], uint64_t operand, int flags,
+               float_status *fpst);
+
+#endif /* TARGET_ARM_AMX_INTERNAL_H */
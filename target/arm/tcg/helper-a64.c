@@ -745,7 +745,7 @@ void HELPER(exception_return)(CPUARMState *env, uint64_t new_pc)
         if ((tbii >> extract64(new_pc, 55, 1)) & 1) {
             /* TBI is enabled. */
             int core_mmu_idx = arm_env_mmu_index(env);
-            if (regime_has_2_ranges(core_to_aa64_mmu_idx(core_mmu_idx))) {
+            if (regime_has_2_ranges(core_to_aa64_mmu_idx(env, core_mmu_idx))) {
                 new_pc = sextract64(new_pc, 0, 56);
             } else {
                 new_pc = extract64(new_pc, 0, 56);
@@ -1810,15 +1810,19 @@ void HELPER(guarded_page_br)(CPUARMState *env, target_ulong pc)
     env->btype = is_guarded_page(env, pc, GETPC()) ? 3 : 1;
 }
 
-static void *get_page_read(CPUARMState *env, uint64_t vaddr_in, int mmu_idx)
+/*
+ * Return a host pointer to the page containing @vaddr_in, raising any
+ * fault for it first. NULL means the page is not backed by host RAM
+ * (MMIO, watchpoints, ...) and must be accessed through the slow path.
+ */
+static void *wkdm_page_read(CPUARMState *env, uint64_t vaddr_in,
+                            int mmu_idx, uintptr_t ra)
 {
     uint64_t vaddr = vaddr_in & TARGET_PAGE_MASK;
 
     void *mem = tlb_vaddr_to_host(env, vaddr, MMU_DATA_LOAD, mmu_idx);
 #ifndef CONFIG_USER_ONLY
     if (unlikely(!mem)) {
-        uintptr_t ra = GETPC();
-
         /*
          * Trap if accessing an invalid page.
          */
@@ -1830,15 +1834,14 @@ static void *get_page_read(CPUARMState *env, uint64_t vaddr_in, int mmu_idx)
     return mem;
 }
 
-static void *get_page_write(CPUARMState *env, uint64_t vaddr_in, int mmu_idx)
+static void *wkdm_page_write(CPUARMState *env, uint64_t vaddr_in,
+                             int mmu_idx, uintptr_t ra)
 {
     uint64_t vaddr = vaddr_in & TARGET_PAGE_MASK;
 
     void *mem = tlb_vaddr_to_host(env, vaddr, MMU_DATA_STORE, mmu_idx);
 #ifndef CONFIG_USER_ONLY
     if (unlikely(!mem)) {
-        uintptr_t ra = GETPC();
-
         /*
          * Trap if accessing an invalid page.
          */
@@ -1850,13 +1853,46 @@ static void *get_page_write(CPUARMState *env, uint64_t vaddr_in, int mmu_idx)
     return mem;
 }
 
+/* Slow path: copy @len bytes of guest memory into a host bounce buffer. */
+static void *wkdm_read_slow(CPUARMState *env, uint64_t vaddr, size_t len,
+                            int mmu_idx, uintptr_t ra)
+{
+    uint8_t *buf = g_malloc(len);
+    size_t i;
+
+    for (i = 0; i < len; i += 8) {
+        stq_le_p(buf + i, cpu_ldq_le_mmuidx_ra(env, vaddr + i, mmu_idx, ra));
+    }
+
+    return buf;
+}
+
+/* Slow path: copy @len bytes of a host bounce buffer into guest memory. */
+static void wkdm_write_slow(CPUARMState *env, uint64_t vaddr,
+                            const uint8_t *buf, size_t len, int mmu_idx,
+                            uintptr_t ra)
+{
+    size_t i;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        cpu_stq_le_mmuidx_ra(env, vaddr + i, ldq_le_p(buf + i), mmu_idx, ra);
+    }
+    for (; i < len; i++) {
+        cpu_stb_mmuidx_ra(env, vaddr + i, buf[i], mmu_idx, ra);
+    }
+}
+
 uint64_t HELPER(wkdmc)(CPUARMState *env, uint64_t vaddr_in, uint64_t vaddr_out)
 {
+    uintptr_t ra = GETPC();
+    g_autofree uint8_t *in_buf = NULL;
+    g_autofree uint8_t *out_buf = NULL;
     int mmu_idx;
-    char *in_mem;
-    char *out_mem;
+    uint8_t *in_mem;
+    uint8_t *out_mem;
     int out_offset;
     int csize;
+    int n;
 
     if (TARGET_PAGE_BITS < 10 || TARGET_PAGE_BITS > 14) {
         return -1;
@@ -1865,27 +1901,39 @@ uint64_t HELPER(wkdmc)(CPUARMState *env, uint64_t vaddr_in, uint64_t vaddr_out)
     mmu_idx = arm_env_mmu_index(env);
     vaddr_in &= TARGET_PAGE_MASK;
     vaddr_out &= ~0x3f;
-    in_mem = get_page_read(env, vaddr_in, mmu_idx);
-    out_mem = get_page_write(env, vaddr_out, mmu_idx);
     out_offset = vaddr_out - (vaddr_out & TARGET_PAGE_MASK);
     csize = TARGET_PAGE_SIZE - out_offset;
 
-    if (in_mem == NULL || out_mem == NULL) {
-        return -1;
+    in_mem = wkdm_page_read(env, vaddr_in, mmu_idx, ra);
+    out_mem = wkdm_page_write(env, vaddr_out, mmu_idx, ra);
+    if (unlikely(in_mem == NULL)) {
+        in_mem = in_buf = wkdm_read_slow(env, vaddr_in, TARGET_PAGE_SIZE,
+                                         mmu_idx, ra);
+    }
+    if (likely(out_mem != NULL)) {
+        out_mem += out_offset;
+    } else {
+        out_mem = out_buf = g_malloc(csize);
     }
 
-    int n = WKdm_compress(in_mem, out_mem + out_offset, csize);
+    n = WKdm_compress(in_mem, out_mem, csize);
     if (n <= 0) {
         return n;
     }
     if (n > csize) {
         return -1;
     }
+    if (unlikely(out_buf != NULL)) {
+        wkdm_write_slow(env, vaddr_out, out_buf, n, mmu_idx, ra);
+    }
     return n >> 6;
 }
 
 uint64_t HELPER(wkdmd)(CPUARMState *env, uint64_t vaddr_in, uint64_t vaddr_out)
 {
+    uintptr_t ra = GETPC();
+    g_autofree uint8_t *in_buf = NULL;
+    g_autofree uint8_t *out_buf = NULL;
     int mmu_idx;
     uint8_t *in_mem, *out_mem;
     int in_offset;
@@ -1898,18 +1946,27 @@ uint64_t HELPER(wkdmd)(CPUARMState *env, uint64_t vaddr_in, uint64_t vaddr_out)
     mmu_idx = arm_env_mmu_index(env);
     vaddr_out &= TARGET_PAGE_MASK;
     vaddr_in &= ~0x3f;
-    in_mem = get_page_read(env, vaddr_in, mmu_idx);
-    out_mem = get_page_write(env, vaddr_out, mmu_idx);
     in_offset = vaddr_in - (vaddr_in & TARGET_PAGE_MASK);
     csize = TARGET_PAGE_SIZE - in_offset;
 
-    if (in_mem == NULL || out_mem == NULL) {
-        return 0x3000;
+    in_mem = wkdm_page_read(env, vaddr_in, mmu_idx, ra);
+    out_mem = wkdm_page_write(env, vaddr_out, mmu_idx, ra);
+    if (likely(in_mem != NULL)) {
+        in_mem += in_offset;
+    } else {
+        in_mem = in_buf = wkdm_read_slow(env, vaddr_in, csize, mmu_idx, ra);
+    }
+    if (unlikely(out_mem == NULL)) {
+        out_mem = out_buf = g_malloc(TARGET_PAGE_SIZE);
     }
 
-    if (WKdm_decompress(in_mem + in_offset, out_mem, csize)) {
-        return 0;
+    if (!WKdm_decompress(in_mem, out_mem, csize)) {
+        return 0x3000;
+    }
+    if (unlikely(out_buf != NULL)) {
+        wkdm_write_slow(env, vaddr_out, out_buf, TARGET_PAGE_SIZE, mmu_idx,
+                        ra);
     }
 
-    return 0x3000;
+    return 0;
 }
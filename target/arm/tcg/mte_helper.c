@@ -599,7 +599,7 @@ void mte_check_fail(CPUARMState *env, uint32_t desc,
                     uint64_t dirty_ptr, uintptr_t ra)
 {
     int mmu_idx = FIELD_EX32(desc, MTEDESC, MIDX);
-    ARMMMUIdx arm_mmu_idx = core_to_aa64_mmu_idx(mmu_idx);
+    ARMMMUIdx arm_mmu_idx = core_to_aa64_mmu_idx(env, mmu_idx);
     int el, reg_el, tcf;
     uint64_t sctlr;
 
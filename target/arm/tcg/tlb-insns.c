@@ -234,7 +234,8 @@ static int vae1_tlbmask(CPUARMState *env)
         /* This is AArch64 only, so we don't need to touch the EL30_x TLBs */
         mask = ARMMMUIdxBit_E10_1 |
                ARMMMUIdxBit_E10_1_PAN |
-               ARMMMUIdxBit_E10_0;
+               ARMMMUIdxBit_E10_0 |
+               gxf_tlbmask(env);
     }
     return mask;
 }
@@ -121,6 +121,8 @@ static int get_a64_user_mem_index(DisasContext *s, bool unpriv)
         switch (useridx) {
         case ARMMMUIdx_E10_1:
         case ARMMMUIdx_E10_1_PAN:
+        case ARMMMUIdx_GE10_1:
+        case ARMMMUIdx_GE10_1_PAN:
             useridx = ARMMMUIdx_E10_0;
             break;
         case ARMMMUIdx_E20_2:
@@ -2494,7 +2496,10 @@ static void handle_sys(DisasContext *s, bool isread,
             }
             break;
         case 1:
-            gen_helper_tidcp_el1(tcg_env, tcg_constant_i32(syndrome));
+            /* HCR_EL2.TIDCP does not exist without EL2. */
+            if (dc_isar_feature(aa64_el2, s)) {
+                gen_helper_tidcp_el1(tcg_env, tcg_constant_i32(syndrome));
+            }
             break;
         }
     }
@@ -10116,6 +10121,17 @@ static bool disas_apple_insn(DisasContext *s, uint32_t insn)
     rn = extract32(insn, 5, 5);
     rd = extract32(insn, 0, 5);
 
+    /*
+     * AMX: the op is in rn and the operand in Xd, except for SET/CLR
+     * (op 17) which encode it as an immediate. Availability, including
+     * at EL0, is decided by AMX_CTL_EL1 at run time.
+     */
+    if ((insn & 0xfffffc00) == 0x00201000 && s->amx_active) {
+        gen_helper_amx(tcg_env, tcg_constant_i32(rn),
+                       rn == 17 ? tcg_constant_i64(rd) : cpu_reg(s, rd));
+        return true;
+    }
+
     if (s->current_el == 0) {
         return false;
     }
@@ -10187,6 +10203,7 @@ static void aarch64_tr_init_disas_context(DisasContextBase *dcbase,
     dc->condjmp = 0;
     dc->pc_save = dc->base.pc_first;
     dc->gxf_active = arm_feature(env, ARM_FEATURE_GXF);
+    dc->amx_active = arm_feature(env, ARM_FEATURE_AMX);
     dc->aarch64 = true;
     dc->thumb = false;
     dc->sctlr_b = 0;
@@ -10194,7 +10211,7 @@ static void aarch64_tr_init_disas_context(DisasContextBase *dcbase,
     dc->condexec_mask = 0;
     dc->condexec_cond = 0;
     core_mmu_idx = EX_TBFLAG_ANY(tb_flags, MMUIDX);
-    dc->mmu_idx = core_to_aa64_mmu_idx(core_mmu_idx);
+    dc->mmu_idx = core_to_aa64_mmu_idx(env, core_mmu_idx);
     dc->tbii = EX_TBFLAG_A64(tb_flags, TBII);
     dc->tbid = EX_TBFLAG_A64(tb_flags, TBID);
     dc->tcma = EX_TBFLAG_A64(tb_flags, TCMA);
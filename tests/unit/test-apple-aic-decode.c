@@ -0,0 +1,124 @@
+/*
+ * Apple Interrupt Controller register decode tests.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/intc/apple_aic_internal.h"
+
+static void test_decode_global(void)
+{
+    g_assert_cmpint(apple_aic_decode(REG_AIC_REV), ==, AIC_REGION_GLOBAL);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_CAP0), ==, AIC_REGION_GLOBAL);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_CAP1), ==, AIC_REGION_GLOBAL);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_RST), ==, AIC_REGION_GLOBAL);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_GLB_CFG), ==, AIC_REGION_GLOBAL);
+}
+
+static void test_decode_local(void)
+{
+    static const hwaddr regs[] = {
+        REG_AIC_WHOAMI,        REG_AIC_IACK,          REG_AIC_IPI_SET,
+        REG_AIC_IPI_CLR,       REG_AIC_IPI_MASK_SET,  REG_AIC_IPI_MASK_CLR,
+        REG_AIC_IPI_DEFER_SET, REG_AIC_IPI_DEFER_CLR,
+    };
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(regs); i++) {
+        g_assert_cmpint(apple_aic_decode(regs[i]), ==, AIC_REGION_LOCAL);
+    }
+}
+
+static void test_decode_eir(void)
+{
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_DEST(0)), ==,
+                    AIC_REGION_EIR_DEST);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_DEST(AIC_MAX_INT - 1)), ==,
+                    AIC_REGION_EIR_DEST);
+
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_SW_SET(0)), ==,
+                    AIC_REGION_EIR_SW_SET);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_SW_SET(kAIC_NUM_EIRS - 1)),
+                    ==, AIC_REGION_EIR_SW_SET);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_SW_CLR(0)), ==,
+                    AIC_REGION_EIR_SW_CLR);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_SW_CLR(kAIC_NUM_EIRS - 1)),
+                    ==, AIC_REGION_EIR_SW_CLR);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_MASK_SET(0)), ==,
+                    AIC_REGION_EIR_MASK_SET);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_MASK_SET(kAIC_NUM_EIRS - 1)),
+                    ==, AIC_REGION_EIR_MASK_SET);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_MASK_CLR(0)), ==,
+                    AIC_REGION_EIR_MASK_CLR);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_MASK_CLR(kAIC_NUM_EIRS - 1)),
+                    ==, AIC_REGION_EIR_MASK_CLR);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_INT_RO(0)), ==,
+                    AIC_REGION_EIR_INT_RO);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_INT_RO(kAIC_NUM_EIRS - 1)),
+                    ==, AIC_REGION_EIR_INT_RO);
+}
+
+static void test_decode_cpu(void)
+{
+    uint32_t cpu;
+
+    for (cpu = 0; cpu < AIC_MAX_CPU; cpu++) {
+        g_assert_cmpint(apple_aic_decode(REG_AIC_WHOAMI_Pn(cpu)), ==,
+                        AIC_REGION_CPU);
+        g_assert_cmpint(apple_aic_decode(REG_AIC_IPI_DEFER_CLR_Pn(cpu)), ==,
+                        AIC_REGION_CPU);
+
+        /* Each block aliases the local registers at the same offset. */
+        g_assert_cmpuint(REG_AIC_IACK_Pn(cpu) & (AIC_REGION_SIZE - 1), ==,
+                         REG_AIC_IACK - REG_AIC_WHOAMI);
+        g_assert_cmpuint(REG_AIC_IPI_SET_Pn(cpu) & (AIC_REGION_SIZE - 1), ==,
+                         REG_AIC_IPI_SET - REG_AIC_WHOAMI);
+        g_assert_cmpuint(REG_AIC_IPI_DEFER_CLR_Pn(cpu) &
+                             (AIC_REGION_SIZE - 1),
+                         ==, REG_AIC_IPI_DEFER_CLR - REG_AIC_WHOAMI);
+    }
+}
+
+static void test_decode_unmapped(void)
+{
+    g_assert_cmpint(apple_aic_decode(REG_AIC_GLB_CFG + AIC_REGION_SIZE), ==,
+                    AIC_REGION_UNMAPPED);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_WHOAMI - 4), ==,
+                    AIC_REGION_UNMAPPED);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_WHOAMI + AIC_REGION_SIZE), ==,
+                    AIC_REGION_UNMAPPED);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_EIR_INT_RO(0) + AIC_REGION_SIZE),
+                    ==, AIC_REGION_UNMAPPED);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_WHOAMI_Pn(0) - 4), ==,
+                    AIC_REGION_UNMAPPED);
+    g_assert_cmpint(apple_aic_decode(REG_AIC_WHOAMI_Pn(AIC_MAX_CPU)), ==,
+                    AIC_REGION_UNMAPPED);
+    g_assert_cmpint(apple_aic_decode(UINT64_MAX), ==, AIC_REGION_UNMAPPED);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/apple-aic/decode/global", test_decode_global);
+    g_test_add_func("/apple-aic/decode/local", test_decode_local);
+    g_test_add_func("/apple-aic/decode/eir", test_decode_eir);
+    g_test_add_func("/apple-aic/decode/cpu", test_decode_cpu);
+    g_test_add_func("/apple-aic/decode/unmapped", test_decode_unmapped);
+
+    return g_test_run();
+}
@@ -0,0 +1,213 @@
+/*
+ * Apple Mach-O name index tests.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/cutils.h"
+#include "hw/arm/apple-silicon/boot.h"
+
+/* Builds Mach-O headers and load commands into a zeroed buffer. */
+typedef struct {
+    uint64_t buf[512];
+    size_t used;
+} MachoBuilder;
+
+static void *builder_alloc(MachoBuilder *b, size_t size)
+{
+    void *p = (uint8_t *)b->buf + b->used;
+
+    b->used += ROUND_UP(size, 8);
+    g_assert_cmpuint(b->used, <=, sizeof(b->buf));
+    return p;
+}
+
+static MachoHeader64 *add_header(MachoBuilder *b, uint32_t file_type)
+{
+    MachoHeader64 *hdr = builder_alloc(b, sizeof(*hdr));
+
+    hdr->magic = MACH_MAGIC_64;
+    hdr->file_type = file_type;
+    return hdr;
+}
+
+static MachoSegmentCommand64 *add_segment(MachoBuilder *b, MachoHeader64 *hdr,
+                                          const char *name,
+                                          const char *const *sects)
+{
+    MachoSegmentCommand64 *seg = builder_alloc(b, sizeof(*seg));
+    MachoSection64 *sp;
+
+    seg->cmd = LC_SEGMENT_64;
+    pstrcpy(seg->segname, sizeof(seg->segname), name);
+    for (; sects != NULL && *sects != NULL; sects++, seg->nsects++) {
+        sp = builder_alloc(b, sizeof(*sp));
+        pstrcpy(sp->sect_name, sizeof(sp->sect_name), *sects);
+        pstrcpy(sp->seg_name, sizeof(sp->seg_name), name);
+    }
+    seg->cmd_size = sizeof(*seg) + seg->nsects * sizeof(*sp);
+    hdr->n_cmds++;
+    hdr->size_of_cmds += seg->cmd_size;
+    return seg;
+}
+
+static void add_symtab(MachoBuilder *b, MachoHeader64 *hdr)
+{
+    MachoSymtabCommand *symtab = builder_alloc(b, sizeof(*symtab));
+
+    symtab->cmd = LC_SYMTAB;
+    symtab->cmd_size = sizeof(*symtab);
+    hdr->n_cmds++;
+    hdr->size_of_cmds += symtab->cmd_size;
+}
+
+static MachoFilesetEntryCommand *add_fileset_entry(MachoBuilder *b,
+                                                   MachoHeader64 *hdr,
+                                                   const char *entry_id)
+{
+    size_t size = ROUND_UP(sizeof(MachoFilesetEntryCommand) +
+                           strlen(entry_id) + 1, 8);
+    MachoFilesetEntryCommand *fileset = builder_alloc(b, size);
+
+    fileset->cmd = LC_FILESET_ENTRY;
+    fileset->cmd_size = size;
+    fileset->entry_id = sizeof(*fileset);
+    strcpy((char *)(fileset + 1), entry_id);
+    hdr->n_cmds++;
+    hdr->size_of_cmds += size;
+    return fileset;
+}
+
+static MachoSection64 *section_of(MachoSegmentCommand64 *seg, uint32_t i)
+{
+    return (MachoSection64 *)(seg + 1) + i;
+}
+
+static const char *const text_sects[] = { "__text", "__const", NULL };
+static const char *const data_sects[] = { "__data", "__const", NULL };
+static const char *const dup_sects[] = { "__text", NULL };
+
+static void test_index_image(void)
+{
+    g_autofree MachoBuilder *b = g_new0(MachoBuilder, 1);
+    MachoHeader64 *hdr = add_header(b, MH_EXECUTE);
+    MachoSegmentCommand64 *text = add_segment(b, hdr, "__TEXT", text_sects);
+    MachoSegmentCommand64 *data;
+    MachoSegmentCommand64 *dup;
+
+    add_symtab(b, hdr);
+    data = add_segment(b, hdr, "__DATA", data_sects);
+    dup = add_segment(b, hdr, "__TEXT", dup_sects);
+
+    g_assert_true(macho_get_segment(hdr, "__TEXT") == text);
+    g_assert_true(macho_get_segment(hdr, "__DATA") == data);
+    g_assert_null(macho_get_segment(hdr, "__LINKEDIT"));
+    g_assert_null(macho_get_segment(hdr, "__TEX"));
+
+    g_assert_true(macho_find_section(hdr, "__TEXT", "__text") ==
+                  section_of(text, 0));
+    g_assert_true(macho_find_section(hdr, "__TEXT", "__const") ==
+                  section_of(text, 1));
+    g_assert_true(macho_find_section(hdr, "__DATA", "__const") ==
+                  section_of(data, 1));
+    g_assert_null(macho_find_section(hdr, "__DATA", "__text"));
+
+    /* A linear walk would have stopped at the first one. */
+    g_assert_true(macho_get_segment(hdr, "__TEXT") != dup);
+    g_assert_true(macho_find_section(hdr, "__TEXT", "__text") !=
+                  section_of(dup, 0));
+
+    g_assert_null(macho_get_fileset(hdr, "com.apple.kernel"));
+
+    macho_index_drop((uint8_t *)b->buf, (uint8_t *)b->buf + b->used);
+}
+
+static void test_index_fileset(void)
+{
+    g_autofree MachoBuilder *b = g_new0(MachoBuilder, 1);
+    MachoHeader64 *fileset = add_header(b, MH_FILESET);
+    MachoFilesetEntryCommand *kernel_entry =
+        add_fileset_entry(b, fileset, "com.apple.kernel");
+    MachoFilesetEntryCommand *kext_entry =
+        add_fileset_entry(b, fileset, "com.apple.driver.Test");
+    MachoFilesetEntryCommand *dup_entry =
+        add_fileset_entry(b, fileset, "com.apple.driver.Test");
+    MachoHeader64 *kernel = add_header(b, MH_EXECUTE);
+    MachoSegmentCommand64 *kernel_text =
+        add_segment(b, kernel, "__TEXT_EXEC", text_sects);
+    MachoHeader64 *kext = add_header(b, MH_EXECUTE);
+    MachoSegmentCommand64 *kext_data =
+        add_segment(b, kext, "__DATA", data_sects);
+
+    kernel_entry->file_off = (uint8_t *)kernel - (uint8_t *)fileset;
+    kext_entry->file_off = (uint8_t *)kext - (uint8_t *)fileset;
+    dup_entry->file_off = kext_entry->file_off;
+
+    g_assert_true(macho_get_fileset(fileset, "com.apple.kernel") ==
+                  kernel_entry);
+    g_assert_true(macho_get_fileset(fileset, "com.apple.driver.Test") ==
+                  kext_entry);
+    g_assert_null(macho_get_fileset(fileset, "com.apple.driver"));
+
+    /* The segments of a fileset are those of com.apple.kernel. */
+    g_assert_true(macho_get_segment(fileset, "__TEXT_EXEC") == kernel_text);
+    g_assert_true(macho_find_section(fileset, "__TEXT_EXEC", "__const") ==
+                  section_of(kernel_text, 1));
+    g_assert_null(macho_get_segment(fileset, "__DATA"));
+
+    /* A nested header gets an index of its own. */
+    g_assert_true(macho_get_segment(kext, "__DATA") == kext_data);
+    g_assert_true(macho_find_section(kext, "__DATA", "__data") ==
+                  section_of(kext_data, 0));
+    g_assert_null(macho_get_segment(kext, "__TEXT_EXEC"));
+
+    macho_index_drop((uint8_t *)b->buf, (uint8_t *)b->buf + b->used);
+}
+
+static void test_index_drop(void)
+{
+    g_autofree MachoBuilder *b = g_new0(MachoBuilder, 1);
+    MachoHeader64 *hdr = add_header(b, MH_EXECUTE);
+    MachoSegmentCommand64 *text = add_segment(b, hdr, "__TEXT", text_sects);
+    uint8_t *start = (uint8_t *)b->buf;
+
+    g_assert_true(macho_get_segment(hdr, "__TEXT") == text);
+
+    /* The index is built once, so an edit is not seen until it is dropped. */
+    pstrcpy(text->segname, sizeof(text->segname), "__KLD");
+    g_assert_true(macho_get_segment(hdr, "__TEXT") == text);
+    g_assert_null(macho_get_segment(hdr, "__KLD"));
+
+    /* A range that starts past the header keeps it. */
+    macho_index_drop(start + 1, start + b->used);
+    g_assert_null(macho_get_segment(hdr, "__KLD"));
+
+    macho_index_drop(start, start + b->used);
+    g_assert_true(macho_get_segment(hdr, "__KLD") == text);
+    g_assert_null(macho_get_segment(hdr, "__TEXT"));
+
+    macho_index_drop(start, start + b->used);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/apple/macho-index/image", test_index_image);
+    g_test_add_func("/apple/macho-index/fileset", test_index_fileset);
+    g_test_add_func("/apple/macho-index/drop", test_index_drop);
+    return g_test_run();
+}
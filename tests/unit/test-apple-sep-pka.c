@@ -0,0 +1,115 @@
+/*
+ * Apple SEP PKA attestation known answer tests.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/arm/apple-silicon/sep-pka.h"
+
+/*
+ * Expected values were computed with an independent P-256 and SHA-256
+ * implementation from the derivation documented in sep-pka.c.
+ */
+typedef struct {
+    const char *name;
+    uint32_t ecid_chipid_misc[APPLE_PKA_ECID_WORDS];
+    uint32_t chip_revision;
+    bool pattern;
+    const char *public_key;
+    const char *attest_hash;
+} PKAVector;
+
+static const PKAVector vectors[] = {
+    {
+        .name = "zero",
+        .public_key = "06a64844f958a6ece35fbc5a4c36c37a"
+                      "8269feacb7beb3bb66b2028bd853ecf6"
+                      "dee296d3d94cb1c4f40b2c7ddd5ddd22"
+                      "45ec022370752e4930883ed49cbeb4d7",
+        .attest_hash = "6f9cbf8294de56b03c2d8e8315444b90"
+                       "2dc76e0b070fe999cf958d57365a5504",
+    },
+    {
+        .name = "t8030",
+        .ecid_chipid_misc = { 0x8030, 0x001a2b3c, 0x4d5e6f70, 0x11, 0x1 },
+        .chip_revision = 0x11,
+        .pattern = true,
+        .public_key = "423e456a1b79e9c6e519e9418d692c86"
+                      "0e7584f9855751823a82ba0e59ddfba9"
+                      "77462f46d66a1bee8d2c49b94ea29148"
+                      "8a12fdd4e72c0bdecddff9d0024bfec3",
+        .attest_hash = "e736c22d032602cb40b95eae4ac7679c"
+                       "1c2dc50adba7e2961687ad24b755240a",
+    },
+};
+
+static char *hex(const uint8_t *data, size_t len)
+{
+    GString *str = g_string_sized_new(len * 2);
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        g_string_append_printf(str, "%02x", data[i]);
+    }
+
+    return g_string_free(str, false);
+}
+
+static void test_pka_ecpub_attest(const void *opaque)
+{
+    const PKAVector *v = opaque;
+    uint8_t dgst[APPLE_PKA_DIGEST_SIZE] = { 0 };
+    uint8_t input[APPLE_PKA_INPUT_SIZE] = { 0 };
+    uint8_t public_key[APPLE_PKA_PUBLIC_KEY_SIZE];
+    uint8_t attest_hash[APPLE_PKA_DIGEST_SIZE];
+    g_autofree char *public_key_hex = NULL;
+    g_autofree char *attest_hash_hex = NULL;
+    size_t i;
+
+    if (v->pattern) {
+        for (i = 0; i < sizeof(dgst); i++) {
+            dgst[i] = i;
+        }
+        for (i = 0; i < sizeof(input); i++) {
+            input[i] = i * 7 + 3;
+        }
+    }
+
+    apple_pka_ecpub_attest(v->ecid_chipid_misc, v->chip_revision, dgst,
+                           input, public_key, attest_hash);
+
+    public_key_hex = hex(public_key, sizeof(public_key));
+    attest_hash_hex = hex(attest_hash, sizeof(attest_hash));
+    g_assert_cmpstr(public_key_hex, ==, v->public_key);
+    g_assert_cmpstr(attest_hash_hex, ==, v->attest_hash);
+}
+
+int main(int argc, char **argv)
+{
+    size_t i;
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+        g_autofree char *path =
+            g_strdup_printf("/apple/sep/pka/ecpub-attest/%s", vectors[i].name);
+
+        g_test_add_data_func(path, &vectors[i], test_pka_ecpub_attest);
+    }
+
+    return g_test_run();
+}
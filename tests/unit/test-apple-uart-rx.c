@@ -0,0 +1,184 @@
+/*
+ *  Apple Samsung S5L UART Rx FIFO tests
+ *
+ *  Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "hw/char/apple_uart_internal.h"
+
+typedef struct {
+    uint32_t reg[APPLE_UART_REGS_MEM_SIZE / sizeof(uint32_t)];
+    Fifo8 rx;
+} UartRx;
+
+static void uart_rx_init(UartRx *u, uint32_t rx_size, bool fifo)
+{
+    memset(u->reg, 0, sizeof(u->reg));
+    u->reg[I_(UFCON)] = fifo ? UFCON_FIFO_ENABLE : 0;
+    fifo8_create(&u->rx, rx_size);
+}
+
+static void test_rx_size(void)
+{
+    uint8_t buf[APPLE_UART_RX_FIFO_MAX];
+    UartRx u;
+
+    memset(buf, 'a', sizeof(buf));
+    uart_rx_init(&u, APPLE_UART_RX_FIFO_MAX, true);
+
+    /* A deep FIFO takes a whole burst at once. */
+    g_assert_cmpint(apple_uart_rx_room(u.reg, &u.rx), ==,
+                    APPLE_UART_RX_FIFO_MAX);
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 1000), ==, 1000);
+    g_assert_cmpuint(u.reg[I_(UTRSTAT)] & UTRSTAT_Rx_BUFFER_DATA_READY, !=,
+                     0);
+    g_assert_cmpuint(u.reg[I_(UERSTAT)], ==, 0);
+
+    /* The UFSTAT count saturates; the full bit is only set when full. */
+    g_assert_cmpuint(apple_uart_rx_fifo_status(&u.rx), ==,
+                     UFSTAT_Rx_FIFO_COUNT);
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf,
+                                         APPLE_UART_RX_FIFO_MAX - 1000),
+                    ==, APPLE_UART_RX_FIFO_MAX - 1000);
+    g_assert_cmpuint(apple_uart_rx_fifo_status(&u.rx), ==,
+                     UFSTAT_Rx_FIFO_COUNT | UFSTAT_Rx_FIFO_FULL);
+
+    fifo8_destroy(&u.rx);
+
+    uart_rx_init(&u, 4, true);
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 3), ==, 3);
+    g_assert_cmpuint(apple_uart_rx_fifo_status(&u.rx), ==, 3);
+    fifo8_destroy(&u.rx);
+}
+
+static void test_rx_trigger_level(void)
+{
+    uint32_t ufcon = 3 << UFCON_Rx_FIFO_TRIGGER_LEVEL_SHIFT;
+
+    /* Channel 0 counts in units of 32 and would never fire on 15 bytes. */
+    g_assert_cmpuint(apple_uart_rx_trigger_level(0, 0, 4096), ==, 32);
+    g_assert_cmpuint(apple_uart_rx_trigger_level(0, ufcon, 4096), ==, 128);
+    g_assert_cmpuint(apple_uart_rx_trigger_level(0, ufcon, 15), ==, 15);
+    g_assert_cmpuint(apple_uart_rx_trigger_level(1, ufcon, 4096), ==, 32);
+    g_assert_cmpuint(apple_uart_rx_trigger_level(2, 0, 1), ==, 1);
+    g_assert_cmpuint(apple_uart_rx_trigger_level(7, ufcon, 4096), ==, 0);
+}
+
+static void test_rx_overrun(void)
+{
+    static const uint8_t buf[] = "0123456789";
+    UartRx u;
+
+    uart_rx_init(&u, 4, true);
+
+    /* Only what fits is taken; the rest is reported, not queued. */
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 6), ==, 4);
+    g_assert_cmpuint(u.reg[I_(UERSTAT)], ==, UERSTAT_OVERRUN);
+    g_assert_cmpuint(fifo8_num_used(&u.rx), ==, 4);
+    g_assert_cmpuint(fifo8_pop(&u.rx), ==, '0');
+
+    /* Nothing to take leaves the Rx status alone. */
+    u.reg[I_(UERSTAT)] = 0;
+    u.reg[I_(UTRSTAT)] = 0;
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 0), ==, 0);
+    g_assert_cmpuint(u.reg[I_(UTRSTAT)], ==, 0);
+    g_assert_cmpuint(u.reg[I_(UERSTAT)], ==, 0);
+
+    /* A break on a full FIFO is flagged without pushing the null byte. */
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 1), ==, 1);
+    apple_uart_rx_break(u.reg, &u.rx);
+    g_assert_cmpuint(u.reg[I_(UERSTAT)], ==, UERSTAT_BREAK);
+    g_assert_cmpuint(fifo8_num_used(&u.rx), ==, 4);
+
+    fifo8_destroy(&u.rx);
+}
+
+static void test_rx_no_fifo(void)
+{
+    static const uint8_t buf[] = "xy";
+    UartRx u;
+
+    uart_rx_init(&u, 16, false);
+
+    /* URXH holds one byte until the guest reads it. */
+    g_assert_cmpint(apple_uart_rx_room(u.reg, &u.rx), ==, 1);
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 2), ==, 1);
+    g_assert_cmpuint(u.reg[I_(URXH)], ==, 'x');
+    g_assert_cmpuint(u.reg[I_(UERSTAT)], ==, UERSTAT_OVERRUN);
+    g_assert_cmpint(apple_uart_rx_room(u.reg, &u.rx), ==, 0);
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf + 1, 1), ==, 0);
+    g_assert_cmpuint(u.reg[I_(URXH)], ==, 'x');
+    g_assert_cmpuint(fifo8_num_used(&u.rx), ==, 0);
+
+    fifo8_destroy(&u.rx);
+}
+
+static void test_rx_backpressure(void)
+{
+    static const uint8_t buf[] = "abcd";
+    bool wake;
+    UartRx u;
+
+    uart_rx_init(&u, 4, true);
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 3), ==, 3);
+
+    /* The chardev is still sending while there is room. */
+    g_assert_cmpuint(apple_uart_rx_pop(&u.rx, &wake), ==, 'a');
+    g_assert_false(wake);
+
+    /* Once full it has stopped, and the read that frees a slot wakes it. */
+    g_assert_cmpint(apple_uart_rx_accept(u.reg, &u.rx, buf, 2), ==, 2);
+    g_assert_cmpint(apple_uart_rx_room(u.reg, &u.rx), ==, 0);
+    g_assert_cmpuint(apple_uart_rx_pop(&u.rx, &wake), ==, 'b');
+    g_assert_true(wake);
+    g_assert_cmpint(apple_uart_rx_room(u.reg, &u.rx), ==, 1);
+    g_assert_cmpuint(apple_uart_rx_pop(&u.rx, &wake), ==, 'c');
+    g_assert_false(wake);
+
+    fifo8_destroy(&u.rx);
+}
+
+static void test_rx_status(void)
+{
+    uint32_t all = UTRSTAT_Rx_BUFFER_DATA_READY | UTRSTAT_Rx_TIMEOUT |
+                   UTRSTAT_Rx_THRESH | UTRSTAT_Tx_EMPTY;
+
+    /* Above the trigger level nothing is cleared. */
+    g_assert_cmpuint(apple_uart_rx_status(all, 8, 8), ==, all);
+
+    /* Below it the threshold goes, but timeout stays until drained. */
+    g_assert_cmpuint(apple_uart_rx_status(all, 7, 8), ==,
+                     all & ~UTRSTAT_Rx_THRESH);
+    g_assert_cmpuint(apple_uart_rx_status(all, 1, 8), ==,
+                     all & ~UTRSTAT_Rx_THRESH);
+
+    /* An empty FIFO clears every Rx condition and leaves Tx alone. */
+    g_assert_cmpuint(apple_uart_rx_status(all, 0, 8), ==, UTRSTAT_Tx_EMPTY);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/apple-uart/rx/size", test_rx_size);
+    g_test_add_func("/apple-uart/rx/trigger-level", test_rx_trigger_level);
+    g_test_add_func("/apple-uart/rx/overrun", test_rx_overrun);
+    g_test_add_func("/apple-uart/rx/no-fifo", test_rx_no_fifo);
+    g_test_add_func("/apple-uart/rx/backpressure", test_rx_backpressure);
+    g_test_add_func("/apple-uart/rx/status", test_rx_status);
+    return g_test_run();
+}
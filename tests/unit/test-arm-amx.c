@@ -0,0 +1,484 @@
+/*
+ * Apple AMX register file operation tests.
+ *
+ * Copyright (c) 2025 Visual Ehrmanntraut.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include <math.h>
+#include "qemu/bswap.h"
+#include "fpu/softfloat.h"
+#include "target/arm/tcg/amx_internal.h"
+
+/*
+ * Each op is run on a random register file and compared with a reference
+ * model that works on the little-endian byte image of the registers and
+ * does the arithmetic with the host's fma().
+ */
+
+typedef struct {
+    uint64_t x[8][AMX_REG_WORDS];
+    uint64_t y[8][AMX_REG_WORDS];
+    uint64_t z[AMX_Z_ROWS][AMX_REG_WORDS];
+} AMXRegs;
+
+typedef struct {
+    uint8_t x[8 * AMX_REG_SIZE];
+    uint8_t y[8 * AMX_REG_SIZE];
+    uint8_t z[AMX_Z_ROWS][AMX_REG_SIZE];
+} RefRegs;
+
+#define OP_XOFF(v) ((uint64_t)(v) << 0)
+#define OP_YOFF(v) ((uint64_t)(v) << 10)
+#define OP_ZROW(v) ((uint64_t)(v) << 20)
+#define OP_SKIP_Z BIT_ULL(27)
+#define OP_SKIP_Y BIT_ULL(28)
+#define OP_SKIP_X BIT_ULL(29)
+#define OP_VECTOR BIT_ULL(63)
+
+typedef enum {
+    LANE_F64,
+    LANE_F32,
+    LANE_F16,
+    LANE_I16,
+} LaneType;
+
+static void words_to_bytes(const uint64_t *words, uint8_t *bytes, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        stq_le_p(bytes + i * 8, words[i]);
+    }
+}
+
+static void regs_to_ref(const AMXRegs *r, RefRegs *ref)
+{
+    words_to_bytes(&r->x[0][0], ref->x, AMX_FILE_WORDS);
+    words_to_bytes(&r->y[0][0], ref->y, AMX_FILE_WORDS);
+    words_to_bytes(&r->z[0][0], &ref->z[0][0], AMX_Z_ROWS * AMX_REG_WORDS);
+}
+
+static void assert_regs_equal(const AMXRegs *r, const RefRegs *ref)
+{
+    RefRegs got;
+
+    regs_to_ref(r, &got);
+    g_assert(memcmp(got.x, ref->x, sizeof(got.x)) == 0);
+    g_assert(memcmp(got.y, ref->y, sizeof(got.y)) == 0);
+    g_assert(memcmp(got.z, ref->z, sizeof(got.z)) == 0);
+}
+
+static double half_to_double(uint16_t h)
+{
+    int exp = extract32(h, 10, 5);
+    double v;
+
+    g_assert(exp != 0x1f);
+    if (exp == 0) {
+        v = ldexp(extract32(h, 0, 10), -24);
+    } else {
+        v = ldexp(extract32(h, 0, 10) | 0x400, exp - 25);
+    }
+    return (h & 0x8000) ? -v : v;
+}
+
+/* Only for values that are exactly representable as normal halves. */
+static uint16_t double_to_half(double v)
+{
+    uint16_t sign = signbit(v) ? 0x8000 : 0;
+    int exp;
+    double m;
+
+    if (v == 0) {
+        return sign;
+    }
+    m = frexp(fabs(v), &exp);
+    g_assert(exp - 1 + 15 > 0 && exp - 1 + 15 < 0x1f);
+    g_assert(ldexp(m, 11) == floor(ldexp(m, 11)));
+    return sign | ((exp - 1 + 15) << 10) | (uint16_t)(ldexp(m, 11) - 0x400);
+}
+
+/* Small values whose sums of products stay exact in every lane type. */
+static uint64_t random_lane(LaneType type)
+{
+    static const double vals[] = { 0, 0.5, -0.5, 1, -1, 2, -2, 3, -3 };
+    double d;
+    float f;
+    uint64_t bits64;
+    uint32_t bits;
+
+    switch (type) {
+    case LANE_F64:
+        d = (double)(int32_t)g_test_rand_int() / 1024;
+        memcpy(&bits64, &d, sizeof(bits64));
+        return bits64;
+    case LANE_F32:
+        f = (float)(int16_t)g_test_rand_int() / 64;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    case LANE_F16:
+        return double_to_half(vals[g_test_rand_int_range(0,
+                                                         ARRAY_SIZE(vals))]);
+    case LANE_I16:
+        return (uint16_t)g_test_rand_int();
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static int lane_size(LaneType type)
+{
+    return type == LANE_F64 ? 8 : type == LANE_F32 ? 4 : 2;
+}
+
+static void fill_file(uint64_t *words, int nwords, LaneType type)
+{
+    uint8_t bytes[AMX_Z_ROWS * AMX_REG_SIZE];
+    int size = lane_size(type);
+    int i;
+
+    for (i = 0; i < nwords * 8; i += size) {
+        uint64_t v = random_lane(type);
+
+        switch (size) {
+        case 8:
+            stq_le_p(bytes + i, v);
+            break;
+        case 4:
+            stl_le_p(bytes + i, v);
+            break;
+        default:
+            stw_le_p(bytes + i, v);
+            break;
+        }
+    }
+    for (i = 0; i < nwords; i++) {
+        words[i] = ldq_le_p(bytes + i * 8);
+    }
+}
+
+static void fill_regs(AMXRegs *r, LaneType type)
+{
+    fill_file(&r->x[0][0], AMX_FILE_WORDS, type);
+    fill_file(&r->y[0][0], AMX_FILE_WORDS, type);
+    fill_file(&r->z[0][0], AMX_Z_ROWS * AMX_REG_WORDS, type);
+}
+
+static void ref_gather(const uint8_t *file, unsigned int offset, uint8_t *out)
+{
+    int i;
+
+    for (i = 0; i < AMX_REG_SIZE; i++) {
+        out[i] = file[(offset + i) % (8 * AMX_REG_SIZE)];
+    }
+}
+
+static double ref_lane(const uint8_t *p, LaneType type, int i)
+{
+    float f;
+    double d;
+    uint32_t bits;
+    uint64_t bits64;
+
+    switch (type) {
+    case LANE_F64:
+        bits64 = ldq_le_p(p + i * 8);
+        memcpy(&d, &bits64, sizeof(d));
+        return d;
+    case LANE_F32:
+        bits = ldl_le_p(p + i * 4);
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    case LANE_F16:
+        return half_to_double(lduw_le_p(p + i * 2));
+    case LANE_I16:
+        return (int16_t)lduw_le_p(p + i * 2);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void ref_set_lane(uint8_t *p, LaneType type, int i, double v)
+{
+    float f;
+    uint32_t bits;
+    uint64_t bits64;
+
+    switch (type) {
+    case LANE_F64:
+        memcpy(&bits64, &v, sizeof(v));
+        stq_le_p(p + i * 8, bits64);
+        break;
+    case LANE_F32:
+        f = v;
+        memcpy(&bits, &f, sizeof(f));
+        stl_le_p(p + i * 4, bits);
+        break;
+    case LANE_F16:
+        stw_le_p(p + i * 2, double_to_half(v));
+        break;
+    case LANE_I16:
+        stw_le_p(p + i * 2, (uint16_t)(int64_t)v);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static double ref_muladd(LaneType type, double a, double b, double c,
+                         bool negate)
+{
+    if (negate) {
+        a = -a;
+    }
+    switch (type) {
+    case LANE_F64:
+        return fma(a, b, c);
+    case LANE_F32:
+        return fmaf(a, b, c);
+    case LANE_F16:
+        /* The inputs are picked so that this is exact. */
+        return a * b + c;
+    case LANE_I16:
+        return (int16_t)((int64_t)c + (int64_t)a * (int64_t)b);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void ref_fma(RefRegs *ref, LaneType type, uint64_t operand,
+                    bool negate)
+{
+    int lanes = AMX_REG_SIZE / lane_size(type);
+    int stride = 64 / lanes;
+    unsigned int zrow = AMX_OPERAND_ZROW(operand);
+    uint8_t x[AMX_REG_SIZE], y[AMX_REG_SIZE];
+    double xv[32], yv[32];
+    uint8_t *z;
+    int i, j;
+
+    ref_gather(ref->x, AMX_OPERAND_XOFF(operand), x);
+    ref_gather(ref->y, AMX_OPERAND_YOFF(operand), y);
+    for (i = 0; i < lanes; i++) {
+        xv[i] = AMX_OPERAND_SKIP_X(operand) ? 1 : ref_lane(x, type, i);
+        yv[i] = AMX_OPERAND_SKIP_Y(operand) ? 1 : ref_lane(y, type, i);
+    }
+
+    for (j = 0; j < lanes; j++) {
+        if (AMX_OPERAND_VECTOR(operand)) {
+            z = ref->z[zrow];
+        } else {
+            z = ref->z[j * stride + zrow % stride];
+        }
+        for (i = 0; i < lanes; i++) {
+            double acc =
+                AMX_OPERAND_SKIP_Z(operand) ? 0 : ref_lane(z, type, i);
+            double yy = AMX_OPERAND_VECTOR(operand) ? yv[i] : yv[j];
+
+            ref_set_lane(z, type, i,
+                         ref_muladd(type, xv[i], yy, acc, negate));
+        }
+        if (AMX_OPERAND_VECTOR(operand)) {
+            break;
+        }
+    }
+}
+
+/* As amx_init_fpst() in amx_helper.c. */
+static void init_fpst(float_status *fpst)
+{
+    memset(fpst, 0, sizeof(*fpst));
+    set_float_detect_tininess(float_tininess_before_rounding, fpst);
+    set_float_ftz_detection(float_ftz_before_rounding, fpst);
+    set_float_2nan_prop_rule(float_2nan_prop_s_ab, fpst);
+    set_float_3nan_prop_rule(float_3nan_prop_s_cab, fpst);
+    set_float_infzeronan_rule(float_infzeronan_dnan_if_qnan, fpst);
+    set_float_default_nan_pattern(0b01000000, fpst);
+    set_default_nan_mode(true, fpst);
+    fpst->float_exception_flags = float_flag_inexact;
+}
+
+typedef void AMXFmaFn(const uint64_t *, const uint64_t *,
+                      uint64_t (*)[AMX_REG_WORDS], uint64_t, int,
+                      float_status *);
+
+static void check_fma(AMXFmaFn *fn, LaneType type, uint64_t mode,
+                      bool negate)
+{
+    int iter;
+
+    for (iter = 0; iter < 64; iter++) {
+        uint64_t operand = OP_XOFF(g_test_rand_int_range(0, 512)) |
+                           OP_YOFF(g_test_rand_int_range(0, 512)) |
+                           OP_ZROW(g_test_rand_int_range(0, 64)) | mode;
+        g_autofree AMXRegs *r = g_new(AMXRegs, 1);
+        g_autofree RefRegs *ref = g_new(RefRegs, 1);
+        float_status fpst;
+
+        /*
+         * Keep the offsets lane aligned, otherwise the lanes would mix
+         * bytes of two values and lose the exactness picked above.
+         */
+        operand &= ~(OP_XOFF(lane_size(type) - 1) |
+                     OP_YOFF(lane_size(type) - 1));
+
+        fill_regs(r, type);
+        regs_to_ref(r, ref);
+        init_fpst(&fpst);
+        fn(&r->x[0][0], &r->y[0][0], r->z, operand,
+           negate ? float_muladd_negate_product : 0, &fpst);
+        ref_fma(ref, type, operand, negate);
+        assert_regs_equal(r, ref);
+    }
+}
+
+static void test_fma64(void)
+{
+    check_fma(amx_fma64, LANE_F64, 0, false);
+    check_fma(amx_fma64, LANE_F64, OP_VECTOR, false);
+    check_fma(amx_fma64, LANE_F64, OP_SKIP_Z, true);
+    check_fma(amx_fma64, LANE_F64, OP_VECTOR | OP_SKIP_X, true);
+}
+
+static void test_fma32(void)
+{
+    check_fma(amx_fma32, LANE_F32, 0, false);
+    check_fma(amx_fma32, LANE_F32, OP_VECTOR | OP_SKIP_Z, false);
+    check_fma(amx_fma32, LANE_F32, OP_SKIP_Y, true);
+    check_fma(amx_fma32, LANE_F32, OP_VECTOR, true);
+}
+
+static void test_fma16(void)
+{
+    check_fma(amx_fma16, LANE_F16, 0, false);
+    check_fma(amx_fma16, LANE_F16, OP_VECTOR, false);
+    check_fma(amx_fma16, LANE_F16, OP_SKIP_X | OP_SKIP_Y, true);
+}
+
+static void test_mac16(void)
+{
+    check_fma(amx_mac16, LANE_I16, 0, false);
+    check_fma(amx_mac16, LANE_I16, OP_VECTOR, false);
+    check_fma(amx_mac16, LANE_I16, OP_SKIP_Z | OP_SKIP_Y, false);
+}
+
+static void test_gather_scatter(void)
+{
+    static const unsigned int offsets[] = { 0, 8, 3, 448, 500, 511 };
+    g_autofree AMXRegs *r = g_new(AMXRegs, 1);
+    g_autofree RefRegs *ref = g_new(RefRegs, 1);
+    uint64_t row[AMX_REG_WORDS];
+    uint8_t bytes[AMX_REG_SIZE], expect[AMX_REG_SIZE];
+    size_t i;
+    int j;
+
+    for (i = 0; i < ARRAY_SIZE(offsets); i++) {
+        fill_regs(r, LANE_I16);
+        regs_to_ref(r, ref);
+
+        amx_gather(&r->x[0][0], offsets[i], row);
+        words_to_bytes(row, bytes, AMX_REG_WORDS);
+        ref_gather(ref->x, offsets[i], expect);
+        g_assert(memcmp(bytes, expect, sizeof(bytes)) == 0);
+
+        /* Scatter a Z row into Y, wrapping past the end of the file. */
+        amx_scatter(&r->y[0][0], offsets[i], r->z[i]);
+        for (j = 0; j < AMX_REG_SIZE; j++) {
+            ref->y[(offsets[i] + j) % sizeof(ref->y)] = ref->z[i][j];
+        }
+        assert_regs_equal(r, ref);
+    }
+}
+
+static void test_extr(void)
+{
+    g_autofree AMXRegs *r = g_new(AMXRegs, 1);
+    g_autofree RefRegs *ref = g_new(RefRegs, 1);
+    uint64_t operand = OP_ZROW(37);
+    int j;
+
+    fill_regs(r, LANE_I16);
+    regs_to_ref(r, ref);
+
+    g_assert_true(amx_extr(&r->x[0][0], r->z, 130, operand));
+    for (j = 0; j < AMX_REG_SIZE; j++) {
+        ref->x[130 + j] = ref->z[37][j];
+    }
+    assert_regs_equal(r, ref);
+
+    /* The lane modes are not implemented and leave the file alone. */
+    g_assert_false(amx_extr(&r->y[0][0], r->z, 0, operand | BIT_ULL(26)));
+    g_assert_false(amx_extr(&r->y[0][0], r->z, 0, operand | BIT_ULL(27)));
+    g_assert_false(amx_extr(&r->y[0][0], r->z, 0, operand | BIT_ULL(63)));
+    assert_regs_equal(r, ref);
+}
+
+static void test_interleave_z(void)
+{
+    g_autofree AMXRegs *r = g_new(AMXRegs, 1);
+    g_autofree RefRegs *ref = g_new(RefRegs, 1);
+    uint64_t buf[AMX_REG_WORDS];
+    uint8_t bytes[AMX_REG_SIZE], expect[AMX_REG_SIZE];
+    unsigned int half;
+    int i;
+
+    for (half = 0; half < 2; half++) {
+        /* Rows 22 and 23. */
+        uint64_t operand = ((uint64_t)half << 56) | (11ULL << 57);
+        uint8_t *even, *odd;
+
+        fill_regs(r, LANE_I16);
+        regs_to_ref(r, ref);
+        even = ref->z[22];
+        odd = ref->z[23];
+
+        amx_interleave_z(r->z, operand, buf, true);
+        words_to_bytes(buf, bytes, AMX_REG_WORDS);
+        for (i = 0; i < 16; i++) {
+            memcpy(expect + i * 4,
+                   (i & 1 ? odd : even) + (half * 8 + i / 2) * 4, 4);
+        }
+        g_assert(memcmp(bytes, expect, sizeof(bytes)) == 0);
+
+        /* Load the row back rotated by one lane. */
+        for (i = 0; i < AMX_REG_SIZE; i++) {
+            bytes[i] = expect[(i + 4) % AMX_REG_SIZE];
+        }
+        for (i = 0; i < AMX_REG_WORDS; i++) {
+            buf[i] = ldq_le_p(bytes + i * 8);
+        }
+        amx_interleave_z(r->z, operand, buf, false);
+        for (i = 0; i < 16; i++) {
+            memcpy((i & 1 ? odd : even) + (half * 8 + i / 2) * 4,
+                   bytes + i * 4, 4);
+        }
+        assert_regs_equal(r, ref);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/arm/amx/gather-scatter", test_gather_scatter);
+    g_test_add_func("/arm/amx/extr", test_extr);
+    g_test_add_func("/arm/amx/interleave-z", test_interleave_z);
+    g_test_add_func("/arm/amx/fma64", test_fma64);
+    g_test_add_func("/arm/amx/fma32", test_fma32);
+    g_test_add_func("/arm/amx/fma16", test_fma16);
+    g_test_add_func("/arm/amx/mac16", test_mac16);
+    return g_test_run();
+}